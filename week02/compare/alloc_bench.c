@@ -0,0 +1,320 @@
+/*
+ * alloc_bench.c - Measuring the cost of many small allocations in C
+ *
+ * memory.c shows where stack and heap memory come from. This program
+ * measures what they cost when a program makes lots of small, short-lived
+ * allocations, as a parser building tree nodes does. It compares:
+ * - malloc: the general purpose heap, one malloc() and free() per block
+ * - arena:  a bump allocator, every block is freed at once by a reset
+ * - pool:   fixed-size blocks kept on a free list
+ * - stack:  a local array in each of a chain of function calls
+ *
+ * Each round allocates BENCH_BATCH blocks, writes to each one and then
+ * frees them all. Every thread does the same work with its own arena
+ * and pool, but all threads share the one malloc heap.
+ *
+ * Build with make alloc_bench_c, alloc_bench.rs does the same in Rust.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_ALLOCS (4 * 1000 * 1000)  /* allocations per thread */
+#define BENCH_BATCH 64                  /* allocations live at once */
+#define BENCH_ALIGN 16
+#define BENCH_THREADS_MAX 8
+
+/* ============================================================
+ * SECTION 1: Bump Arena
+ * ============================================================
+ * An arena hands out the next free bytes of a big chunk, so allocating
+ * is an add and a compare. Blocks cannot be freed one at a time; a reset
+ * gives the whole chunk back at once. A real arena would start another
+ * chunk when one fills up; here the chunk always holds a whole batch.
+ */
+
+struct arena_st {
+    char *base;
+    size_t len;
+    size_t cap;
+};
+
+void arena_init(struct arena_st *ap, size_t cap) {
+    ap->base = malloc(cap);
+    if (ap->base == NULL) {
+        printf("arena error: out of memory\n");
+        exit(-1);
+    }
+    ap->len = 0;
+    ap->cap = cap;
+}
+
+void *arena_alloc(struct arena_st *ap, size_t size) {
+    size_t start = (ap->len + BENCH_ALIGN - 1) & ~(size_t) (BENCH_ALIGN - 1);
+
+    if (start + size > ap->cap) {
+        printf("arena error: chunk too small\n");
+        exit(-1);
+    }
+    ap->len = start + size;
+    return ap->base + start;
+}
+
+void arena_reset(struct arena_st *ap) {
+    ap->len = 0;
+}
+
+void arena_free(struct arena_st *ap) {
+    free(ap->base);
+}
+
+/* ============================================================
+ * SECTION 2: Fixed-size Pool
+ * ============================================================
+ * A pool carves a chunk into blocks of one size. A free block holds the
+ * pointer to the next free one, so alloc and free each move one pointer
+ * and blocks can be freed in any order.
+ */
+
+struct pool_st {
+    char *base;
+    void *free_list;
+};
+
+void pool_init(struct pool_st *pp, size_t size, int count) {
+    size_t stride = (size + BENCH_ALIGN - 1) & ~(size_t) (BENCH_ALIGN - 1);
+    int i;
+
+    pp->base = malloc(stride * count);
+    if (pp->base == NULL) {
+        printf("pool error: out of memory\n");
+        exit(-1);
+    }
+    pp->free_list = NULL;
+    for (i = count - 1; i >= 0; i--) {
+        *(void **) (pp->base + i * stride) = pp->free_list;
+        pp->free_list = pp->base + i * stride;
+    }
+}
+
+void *pool_alloc(struct pool_st *pp) {
+    void *p = pp->free_list;
+
+    if (p == NULL) {
+        printf("pool error: out of blocks\n");
+        exit(-1);
+    }
+    pp->free_list = *(void **) p;
+    return p;
+}
+
+void pool_release(struct pool_st *pp, void *p) {
+    *(void **) p = pp->free_list;
+    pp->free_list = p;
+}
+
+void pool_free(struct pool_st *pp) {
+    free(pp->base);
+}
+
+/* ============================================================
+ * SECTION 3: The Benchmarks
+ * ============================================================
+ * Every benchmark writes the first and the last byte of each block,
+ * which is enough to make the memory real without timing a memset.
+ * Each returns a checksum so the compiler cannot drop the work.
+ */
+
+enum bench_kind_enum {
+    BENCH_MALLOC,
+    BENCH_ARENA,
+    BENCH_POOL,
+    BENCH_STACK,
+};
+
+char *bench_names[] = {"malloc", "arena", "pool", "stack"};
+
+static void bench_touch(char *p, size_t size, int i) {
+    p[0] = (char) i;
+    p[size - 1] = (char) i;
+}
+
+static uint64_t bench_malloc(size_t size, int rounds) {
+    char *blocks[BENCH_BATCH];
+    uint64_t sum = 0;
+    int r, i;
+
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            blocks[i] = malloc(size);
+            if (blocks[i] == NULL) {
+                printf("bench error: out of memory\n");
+                exit(-1);
+            }
+            bench_touch(blocks[i], size, i);
+        }
+        /* Free in reverse, the order a tree is usually torn down in */
+        for (i = BENCH_BATCH - 1; i >= 0; i--) {
+            sum += blocks[i][size - 1];
+            free(blocks[i]);
+        }
+    }
+    return sum;
+}
+
+static uint64_t bench_arena(size_t size, int rounds) {
+    struct arena_st arena;
+    char *blocks[BENCH_BATCH];
+    uint64_t sum = 0;
+    int r, i;
+
+    arena_init(&arena, BENCH_BATCH * (size + BENCH_ALIGN));
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            blocks[i] = arena_alloc(&arena, size);
+            bench_touch(blocks[i], size, i);
+        }
+        for (i = BENCH_BATCH - 1; i >= 0; i--) {
+            sum += blocks[i][size - 1];
+        }
+        arena_reset(&arena);
+    }
+    arena_free(&arena);
+    return sum;
+}
+
+static uint64_t bench_pool(size_t size, int rounds) {
+    struct pool_st pool;
+    char *blocks[BENCH_BATCH];
+    uint64_t sum = 0;
+    int r, i;
+
+    pool_init(&pool, size, BENCH_BATCH);
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < BENCH_BATCH; i++) {
+            blocks[i] = pool_alloc(&pool);
+            bench_touch(blocks[i], size, i);
+        }
+        for (i = BENCH_BATCH - 1; i >= 0; i--) {
+            sum += blocks[i][size - 1];
+            pool_release(&pool, blocks[i]);
+        }
+    }
+    pool_free(&pool);
+    return sum;
+}
+
+/* One stack block per call, freed when the call returns. The stack only
+ * frees in reverse order, so this is the best case for the others too.
+ * noinline keeps the compiler from merging the frames into one.
+ */
+static __attribute__((noinline)) uint64_t bench_stack_chain(size_t size, int depth) {
+    char block[size];
+    uint64_t sum;
+
+    bench_touch(block, size, depth);
+    sum = (depth > 1) ? bench_stack_chain(size, depth - 1) : 0;
+    __asm__ volatile("" : : "r"(block) : "memory");
+    return sum + block[size - 1];
+}
+
+static uint64_t bench_stack(size_t size, int rounds) {
+    uint64_t sum = 0;
+    int r;
+
+    for (r = 0; r < rounds; r++) {
+        sum += bench_stack_chain(size, BENCH_BATCH);
+    }
+    return sum;
+}
+
+/* ============================================================
+ * SECTION 4: Threads and Timing
+ * ============================================================
+ * All threads start together and the time is from the first start to
+ * the last finish, so ns/op is the time one thread spends on one
+ * allocation while the others run, and Mops/s is for all threads.
+ */
+
+struct bench_arg_st {
+    enum bench_kind_enum kind;
+    size_t size;
+    int rounds;
+    uint64_t sum;
+};
+
+static void *bench_thread(void *arg) {
+    struct bench_arg_st *bp = arg;
+
+    switch (bp->kind) {
+    case BENCH_MALLOC:
+        bp->sum = bench_malloc(bp->size, bp->rounds);
+        break;
+    case BENCH_ARENA:
+        bp->sum = bench_arena(bp->size, bp->rounds);
+        break;
+    case BENCH_POOL:
+        bp->sum = bench_pool(bp->size, bp->rounds);
+        break;
+    case BENCH_STACK:
+        bp->sum = bench_stack(bp->size, bp->rounds);
+        break;
+    }
+    return NULL;
+}
+
+static double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_run(enum bench_kind_enum kind, size_t size, int nthreads) {
+    pthread_t threads[BENCH_THREADS_MAX];
+    struct bench_arg_st args[BENCH_THREADS_MAX];
+    int rounds = BENCH_ALLOCS / BENCH_BATCH;
+    double t0, secs;
+    int i;
+
+    t0 = bench_now();
+    for (i = 0; i < nthreads; i++) {
+        args[i].kind = kind;
+        args[i].size = size;
+        args[i].rounds = rounds;
+        if (pthread_create(&threads[i], NULL, bench_thread, &args[i]) != 0) {
+            printf("bench error: cannot create thread\n");
+            exit(-1);
+        }
+    }
+    for (i = 0; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    secs = bench_now() - t0;
+
+    printf("%-8s %6zu %8d %10.2f %10.1f\n", bench_names[kind], size, nthreads,
+           secs * 1e9 / ((double) rounds * BENCH_BATCH),
+           (double) rounds * BENCH_BATCH * nthreads / secs / 1e6);
+}
+
+int main(void) {
+    size_t sizes[] = {16, 64, 256};
+    int threads[] = {1, 2, 4, 8};
+    int k, s, t;
+
+    printf("ns per allocation (alloc, write, free), %d per thread, %d live\n\n",
+           BENCH_ALLOCS, BENCH_BATCH);
+    printf("%-8s %6s %8s %10s %10s\n", "alloc", "size", "threads", "ns/op", "Mops/s");
+
+    for (k = BENCH_MALLOC; k <= BENCH_STACK; k++) {
+        for (s = 0; s < 3; s++) {
+            for (t = 0; t < 4; t++) {
+                bench_run(k, sizes[s], threads[t]);
+            }
+        }
+    }
+    return 0;
+}
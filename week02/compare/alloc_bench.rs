@@ -0,0 +1,280 @@
+/*
+ * alloc_bench.rs - Measuring the cost of many small allocations in Rust
+ *
+ * The same benchmarks as alloc_bench.c, written the way safe Rust would:
+ * - malloc: a Box per block, from the global allocator (the system malloc)
+ * - arena:  a bump allocator handing out offsets into one Vec<u8>
+ * - pool:   fixed-size slots of one Vec<u8> with a stack of free slots
+ * - stack:  a local array in each of a chain of function calls
+ *
+ * Safe Rust does not hand out uninitialized memory, so a new Box or stack
+ * array is zeroed first. The arena and pool reuse memory that was zeroed
+ * once when they were made, so they skip that cost.
+ *
+ * Build with make alloc_bench_rs.
+ */
+
+use std::hint::black_box;
+use std::thread;
+use std::time::Instant;
+
+const BENCH_ALLOCS: usize = 4 * 1000 * 1000; // allocations per thread
+const BENCH_BATCH: usize = 64; // allocations live at once
+const BENCH_ALIGN: usize = 16;
+
+/* ============================================================
+ * SECTION 1: Bump Arena
+ * ============================================================
+ * Blocks are offsets into the arena rather than references, so many of
+ * them can be live while the arena is borrowed mutably to write them.
+ */
+
+struct Arena {
+    buf: Vec<u8>,
+    len: usize,
+}
+
+impl Arena {
+    fn new(cap: usize) -> Self {
+        Arena { buf: vec![0; cap], len: 0 }
+    }
+
+    fn alloc(&mut self, size: usize) -> usize {
+        let start = (self.len + BENCH_ALIGN - 1) & !(BENCH_ALIGN - 1);
+
+        if start + size > self.buf.len() {
+            eprintln!("arena error: chunk too small");
+            std::process::exit(-1);
+        }
+        self.len = start + size;
+        start
+    }
+
+    fn block(&mut self, start: usize, size: usize) -> &mut [u8] {
+        &mut self.buf[start..start + size]
+    }
+
+    fn reset(&mut self) {
+        self.len = 0;
+    }
+}
+
+/* ============================================================
+ * SECTION 2: Fixed-size Pool
+ * ============================================================
+ * Without raw pointers the free list cannot live inside the free blocks,
+ * so it is a separate stack of slot numbers.
+ */
+
+struct Pool {
+    buf: Vec<u8>,
+    stride: usize,
+    free: Vec<u32>,
+}
+
+impl Pool {
+    fn new(size: usize, count: usize) -> Self {
+        let stride = (size + BENCH_ALIGN - 1) & !(BENCH_ALIGN - 1);
+
+        Pool {
+            buf: vec![0; stride * count],
+            stride,
+            free: (0..count as u32).rev().collect(),
+        }
+    }
+
+    fn alloc(&mut self) -> u32 {
+        match self.free.pop() {
+            Some(slot) => slot,
+            None => {
+                eprintln!("pool error: out of blocks");
+                std::process::exit(-1);
+            }
+        }
+    }
+
+    fn block(&mut self, slot: u32, size: usize) -> &mut [u8] {
+        let start = slot as usize * self.stride;
+        &mut self.buf[start..start + size]
+    }
+
+    fn release(&mut self, slot: u32) {
+        self.free.push(slot);
+    }
+}
+
+/* ============================================================
+ * SECTION 3: The Benchmarks
+ * ============================================================
+ * As in alloc_bench.c, each block gets its first and last byte written
+ * and each benchmark returns a checksum. The block size is a const
+ * generic so Box and the stack can use fixed-size arrays.
+ */
+
+#[derive(Clone, Copy)]
+enum BenchKind {
+    Malloc,
+    Arena,
+    Pool,
+    Stack,
+}
+
+impl BenchKind {
+    fn name(self) -> &'static str {
+        match self {
+            BenchKind::Malloc => "malloc",
+            BenchKind::Arena => "arena",
+            BenchKind::Pool => "pool",
+            BenchKind::Stack => "stack",
+        }
+    }
+}
+
+fn bench_touch(block: &mut [u8], i: usize) {
+    let last = block.len() - 1;
+    block[0] = i as u8;
+    block[last] = i as u8;
+}
+
+fn bench_malloc<const N: usize>(rounds: usize) -> u64 {
+    let mut blocks: Vec<Box<[u8; N]>> = Vec::with_capacity(BENCH_BATCH);
+    let mut sum = 0;
+
+    for _ in 0..rounds {
+        for i in 0..BENCH_BATCH {
+            let mut block = Box::new([0u8; N]);
+            bench_touch(&mut block[..], i);
+            blocks.push(block);
+        }
+        // Drop in reverse, the order a tree is usually torn down in
+        while let Some(block) = blocks.pop() {
+            sum += block[N - 1] as u64;
+        }
+    }
+    sum
+}
+
+fn bench_arena(size: usize, rounds: usize) -> u64 {
+    let mut arena = Arena::new(BENCH_BATCH * (size + BENCH_ALIGN));
+    let mut blocks = [0usize; BENCH_BATCH];
+    let mut sum = 0;
+
+    for _ in 0..rounds {
+        for (i, start) in blocks.iter_mut().enumerate() {
+            *start = arena.alloc(size);
+            bench_touch(arena.block(*start, size), i);
+        }
+        for &start in blocks.iter().rev() {
+            sum += arena.block(start, size)[size - 1] as u64;
+        }
+        arena.reset();
+    }
+    sum
+}
+
+fn bench_pool(size: usize, rounds: usize) -> u64 {
+    let mut pool = Pool::new(size, BENCH_BATCH);
+    let mut blocks = [0u32; BENCH_BATCH];
+    let mut sum = 0;
+
+    for _ in 0..rounds {
+        for (i, slot) in blocks.iter_mut().enumerate() {
+            *slot = pool.alloc();
+            bench_touch(pool.block(*slot, size), i);
+        }
+        for &slot in blocks.iter().rev() {
+            sum += pool.block(slot, size)[size - 1] as u64;
+            pool.release(slot);
+        }
+    }
+    sum
+}
+
+// One stack block per call, freed when the call returns. inline(never)
+// keeps the compiler from merging the frames into one.
+#[inline(never)]
+fn bench_stack_chain<const N: usize>(depth: usize) -> u64 {
+    let mut block = [0u8; N];
+
+    bench_touch(&mut block, depth);
+    let sum = if depth > 1 { bench_stack_chain::<N>(depth - 1) } else { 0 };
+    black_box(&mut block);
+    sum + block[N - 1] as u64
+}
+
+fn bench_stack<const N: usize>(rounds: usize) -> u64 {
+    let mut sum = 0;
+
+    for _ in 0..rounds {
+        sum += bench_stack_chain::<N>(BENCH_BATCH);
+    }
+    sum
+}
+
+fn bench_sized<const N: usize>(kind: BenchKind, rounds: usize) -> u64 {
+    match kind {
+        BenchKind::Malloc => bench_malloc::<N>(rounds),
+        BenchKind::Arena => bench_arena(N, rounds),
+        BenchKind::Pool => bench_pool(N, rounds),
+        BenchKind::Stack => bench_stack::<N>(rounds),
+    }
+}
+
+fn bench_kind(kind: BenchKind, size: usize, rounds: usize) -> u64 {
+    match size {
+        16 => bench_sized::<16>(kind, rounds),
+        64 => bench_sized::<64>(kind, rounds),
+        256 => bench_sized::<256>(kind, rounds),
+        _ => panic!("no benchmark for size {}", size),
+    }
+}
+
+/* ============================================================
+ * SECTION 4: Threads and Timing
+ * ============================================================
+ * Timed the same way as alloc_bench.c: from the first thread starting
+ * to the last one finishing.
+ */
+
+fn bench_run(kind: BenchKind, size: usize, nthreads: usize) {
+    let rounds = BENCH_ALLOCS / BENCH_BATCH;
+    let ops = (rounds * BENCH_BATCH) as f64;
+
+    let t0 = Instant::now();
+    thread::scope(|s| {
+        let handles: Vec<_> = (0..nthreads)
+            .map(|_| s.spawn(move || bench_kind(kind, size, rounds)))
+            .collect();
+        for h in handles {
+            black_box(h.join().unwrap());
+        }
+    });
+    let secs = t0.elapsed().as_secs_f64();
+
+    println!(
+        "{:<8} {:6} {:8} {:10.2} {:10.1}",
+        kind.name(),
+        size,
+        nthreads,
+        secs * 1e9 / ops,
+        ops * nthreads as f64 / secs / 1e6
+    );
+}
+
+fn main() {
+    let kinds = [BenchKind::Malloc, BenchKind::Arena, BenchKind::Pool, BenchKind::Stack];
+
+    println!(
+        "ns per allocation (alloc, write, free), {} per thread, {} live\n",
+        BENCH_ALLOCS, BENCH_BATCH
+    );
+    println!("{:<8} {:>6} {:>8} {:>10} {:>10}", "alloc", "size", "threads", "ns/op", "Mops/s");
+
+    for kind in kinds {
+        for size in [16, 64, 256] {
+            for nthreads in [1, 2, 4, 8] {
+                bench_run(kind, size, nthreads);
+            }
+        }
+    }
+}
@@ -1,33 +1,53 @@
-/* lab02.c - instrumented parsing visualization */
+/* lab02.c - parsing with an optional trace log for visualization */
 
 #include "ntlang.h"
 
+void usage(void) {
+    printf("Usage: lab02 [-t <log>] <expression>\n");
+    printf("  -t <log>  record scanning and parsing to log, see trace_view\n");
+    printf("  Example: lab02 \"1 + 2\"\n");
+    printf("  Example: lab02 -t lab02.trace \"1 + 2\" && trace_view lab02.trace\n");
+    exit(-1);
+}
+
 int main(int argc, char **argv) {
     struct scan_table_st scan_table;
     struct parse_table_st parse_table;
     struct parse_node_st *parse_tree;
+    char *trace_path = NULL;
     char *input;
 
-    if (argc != 2) {
-        printf("Usage: lab02 <expression>\n");
-        printf("  Example: lab02 \"1 + 2\"\n");
-        exit(-1);
+    if (argc == 4 && strcmp(argv[1], "-t") == 0) {
+        trace_path = argv[2];
+        input = argv[3];
+    } else if (argc == 2) {
+        input = argv[1];
+    } else {
+        usage();
     }
 
-    input = argv[1];
+    if (trace_path != NULL) {
+        trace_start(TRACE_LOG_LEN);
+        trace_save_at_exit(trace_path);
+    }
 
     /* Phase 1: Scanning */
-    printf("=== Scanning \"%s\" ===\n", input);
     scan_table_init(&scan_table);
     scan_table_scan(&scan_table, input);
 
     /* Phase 2: Parsing */
-    printf("\n=== Parsing ===\n");
     parse_table_init(&parse_table);
     parse_tree = parse_program(&parse_table, &scan_table);
 
+    if (trace_path != NULL) {
+        trace_stop();
+        if (!trace_save(trace_path)) {
+            printf("lab02: cannot write %s\n", trace_path);
+            exit(-1);
+        }
+    }
+
     /* Phase 3: Print tree */
-    printf("\n=== Parse Tree ===\n");
     parse_tree_print(parse_tree);
 
     return 0;
@@ -1,9 +1,11 @@
 /* ntlang.h - header file for Project02 (ntlang) */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 /*
@@ -26,7 +28,6 @@ whitespace ::= (' ' | '\t') (' ' | '\t')*
 
 */
 
-#define SCAN_TOKEN_LEN 32
 #define SCAN_TABLE_LEN 1024
 #define SCAN_INPUT_LEN 4096
 
@@ -46,18 +47,28 @@ enum scan_token_enum {
     "TK_ANY"\
 };
 
+/* Tokens do not copy their text. pos and len locate the text in the
+ * input given to scan_table_scan(), and value holds the converted
+ * integer for TK_INTLIT.
+ */
 struct scan_token_st {
     enum scan_token_enum id;
-    char value[SCAN_TOKEN_LEN];
+    int pos;
+    int len;
+    int value;
 };
 
 struct scan_table_st {
     struct scan_token_st table[SCAN_TABLE_LEN];
+    char *input;
     int len;
     int cur;
 };
 
-void scan_token_print(struct scan_token_st *tk);
+/* printf arguments for a "%.*s" conversion of a token's text */
+#define SCAN_TOKEN_TEXT(st, tp) (tp)->len, (st)->input + (tp)->pos
+
+void scan_token_print(struct scan_table_st *st, struct scan_token_st *tk);
 void scan_table_init(struct scan_table_st *st);
 void scan_table_scan(struct scan_table_st *st, char *input);
 void scan_table_print(struct scan_table_st *st);
@@ -113,3 +124,97 @@ struct parse_node_st * parse_node_new(struct parse_table_st *pt);
 struct parse_node_st * parse_program(struct parse_table_st *pt,
                                         struct scan_table_st *st);
 void parse_tree_print(struct parse_node_st *np);
+
+/*
+ * trace.c
+ */
+
+/* Scanning and parsing record what they do as fixed-size binary events
+ * in a ring buffer, and trace_view renders a saved log offline, either
+ * as the ASCII tables and trees or as a Chrome trace. Recording an event
+ * is a timestamp and a few stores, and nothing at all while tracing is
+ * off. When the buffer is full the oldest events are overwritten.
+ */
+
+enum trace_event_enum {
+    TRACE_ENTER,    /* kind: rule, index: cur */
+    TRACE_EXIT,     /* kind: rule, index: cur, arg[0]: result node or -1 */
+    TRACE_TOKEN,    /* kind: token id, index: token, arg: pos, len, value */
+    TRACE_ACCEPT,   /* kind: token id, index: cur before the accept */
+    TRACE_ALLOC,    /* index: node */
+    TRACE_NODE,     /* kind: node type, index: node, arg: value or oper,
+                       left, right (-1 if none or not parsed yet) */
+};
+
+enum trace_rule_enum {
+    TRACE_RULE_SCAN,
+    TRACE_RULE_PROGRAM,
+    TRACE_RULE_EXPRESSION,
+    TRACE_RULE_OPERAND,
+};
+
+#define TRACE_RULE_STRINGS {\
+    "scan_table_scan",\
+    "parse_program",\
+    "parse_expression",\
+    "parse_operand"\
+};
+
+struct trace_event_st {
+    uint64_t time;      /* ns, from CLOCK_MONOTONIC */
+    uint8_t type;       /* enum trace_event_enum */
+    uint8_t kind;
+    uint16_t pad;
+    int32_t index;
+    int32_t arg[3];
+};
+
+/* Events in the log, a power of two */
+#define TRACE_LOG_LEN (1 << 16)
+
+struct trace_log_st {
+    bool on;
+    struct trace_event_st *events;
+    uint64_t count;     /* events recorded, including overwritten ones */
+    uint64_t mask;      /* ring buffer length - 1 */
+    char *input;        /* copy of the traced input */
+    int input_len;
+};
+
+extern struct trace_log_st trace_log;
+
+void trace_start(int len);
+void trace_stop(void);
+void trace_input(char *input, int len);
+bool trace_save(char *path);
+void trace_save_at_exit(char *path);
+bool trace_load(struct trace_log_st *tl, char *path);
+uint64_t trace_first(struct trace_log_st *tl);
+struct trace_event_st * trace_get(struct trace_log_st *tl, uint64_t i);
+
+static inline uint64_t trace_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Record one event, if tracing is on */
+static inline void trace_event(enum trace_event_enum type, int kind, int index,
+                               int arg0, int arg1, int arg2) {
+    struct trace_event_st *ep;
+
+    if (!trace_log.on) {
+        return;
+    }
+    ep = &trace_log.events[trace_log.count & trace_log.mask];
+    trace_log.count += 1;
+    ep->time = trace_now();
+    ep->type = type;
+    ep->kind = kind;
+    ep->pad = 0;
+    ep->index = index;
+    ep->arg[0] = arg0;
+    ep->arg[1] = arg1;
+    ep->arg[2] = arg2;
+}
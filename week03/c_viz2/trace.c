@@ -0,0 +1,160 @@
+/* trace.c - ring buffer event log for scanning and parsing */
+
+#include "ntlang.h"
+
+/* A saved log is this header, the input text and then the events that
+ * were still in the ring buffer, oldest first. Fields are in host byte
+ * order, so read the log on the same kind of machine that wrote it.
+ */
+#define TRACE_MAGIC "NTTRACE1"
+
+struct trace_header_st {
+    char magic[8];
+    uint64_t count;
+    uint32_t len;
+    uint32_t input_len;
+};
+
+struct trace_log_st trace_log;
+
+/* Where trace_save_at_exit() saves the log */
+static char *trace_exit_path;
+
+static void trace_alloc(struct trace_log_st *tl, uint64_t len) {
+    uint64_t cap = 1;
+
+    while (cap < len) {
+        cap *= 2;
+    }
+    tl->events = calloc(cap, sizeof(struct trace_event_st));
+    if (tl->events == NULL) {
+        printf("trace error: out of memory\n");
+        exit(-1);
+    }
+    tl->count = 0;
+    tl->mask = cap - 1;
+}
+
+/* Start recording into a ring buffer of at least len events */
+void trace_start(int len) {
+    trace_alloc(&trace_log, len);
+    trace_log.input = NULL;
+    trace_log.input_len = 0;
+    trace_log.on = true;
+}
+
+void trace_stop(void) {
+    trace_log.on = false;
+}
+
+/* Keep a copy of the input, which the renderer needs to show tokens */
+void trace_input(char *input, int len) {
+    if (!trace_log.on) {
+        return;
+    }
+    free(trace_log.input);
+    trace_log.input = malloc(len + 1);
+    if (trace_log.input == NULL) {
+        printf("trace error: out of memory\n");
+        exit(-1);
+    }
+    memcpy(trace_log.input, input, len);
+    trace_log.input[len] = '\0';
+    trace_log.input_len = len;
+}
+
+/* Index of the oldest event still in the log */
+uint64_t trace_first(struct trace_log_st *tl) {
+    uint64_t cap = tl->mask + 1;
+
+    return (tl->count > cap) ? tl->count - cap : 0;
+}
+
+/* Event i, which must be from trace_first() up to tl->count */
+struct trace_event_st * trace_get(struct trace_log_st *tl, uint64_t i) {
+    return &tl->events[i & tl->mask];
+}
+
+/* Write the log to path. Returns false if it cannot be written. */
+bool trace_save(char *path) {
+    struct trace_log_st *tl = &trace_log;
+    struct trace_header_st hdr;
+    uint64_t i;
+    FILE *fp;
+    bool ok;
+
+    fp = fopen(path, "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.count = tl->count;
+    hdr.len = tl->count - trace_first(tl);
+    hdr.input_len = tl->input_len;
+
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1
+        && fwrite(tl->input, 1, tl->input_len, fp) == (size_t) tl->input_len;
+    for (i = trace_first(tl); ok && i < tl->count; i++) {
+        ok = fwrite(trace_get(tl, i), sizeof(struct trace_event_st), 1, fp) == 1;
+    }
+    return (fclose(fp) == 0) && ok;
+}
+
+static void trace_exit(void) {
+    if (!trace_log.on) {
+        return;
+    }
+    trace_stop();
+    if (!trace_save(trace_exit_path)) {
+        printf("trace error: cannot write %s\n", trace_exit_path);
+    }
+}
+
+/* Save the log to path if the program exits while still tracing, as
+ * scan and parse errors do, so the steps up to the error are kept.
+ */
+void trace_save_at_exit(char *path) {
+    trace_exit_path = path;
+    atexit(trace_exit);
+}
+
+/* Read a log written by trace_save() into tl. Returns false if path
+ * cannot be read or is not a trace log.
+ */
+bool trace_load(struct trace_log_st *tl, char *path) {
+    struct trace_header_st hdr;
+    uint64_t i;
+    FILE *fp;
+    bool ok;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    ok = fread(&hdr, sizeof(hdr), 1, fp) == 1
+        && memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) == 0
+        && hdr.len <= hdr.count;
+    if (!ok) {
+        fclose(fp);
+        return false;
+    }
+
+    tl->on = false;
+    tl->input_len = hdr.input_len;
+    tl->input = malloc(hdr.input_len + 1);
+    trace_alloc(tl, hdr.len);
+    if (tl->input == NULL) {
+        printf("trace error: out of memory\n");
+        exit(-1);
+    }
+    ok = fread(tl->input, 1, hdr.input_len, fp) == hdr.input_len;
+    tl->input[hdr.input_len] = '\0';
+
+    /* Put the events back where they were in the ring buffer */
+    tl->count = hdr.count;
+    for (i = hdr.count - hdr.len; ok && i < hdr.count; i++) {
+        ok = fread(trace_get(tl, i), sizeof(struct trace_event_st), 1, fp) == 1;
+    }
+    fclose(fp);
+    return ok;
+}
@@ -0,0 +1,491 @@
+/* trace_view.c - render a lab02 trace log offline */
+
+#include "ntlang.h"
+
+/* The log is replayed into a scan table and a parse table of our own,
+ * so the ASCII views draw the same state the scanner and parser had at
+ * each step. With --chrome the events become a Chrome trace instead,
+ * which chrome://tracing or https://ui.perfetto.dev can show.
+ */
+
+static char *trace_rule_strings[] = TRACE_RULE_STRINGS;
+extern char *scan_token_strings[];
+
+static int trace_depth = 0;
+
+static void trace_indent(void) {
+    for (int i = 0; i < trace_depth * 2; i++) {
+        printf(" ");
+    }
+}
+
+/* Get the pool index of a node via pointer arithmetic */
+static int parse_node_index(struct parse_table_st *pt, struct parse_node_st *np) {
+    return (int)(np - pt->table);
+}
+
+/* Short name for token type (without TK_ prefix) */
+static const char *scan_token_short(enum scan_token_enum id) {
+    switch (id) {
+        case TK_INTLIT: return "INTLIT";
+        case TK_PLUS:   return "PLUS";
+        case TK_MINUS:  return "MINUS";
+        case TK_EOT:    return "EOT";
+        case TK_ANY:    return "ANY";
+    }
+    return "???";
+}
+
+/* Short name for expression type */
+static const char *expr_type_short(enum parse_expr_enum type) {
+    switch (type) {
+        case EX_INTVAL: return "INTVAL";
+        case EX_OPER1:  return "OPER1";
+        case EX_OPER2:  return "OPER2";
+    }
+    return "???";
+}
+
+static const char *oper_short(enum parse_oper_enum op) {
+    switch (op) {
+        case OP_PLUS:  return "PLUS";
+        case OP_MINUS: return "MINUS";
+        case OP_MULT:  return "MULT";
+        case OP_DIV:   return "DIV";
+    }
+    return "???";
+}
+
+/* Print an ASCII art box diagram of the scan_table state */
+static void scan_table_print_state(struct scan_table_st *st) {
+    /* Show at least 4 columns, or len if larger */
+    int cols = st->len;
+    if (cols < 4) cols = 4;
+
+    #define COL_W 15
+
+    printf("\n  scan_table state (len=%d, cur=%d):\n", st->len, st->cur);
+
+    /* Top border */
+    printf("  +");
+    for (int c = 0; c < cols; c++) {
+        for (int k = 0; k < COL_W; k++) printf("-");
+        printf("+");
+    }
+    printf("\n");
+
+    /* Header row: indices */
+    printf("  |");
+    for (int c = 0; c < cols; c++) {
+        char buf[COL_W + 1];
+        snprintf(buf, sizeof(buf), "     [%d]", c);
+        printf("%-*s|", COL_W, buf);
+    }
+    printf("\n");
+
+    /* Content row: token type and value */
+    printf("  |");
+    for (int c = 0; c < cols; c++) {
+        if (c < st->len) {
+            char buf[COL_W + 1];
+            snprintf(buf, sizeof(buf), " %s(\"%.*s\")",
+                     scan_token_short(st->table[c].id),
+                     SCAN_TOKEN_TEXT(st, &st->table[c]));
+            /* Truncate if too long */
+            if ((int)strlen(buf) > COL_W) buf[COL_W] = '\0';
+            printf("%-*s|", COL_W, buf);
+        } else {
+            printf("%-*s|", COL_W, "");
+        }
+    }
+    printf("\n");
+
+    /* Bottom border */
+    printf("  +");
+    for (int c = 0; c < cols; c++) {
+        for (int k = 0; k < COL_W; k++) printf("-");
+        printf("+");
+    }
+    printf("\n");
+
+    /* Cursor marker */
+    printf("  ");
+    /* Position the ^cur marker under the correct column */
+    int offset = 1 + st->cur * (COL_W + 1) + 4;
+    for (int k = 0; k < offset; k++) printf(" ");
+    printf("^cur\n");
+
+    #undef COL_W
+}
+
+/* Recursively print an ASCII art tree rooted at np */
+static void trace_print_tree_rec(struct parse_table_st *pt,
+                                  struct parse_node_st *np,
+                                  const char *prefix, bool is_last, bool is_root) {
+    int idx = parse_node_index(pt, np);
+
+    trace_indent();
+    if (!is_root) {
+        printf("%s%s", prefix, is_last ? "`-- " : "+-- ");
+    }
+
+    if (np->type == EX_INTVAL) {
+        printf("[%d] %d\n", idx, np->intval.value);
+    } else if (np->type == EX_OPER2) {
+        printf("[%d] %s\n", idx, oper_short(np->oper2.oper));
+
+        char child_prefix[256];
+        if (is_root) {
+            child_prefix[0] = '\0';
+        } else {
+            snprintf(child_prefix, sizeof(child_prefix), "%s%s",
+                     prefix, is_last ? "    " : "|   ");
+        }
+
+        bool has_right = (np->oper2.right != NULL);
+        if (np->oper2.left) {
+            trace_print_tree_rec(pt, np->oper2.left, child_prefix, !has_right, false);
+        }
+        if (has_right) {
+            trace_print_tree_rec(pt, np->oper2.right, child_prefix, true, false);
+        }
+    }
+}
+
+static void trace_print_tree(struct parse_table_st *pt, struct parse_node_st *np) {
+    printf("\n");
+    trace_indent();
+    printf("current tree:\n");
+    trace_print_tree_rec(pt, np, "", true, true);
+}
+
+/* Print an ASCII art box diagram of the parse_table state */
+static void parse_table_print_state(struct parse_table_st *pt) {
+    int cols = pt->len;
+    if (cols < 4) cols = 4;
+
+    #define PT_COL_W 18
+
+    printf("\n");
+    trace_indent();
+    printf("parse_table state (len=%d):\n", pt->len);
+
+    /* Top border */
+    trace_indent();
+    printf("+");
+    for (int c = 0; c < cols; c++) {
+        for (int k = 0; k < PT_COL_W; k++) printf("-");
+        printf("+");
+    }
+    printf("\n");
+
+    /* Row 1: indices */
+    trace_indent();
+    printf("|");
+    for (int c = 0; c < cols; c++) {
+        char buf[PT_COL_W + 1];
+        snprintf(buf, sizeof(buf), "       [%d]", c);
+        printf("%-*s|", PT_COL_W, buf);
+    }
+    printf("\n");
+
+    /* Row 2: type */
+    trace_indent();
+    printf("|");
+    for (int c = 0; c < cols; c++) {
+        if (c < pt->len) {
+            char buf[PT_COL_W + 1];
+            snprintf(buf, sizeof(buf), " %s", expr_type_short(pt->table[c].type));
+            printf("%-*s|", PT_COL_W, buf);
+        } else {
+            printf("%-*s|", PT_COL_W, "");
+        }
+    }
+    printf("\n");
+
+    /* Row 3: primary field (val=N or op=OPER) */
+    trace_indent();
+    printf("|");
+    for (int c = 0; c < cols; c++) {
+        if (c < pt->len) {
+            char buf[PT_COL_W + 1];
+            if (pt->table[c].type == EX_INTVAL) {
+                snprintf(buf, sizeof(buf), " val=%d", pt->table[c].intval.value);
+            } else if (pt->table[c].type == EX_OPER2) {
+                snprintf(buf, sizeof(buf), " op=%s", oper_short(pt->table[c].oper2.oper));
+            } else {
+                buf[0] = '\0';
+            }
+            if ((int)strlen(buf) > PT_COL_W) buf[PT_COL_W] = '\0';
+            printf("%-*s|", PT_COL_W, buf);
+        } else {
+            printf("%-*s|", PT_COL_W, "");
+        }
+    }
+    printf("\n");
+
+    /* Row 4: secondary field (L=[i] R=[j] for OPER2) */
+    trace_indent();
+    printf("|");
+    for (int c = 0; c < cols; c++) {
+        if (c < pt->len && pt->table[c].type == EX_OPER2) {
+            char buf[PT_COL_W + 1];
+            char lbuf[8], rbuf[8];
+            if (pt->table[c].oper2.left)
+                snprintf(lbuf, sizeof(lbuf), "[%d]", parse_node_index(pt, pt->table[c].oper2.left));
+            else
+                snprintf(lbuf, sizeof(lbuf), "?");
+            if (pt->table[c].oper2.right)
+                snprintf(rbuf, sizeof(rbuf), "[%d]", parse_node_index(pt, pt->table[c].oper2.right));
+            else
+                snprintf(rbuf, sizeof(rbuf), "?");
+            snprintf(buf, sizeof(buf), " L=%s R=%s", lbuf, rbuf);
+            if ((int)strlen(buf) > PT_COL_W) buf[PT_COL_W] = '\0';
+            printf("%-*s|", PT_COL_W, buf);
+        } else {
+            printf("%-*s|", PT_COL_W, "");
+        }
+    }
+    printf("\n");
+
+    /* Bottom border */
+    trace_indent();
+    printf("+");
+    for (int c = 0; c < cols; c++) {
+        for (int k = 0; k < PT_COL_W; k++) printf("-");
+        printf("+");
+    }
+    printf("\n");
+
+    #undef PT_COL_W
+}
+
+/* The node at index i of the replayed table, or NULL for -1 */
+static struct parse_node_st * view_node(struct parse_table_st *pt, int i) {
+    return (i >= 0 && i < PARSE_TABLE_LEN) ? &pt->table[i] : NULL;
+}
+
+/* Replay ep into st and pt */
+static void view_apply(struct scan_table_st *st, struct parse_table_st *pt,
+                       struct trace_event_st *ep) {
+    struct scan_token_st *tp;
+    struct parse_node_st *np;
+
+    if (ep->type == TRACE_TOKEN && ep->index < SCAN_TABLE_LEN) {
+        tp = &st->table[ep->index];
+        tp->id = ep->kind;
+        tp->pos = ep->arg[0];
+        tp->len = ep->arg[1];
+        tp->value = ep->arg[2];
+        st->len = ep->index + 1;
+    } else if (ep->type == TRACE_ACCEPT) {
+        st->cur = ep->index + 1;
+    } else if (ep->type == TRACE_ALLOC && ep->index < PARSE_TABLE_LEN) {
+        memset(&pt->table[ep->index], 0, sizeof(struct parse_node_st));
+        pt->len = ep->index + 1;
+    } else if (ep->type == TRACE_NODE && (np = view_node(pt, ep->index)) != NULL) {
+        np->type = ep->kind;
+        if (np->type == EX_INTVAL) {
+            np->intval.value = ep->arg[0];
+        } else if (np->type == EX_OPER1) {
+            np->oper1.oper = ep->arg[0];
+            np->oper1.operand = view_node(pt, ep->arg[1]);
+        } else if (np->type == EX_OPER2) {
+            np->oper2.oper = ep->arg[0];
+            np->oper2.left = view_node(pt, ep->arg[1]);
+            np->oper2.right = view_node(pt, ep->arg[2]);
+        }
+    }
+}
+
+/* The token at index i of the replayed table, if it has been seen */
+static struct scan_token_st * view_token(struct scan_table_st *st, int i) {
+    static struct scan_token_st unknown = {TK_ANY, 0, 0, 0};
+
+    return (i >= 0 && i < st->len) ? &st->table[i] : &unknown;
+}
+
+/* Print the log the way the instrumented scanner and parser used to as
+ * they ran
+ */
+static void view_ascii(struct trace_log_st *tl) {
+    static struct scan_table_st st;
+    static struct parse_table_st pt;
+    struct trace_event_st *ep;
+    struct scan_token_st *tp;
+    uint64_t i;
+
+    scan_table_init(&st);
+    st.input = tl->input;
+    parse_table_init(&pt);
+
+    if (trace_first(tl) > 0) {
+        printf("(%llu earlier events were overwritten)\n\n",
+               (unsigned long long) trace_first(tl));
+    }
+
+    for (i = trace_first(tl); i < tl->count; i++) {
+        ep = trace_get(tl, i);
+        view_apply(&st, &pt, ep);
+
+        if (ep->type == TRACE_ENTER && ep->kind == TRACE_RULE_SCAN) {
+            printf("=== Scanning \"%s\" ===\n", tl->input);
+            printf("scan_table_scan(): input=\"%s\", len=%d\n", tl->input, tl->input_len);
+        } else if (ep->type == TRACE_EXIT && ep->kind == TRACE_RULE_SCAN) {
+            printf("\nScan complete: %d tokens in scan_table\n", st.len);
+        } else if (ep->type == TRACE_ENTER) {
+            if (ep->kind == TRACE_RULE_PROGRAM) {
+                printf("\n=== Parsing ===\n");
+            }
+            tp = view_token(&st, ep->index);
+            trace_indent();
+            printf("ENTER %s  [cur=%d: %s(\"%.*s\")]\n", trace_rule_strings[ep->kind],
+                   ep->index, scan_token_strings[tp->id], SCAN_TOKEN_TEXT(&st, tp));
+            trace_depth++;
+        } else if (ep->type == TRACE_EXIT) {
+            trace_depth--;
+            trace_indent();
+            printf("EXIT %s => node[%d]\n", trace_rule_strings[ep->kind], ep->arg[0]);
+        } else if (ep->type == TRACE_TOKEN) {
+            tp = view_token(&st, ep->index);
+            printf("\n  ALLOC scan_table.table[%d]  (scan_table.len: %d -> %d)\n",
+                   ep->index, ep->index, ep->index + 1);
+            printf("    scanned %s(\"%.*s\")", scan_token_strings[tp->id],
+                   SCAN_TOKEN_TEXT(&st, tp));
+            if (tp->id == TK_INTLIT) {
+                printf(" value=%d", tp->value);
+            }
+            printf("\n");
+            scan_table_print_state(&st);
+        } else if (ep->type == TRACE_ACCEPT) {
+            tp = view_token(&st, ep->index);
+            trace_indent();
+            printf("accept %s => consumed \"%.*s\" (cur: %d -> %d)\n",
+                   scan_token_strings[ep->kind], SCAN_TOKEN_TEXT(&st, tp),
+                   ep->index, ep->index + 1);
+        } else if (ep->type == TRACE_ALLOC) {
+            trace_indent();
+            printf("ALLOC node[%d] from parse_table.table[%d]\n", ep->index, ep->index);
+        } else if (ep->type == TRACE_NODE && view_node(&pt, ep->index) != NULL) {
+            trace_indent();
+            if (ep->kind == EX_INTVAL) {
+                printf("  node[%d] = INTVAL %d\n", ep->index, ep->arg[0]);
+            } else if (ep->kind == EX_OPER1) {
+                printf("  node[%d] = OPER1 %s node[%d]\n", ep->index,
+                       oper_short(ep->arg[0]), ep->arg[1]);
+            } else if (ep->arg[2] < 0) {
+                printf("  node[%d] = OPER2 %s node[%d] ?\n", ep->index,
+                       oper_short(ep->arg[0]), ep->arg[1]);
+            } else {
+                printf("  node[%d] = OPER2 %s node[%d] node[%d]\n", ep->index,
+                       oper_short(ep->arg[0]), ep->arg[1], ep->arg[2]);
+            }
+            parse_table_print_state(&pt);
+            trace_print_tree(&pt, view_node(&pt, ep->index));
+        }
+    }
+}
+
+/* Print the len chars of s as the body of a JSON string */
+static void view_json_text(char *s, int len) {
+    for (int i = 0; i < len; i++) {
+        if (s[i] == '"' || s[i] == '\\') {
+            printf("\\%c", s[i]);
+        } else if ((unsigned char) s[i] < 0x20) {
+            printf("\\u%04x", s[i]);
+        } else {
+            putchar(s[i]);
+        }
+    }
+}
+
+/* Print the log in the Chrome trace event format. Rules are duration
+ * events, everything else is an instant event on the same track.
+ */
+static void view_chrome(struct trace_log_st *tl) {
+    static struct scan_table_st st;
+    static struct parse_table_st pt;
+    struct trace_event_st *ep;
+    struct scan_token_st *tp;
+    uint64_t t0 = 0, i;
+    double ts;
+
+    scan_table_init(&st);
+    st.input = tl->input;
+    parse_table_init(&pt);
+
+    if (tl->count > trace_first(tl)) {
+        t0 = trace_get(tl, trace_first(tl))->time;
+    }
+
+    printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    printf("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, "
+           "\"args\": {\"name\": \"lab02 \\\"");
+    view_json_text(tl->input, tl->input_len);
+    printf("\\\"\"}}");
+
+    for (i = trace_first(tl); i < tl->count; i++) {
+        ep = trace_get(tl, i);
+        view_apply(&st, &pt, ep);
+        /* Chrome wants microseconds */
+        ts = (ep->time - t0) / 1000.0;
+        printf(",\n{\"pid\": 1, \"tid\": 1, \"ts\": %.3f, ", ts);
+
+        if (ep->type == TRACE_ENTER) {
+            printf("\"ph\": \"B\", \"name\": \"%s\", \"args\": {\"cur\": %d}}",
+                   trace_rule_strings[ep->kind], ep->index);
+        } else if (ep->type == TRACE_EXIT) {
+            printf("\"ph\": \"E\", \"name\": \"%s\", \"args\": {\"cur\": %d, \"node\": %d}}",
+                   trace_rule_strings[ep->kind], ep->index, ep->arg[0]);
+        } else if (ep->type == TRACE_TOKEN || ep->type == TRACE_ACCEPT) {
+            tp = view_token(&st, ep->index);
+            printf("\"ph\": \"i\", \"s\": \"t\", \"name\": \"%s %s\", "
+                   "\"args\": {\"token\": %d, \"text\": \"",
+                   (ep->type == TRACE_TOKEN) ? "token" : "accept",
+                   scan_token_strings[ep->kind], ep->index);
+            view_json_text(st.input + tp->pos, tp->len);
+            printf("\"}}");
+        } else if (ep->type == TRACE_ALLOC) {
+            printf("\"ph\": \"i\", \"s\": \"t\", \"name\": \"alloc\", "
+                   "\"args\": {\"node\": %d}}", ep->index);
+        } else {
+            printf("\"ph\": \"i\", \"s\": \"t\", \"name\": \"node %s\", "
+                   "\"args\": {\"node\": %d, \"%s\": %d, \"left\": %d, \"right\": %d}}",
+                   expr_type_short(ep->kind), ep->index,
+                   (ep->kind == EX_INTVAL) ? "value" : "oper",
+                   ep->arg[0], ep->arg[1], ep->arg[2]);
+        }
+    }
+    printf("\n]}\n");
+}
+
+int main(int argc, char **argv) {
+    struct trace_log_st log;
+    bool chrome = false;
+    char *path;
+
+    if (argc == 3 && strcmp(argv[1], "--chrome") == 0) {
+        chrome = true;
+        path = argv[2];
+    } else if (argc == 2) {
+        path = argv[1];
+    } else {
+        printf("Usage: trace_view [--chrome] <log>\n");
+        printf("  Example: trace_view lab02.trace\n");
+        printf("  Example: trace_view --chrome lab02.trace > lab02.json\n");
+        exit(-1);
+    }
+
+    if (!trace_load(&log, path)) {
+        printf("trace_view: cannot read %s\n", path);
+        exit(-1);
+    }
+
+    if (chrome) {
+        view_chrome(&log);
+    } else {
+        view_ascii(&log);
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/* arena.c - chunked allocator backing the scan and parse tables */
+
+#include "ntlang.h"
+
+/* An arena hands out fixed-size slots by index. Slots live in chunks of
+ * ARENA_CHUNK_LEN elements that are allocated on demand and never moved,
+ * so pointers into the arena stay valid as it grows. Only the small
+ * chunk directory is ever reallocated.
+ *
+ * The arena does not track how many slots are in use, the owning table
+ * does (scan_table_st.len, parse_table_st.len). Resetting a table is just
+ * setting its len back to 0; the chunks are kept for reuse.
+ */
+
+void arena_init(struct arena_st *ap, int elem_size) {
+    ap->chunks = NULL;
+    ap->chunks_len = 0;
+    ap->chunks_cap = 0;
+    ap->elem_size = elem_size;
+}
+
+void arena_free(struct arena_st *ap) {
+    int i;
+
+    for (i = 0; i < ap->chunks_len; i++) {
+        free(ap->chunks[i]);
+    }
+    free(ap->chunks);
+    arena_init(ap, ap->elem_size);
+}
+
+static void arena_grow(struct arena_st *ap) {
+    char **chunks;
+    char *chunk;
+    int cap;
+
+    if (ap->chunks_len == ap->chunks_cap) {
+        cap = (ap->chunks_cap == 0) ? 8 : ap->chunks_cap * 2;
+        chunks = realloc(ap->chunks, cap * sizeof(char *));
+        if (chunks == NULL) {
+            printf("arena error: out of memory\n");
+            exit(-1);
+        }
+        ap->chunks = chunks;
+        ap->chunks_cap = cap;
+    }
+
+    chunk = malloc((size_t) ARENA_CHUNK_LEN * ap->elem_size);
+    if (chunk == NULL) {
+        printf("arena error: out of memory\n");
+        exit(-1);
+    }
+    ap->chunks[ap->chunks_len] = chunk;
+    ap->chunks_len += 1;
+}
+
+/* Get slot i, allocating chunks as needed. */
+void * arena_slot(struct arena_st *ap, int i) {
+    while ((i >> ARENA_CHUNK_SHIFT) >= ap->chunks_len) {
+        arena_grow(ap);
+    }
+    return arena_get(ap, i);
+}
+
+/* Move n slots from src to dst like memmove(); the ranges may overlap.
+ * All the slots must already have been returned by arena_slot(). Each
+ * step moves the longest run that stays within one chunk on both sides.
+ */
+void arena_move(struct arena_st *ap, int dst, int src, int n) {
+    int run, left;
+
+    if (dst == src || n == 0) {
+        return;
+    }
+    if (dst < src) {
+        while (n > 0) {
+            run = ARENA_CHUNK_LEN - (src & (ARENA_CHUNK_LEN - 1));
+            left = ARENA_CHUNK_LEN - (dst & (ARENA_CHUNK_LEN - 1));
+            run = (left < run) ? left : run;
+            run = (n < run) ? n : run;
+            memmove(arena_get(ap, dst), arena_get(ap, src),
+                    (size_t) run * ap->elem_size);
+            dst += run;
+            src += run;
+            n -= run;
+        }
+    } else {
+        /* Copy from the end so the source is read before it is overwritten */
+        dst += n;
+        src += n;
+        while (n > 0) {
+            run = ((src - 1) & (ARENA_CHUNK_LEN - 1)) + 1;
+            left = ((dst - 1) & (ARENA_CHUNK_LEN - 1)) + 1;
+            run = (left < run) ? left : run;
+            run = (n < run) ? n : run;
+            dst -= run;
+            src -= run;
+            n -= run;
+            memmove(arena_get(ap, dst), arena_get(ap, src),
+                    (size_t) run * ap->elem_size);
+        }
+    }
+}
@@ -0,0 +1,344 @@
+/* bench.c - benchmarks for the ntlang pipeline
+ *
+ * eval(), flat_eval() and vm_run(), with and without overflow checks
+ * scan_table_scan() alone and with parse_program()
+ * edit_update() against scanning and parsing from scratch
+ */
+
+#include "ntlang.h"
+#include <time.h>
+
+/* Each measurement evaluates about this many operators in total */
+#define BENCH_WORK (20 * 1000 * 1000)
+
+/* Each scan and parse measurement covers about this many operators, the
+   same as rust/benches/scan_parse.rs */
+#define BENCH_PARSE_WORK (2 * 1000 * 1000)
+
+/* Edits timed for each expression size */
+#define BENCH_EDITS 1000
+
+static double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Generate an expression with nopers binary operators. Operands are
+ * random literals, some of them negated, like the generated inputs we
+ * see in batch jobs.
+ */
+static char * bench_expr(int nopers) {
+    char *buf = malloc((size_t) (nopers + 1) * 16);
+    char *p = buf;
+    int i;
+
+    if (buf == NULL) {
+        printf("bench: out of memory\n");
+        exit(-1);
+    }
+    for (i = 0; i <= nopers; i++) {
+        if (i > 0) {
+            p += sprintf(p, " %c ", (rand() % 2) ? '+' : '-');
+        }
+        if (rand() % 8 == 0) {
+            *p++ = '-';
+        }
+        p += sprintf(p, "%d", rand() % 1000);
+    }
+    return buf;
+}
+
+static void bench_one(int nopers) {
+    struct scan_table_st st;
+    struct parse_table_st pt;
+    struct parse_node_st *np;
+    struct flat_table_st ft;
+    struct vm_prog_st vp, vp_checked;
+    value_t v_eval = 0, v_checked = 0, v_flat = 0, v_flat_checked = 0, v_vm = 0;
+    value_t v_vm_checked = 0;
+    double t0, t_eval, t_checked, t_flat, t_flat_checked, t_vm, t_vm_checked;
+    double t_build, t_compile;
+    char *input;
+    struct error_st err;
+    int reps, i;
+
+    reps = BENCH_WORK / nopers;
+    error_init(&err);
+    input = bench_expr(nopers);
+
+    scan_table_init(&st);
+    parse_table_init(&pt);
+    flat_table_init(&ft);
+    vm_prog_init(&vp);
+    vm_prog_init(&vp_checked);
+
+    scan_table_scan(&st, input, input + strlen(input));
+    np = parse_program(&pt, &st);
+
+    t0 = bench_now();
+    flat_table_build(&ft, np);
+    t_build = bench_now() - t0;
+
+    t0 = bench_now();
+    vm_compile(&vp, np, false);
+    t_compile = bench_now() - t0;
+    vm_compile(&vp_checked, np, true);
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_eval += eval(np, &err);
+    }
+    t_eval = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_checked += eval_checked(np, &err);
+    }
+    t_checked = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_flat += flat_eval(&ft);
+    }
+    t_flat = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_flat_checked += flat_eval_checked(&ft, &err);
+    }
+    t_flat_checked = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_vm += vm_run(&vp, &err);
+    }
+    t_vm = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        v_vm_checked += vm_run(&vp_checked, &err);
+    }
+    t_vm_checked = bench_now() - t0;
+
+    if (err.stage != ERR_NONE || v_eval != v_checked || v_eval != v_flat
+        || v_eval != v_flat_checked || v_eval != v_vm || v_eval != v_vm_checked) {
+        printf("bench: results differ for %d operators\n", nopers);
+        exit(-1);
+    }
+
+    printf("%9d %9d %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f %8.2fx %10.2f %10.2f\n",
+           nopers, reps,
+           t_eval * 1e9 / reps / nopers,
+           t_checked * 1e9 / reps / nopers,
+           t_flat * 1e9 / reps / nopers,
+           t_flat_checked * 1e9 / reps / nopers,
+           t_vm * 1e9 / reps / nopers,
+           t_vm_checked * 1e9 / reps / nopers,
+           t_eval / t_vm,
+           t_build * 1e9 / nopers,
+           t_compile * 1e9 / nopers);
+
+    scan_table_free(&st);
+    parse_table_free(&pt);
+    flat_table_free(&ft);
+    vm_prog_free(&vp);
+    vm_prog_free(&vp_checked);
+    free(input);
+}
+
+static void bench_parse_one(int nopers) {
+    struct scan_table_st st;
+    struct parse_table_st pt;
+    char *input = bench_expr(nopers);
+    char *end = input + strlen(input);
+    double t0, t_scan, t_parse;
+    int reps = BENCH_PARSE_WORK / nopers;
+    int i;
+
+    scan_table_init(&st);
+    parse_table_init(&pt);
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        scan_table_reset(&st);
+        scan_table_scan(&st, input, end);
+    }
+    t_scan = bench_now() - t0;
+
+    t0 = bench_now();
+    for (i = 0; i < reps; i++) {
+        scan_table_reset(&st);
+        scan_table_scan(&st, input, end);
+        parse_table_reset(&pt);
+        if (parse_program(&pt, &st) == NULL) {
+            printf("bench: parse error for %d operators\n", nopers);
+            exit(-1);
+        }
+    }
+    t_parse = bench_now() - t0;
+
+    printf("%9d %9d %10.2f %10.2f\n", nopers, reps,
+           t_scan * 1e9 / reps / nopers,
+           t_parse * 1e9 / reps / nopers);
+
+    scan_table_free(&st);
+    parse_table_free(&pt);
+    free(input);
+}
+
+/* Make one random edit to the len chars in buf at the first digit from
+ * p on. Returns the position of the edit and sets the number of chars
+ * it replaced and inserted. Every edit leaves a valid expression, and
+ * none adds more than 4 chars.
+ */
+static int bench_edit(char *buf, int p, int *len, int *old_len, int *new_len) {
+    int kind = rand() % 4;
+
+    while (!scan_is_digit(buf[p])) {
+        p = (p + 1) % *len;
+    }
+
+    /* Only delete a digit that has another one next to it */
+    if (kind == 2 && !scan_is_digit(buf[p + 1])
+        && !(p > 0 && scan_is_digit(buf[p - 1]))) {
+        kind = 0;
+    }
+
+    if (kind == 0) {
+        /* Change a digit */
+        buf[p] = '0' + (buf[p] - '0' + 1 + rand() % 9) % 10;
+        *old_len = 1;
+        *new_len = 1;
+    } else if (kind == 1) {
+        /* Insert a digit */
+        memmove(buf + p + 1, buf + p, *len - p);
+        buf[p] = '0' + rand() % 10;
+        *old_len = 0;
+        *new_len = 1;
+    } else if (kind == 2) {
+        /* Delete a digit */
+        memmove(buf + p, buf + p + 1, *len - p - 1);
+        *old_len = 1;
+        *new_len = 0;
+    } else {
+        /* Insert an operand before a literal */
+        while (p > 0 && scan_is_digit(buf[p - 1])) {
+            p -= 1;
+        }
+        memmove(buf + p + 4, buf + p, *len - p);
+        memcpy(buf + p, "7 + ", 4);
+        *old_len = 0;
+        *new_len = 4;
+    }
+    *len += *new_len - *old_len;
+    return p;
+}
+
+static void bench_edit_one(int nopers) {
+    struct edit_st ed;
+    struct scan_table_st st;
+    struct parse_table_st pt;
+    struct parse_node_st *np_edit, *np_full;
+    struct error_st err;
+    double t0, t_edit = 0, t_full = 0;
+    long rescanned = 0, reparsed = 0;
+    char *input = bench_expr(nopers);
+    int len = strlen(input);
+    char *buf = malloc(len + 4 * BENCH_EDITS + 1);
+    int i, pos, old_len, new_len;
+
+    if (buf == NULL) {
+        printf("bench: out of memory\n");
+        exit(-1);
+    }
+    memcpy(buf, input, len);
+    error_init(&err);
+
+    edit_init(&ed);
+    scan_table_init(&st);
+    parse_table_init(&pt);
+    edit_load(&ed, buf, buf + len);
+
+    /* Like someone typing, most edits are near the one before, with an
+       occasional jump to somewhere else */
+    pos = rand() % len;
+    for (i = 0; i < BENCH_EDITS; i++) {
+        if (rand() % 50 == 0) {
+            pos = rand() % len;
+        } else {
+            pos = (pos + len + rand() % 32 - 16) % len;
+        }
+        pos = bench_edit(buf, pos, &len, &old_len, &new_len);
+
+        t0 = bench_now();
+        np_edit = edit_update(&ed, buf, buf + len, pos, old_len, new_len);
+        t_edit += bench_now() - t0;
+        rescanned += ed.rescanned;
+        reparsed += ed.reparsed;
+
+        t0 = bench_now();
+        scan_table_reset(&st);
+        scan_table_scan(&st, buf, buf + len);
+        parse_table_reset(&pt);
+        np_full = parse_program(&pt, &st);
+        t_full += bench_now() - t0;
+
+        if (np_edit == NULL || np_full == NULL
+            || ed.scan.len != st.len || eval(np_edit, &err) != eval(np_full, &err)) {
+            printf("bench: edit %d differs from a full parse for %d operators\n",
+                   i, nopers);
+            exit(-1);
+        }
+    }
+
+    printf("%9d %9d %10.2f %10.2f %8.2fx %10.1f %10.1f\n",
+           nopers, BENCH_EDITS,
+           t_full * 1e6 / BENCH_EDITS,
+           t_edit * 1e6 / BENCH_EDITS,
+           t_full / t_edit,
+           (double) rescanned / BENCH_EDITS,
+           (double) reparsed / BENCH_EDITS);
+
+    edit_free(&ed);
+    scan_table_free(&st);
+    parse_table_free(&pt);
+    free(buf);
+    free(input);
+}
+
+int main(void) {
+    int sizes[] = {10, 1000, 100000};
+    int i;
+
+    srand(1);
+
+    printf("ns per operator (build and compile are one-time costs, the checked\n"
+           "columns are the evaluator before them with --overflow)\n\n");
+    printf("%9s %9s %10s %10s %10s %10s %10s %10s %9s %10s %10s\n",
+           "operators", "reps", "eval", "checked", "flat_eval", "checked", "vm_run",
+           "checked", "speedup", "build", "compile");
+
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+        bench_one(sizes[i]);
+    }
+
+    printf("\nns per operator to scan, and to scan and parse\n\n");
+    printf("%9s %9s %10s %10s\n", "operators", "reps", "scan", "parse");
+
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+        bench_parse_one(sizes[i]);
+    }
+
+    printf("\nus per edit, scan and parse from scratch vs edit_update()\n\n");
+    printf("%9s %9s %10s %10s %9s %10s %10s\n",
+           "operators", "edits", "full", "edit", "speedup",
+           "rescanned", "reparsed");
+
+    for (i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++) {
+        bench_edit_one(sizes[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,205 @@
+/* cache.c - LRU cache of expression results keyed on normalized input */
+
+#include "ntlang.h"
+
+/* The cache maps the text of an expression to its value so that a
+ * repeated expression skips scanning, parsing and evaluation.
+ *
+ * Keys are normalized first: whitespace is dropped unless it separates
+ * two digits (where removing it would change the tokens), so "1+2" and
+ * " 1 +  2" share an entry. Entries are found through a hash table of
+ * chains and kept on a doubly linked list in recency order; when the
+ * cache is full the least recently used entry is reused.
+ */
+
+#define CACHE_NONE (-1)
+
+static uint64_t cache_hash(char *key, int len) {
+    /* FNV-1a */
+    uint64_t h = 14695981039346656037ULL;
+    int i;
+
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char) key[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void cache_init(struct cache_st *cp, int len) {
+    int i;
+
+    cp->entries = calloc(len, sizeof(struct cache_entry_st));
+    /* Keep the bucket count a power of two around twice the entry count */
+    cp->buckets_len = 1;
+    while (cp->buckets_len < len * 2) {
+        cp->buckets_len *= 2;
+    }
+    cp->buckets = malloc(cp->buckets_len * sizeof(int));
+    if (cp->entries == NULL || cp->buckets == NULL) {
+        printf("cache error: out of memory\n");
+        exit(-1);
+    }
+    for (i = 0; i < cp->buckets_len; i++) {
+        cp->buckets[i] = CACHE_NONE;
+    }
+    cp->len = 0;
+    cp->cap = len;
+    cp->head = CACHE_NONE;
+    cp->tail = CACHE_NONE;
+    cp->key = NULL;
+    cp->key_len = 0;
+    cp->key_cap = 0;
+    cp->hits = 0;
+    cp->misses = 0;
+    cp->evictions = 0;
+}
+
+void cache_free(struct cache_st *cp) {
+    int i;
+
+    for (i = 0; i < cp->len; i++) {
+        free(cp->entries[i].key);
+    }
+    free(cp->entries);
+    free(cp->buckets);
+    free(cp->key);
+}
+
+/* Normalize the len chars of input into cp->key and compute its hash. */
+static void cache_normalize(struct cache_st *cp, char *input, int len) {
+    char *p = input;
+    char *end = input + len;
+    char *q;
+    bool gap = false;
+
+    if (len + 1 > cp->key_cap) {
+        cp->key_cap = len + 1;
+        cp->key = realloc(cp->key, cp->key_cap);
+        if (cp->key == NULL) {
+            printf("cache error: out of memory\n");
+            exit(-1);
+        }
+    }
+
+    q = cp->key;
+    for (; p < end; p++) {
+        if (scan_is_whitespace(*p)) {
+            gap = true;
+            continue;
+        }
+        if (gap && q > cp->key && scan_is_digit(q[-1]) && scan_is_digit(*p)) {
+            *q++ = ' ';
+        }
+        gap = false;
+        *q++ = *p;
+    }
+    cp->key_len = q - cp->key;
+    cp->key_hash = cache_hash(cp->key, cp->key_len);
+}
+
+static void cache_unlink(struct cache_st *cp, int i) {
+    struct cache_entry_st *ep = &cp->entries[i];
+
+    if (ep->prev != CACHE_NONE) {
+        cp->entries[ep->prev].next = ep->next;
+    } else {
+        cp->head = ep->next;
+    }
+    if (ep->next != CACHE_NONE) {
+        cp->entries[ep->next].prev = ep->prev;
+    } else {
+        cp->tail = ep->prev;
+    }
+}
+
+static void cache_push_front(struct cache_st *cp, int i) {
+    struct cache_entry_st *ep = &cp->entries[i];
+
+    ep->prev = CACHE_NONE;
+    ep->next = cp->head;
+    if (cp->head != CACHE_NONE) {
+        cp->entries[cp->head].prev = i;
+    }
+    cp->head = i;
+    if (cp->tail == CACHE_NONE) {
+        cp->tail = i;
+    }
+}
+
+/* Look up the len chars of input. On a hit, store the cached value in *value and return
+ * true. On a miss, return false; the caller evaluates the expression and
+ * passes the result to cache_insert() before the next lookup.
+ */
+bool cache_lookup(struct cache_st *cp, char *input, int len, value_t *value) {
+    struct cache_entry_st *ep;
+    int i;
+
+    cache_normalize(cp, input, len);
+
+    i = cp->buckets[cp->key_hash & (cp->buckets_len - 1)];
+    while (i != CACHE_NONE) {
+        ep = &cp->entries[i];
+        if (ep->hash == cp->key_hash && ep->key_len == cp->key_len
+            && memcmp(ep->key, cp->key, cp->key_len) == 0) {
+            cache_unlink(cp, i);
+            cache_push_front(cp, i);
+            *value = ep->value;
+            cp->hits += 1;
+            return true;
+        }
+        i = ep->chain;
+    }
+
+    cp->misses += 1;
+    return false;
+}
+
+/* Add the value for the key of the last cache_lookup() miss. */
+void cache_insert(struct cache_st *cp, value_t value) {
+    struct cache_entry_st *ep;
+    int *link;
+    int i;
+
+    if (cp->len < cp->cap) {
+        i = cp->len;
+        cp->len += 1;
+    } else {
+        /* Reuse the least recently used entry */
+        i = cp->tail;
+        cache_unlink(cp, i);
+        link = &cp->buckets[cp->entries[i].hash & (cp->buckets_len - 1)];
+        while (*link != i) {
+            link = &cp->entries[*link].chain;
+        }
+        *link = cp->entries[i].chain;
+        cp->evictions += 1;
+    }
+
+    ep = &cp->entries[i];
+    if (cp->key_len > ep->key_cap) {
+        ep->key_cap = cp->key_len;
+        ep->key = realloc(ep->key, ep->key_cap);
+        if (ep->key == NULL) {
+            printf("cache error: out of memory\n");
+            exit(-1);
+        }
+    }
+    memcpy(ep->key, cp->key, cp->key_len);
+    ep->key_len = cp->key_len;
+    ep->hash = cp->key_hash;
+    ep->value = value;
+
+    link = &cp->buckets[ep->hash & (cp->buckets_len - 1)];
+    ep->chain = *link;
+    *link = i;
+    cache_push_front(cp, i);
+}
+
+void cache_print_stats(struct cache_st *cp, FILE *fp) {
+    long lookups = cp->hits + cp->misses;
+
+    fprintf(fp, "cache: entries=%d/%d hits=%ld misses=%ld evictions=%ld hit_rate=%.1f%%\n",
+            cp->len, cp->cap, cp->hits, cp->misses, cp->evictions,
+            (lookups == 0) ? 0.0 : 100.0 * cp->hits / lookups);
+}
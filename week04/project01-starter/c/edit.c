@@ -0,0 +1,348 @@
+/* edit.c - incremental scanning and parsing for interactive editing */
+
+#include "ntlang.h"
+
+/* An edit_st keeps the tokens and parse tree of an expression between
+ * edits. The top-level expression is a run of items, an operand with
+ * the operator before it, and the tree is a left-leaning spine with one
+ * OPER2 node per item:
+ *
+ *   1 + 2 - -3     items: "1", "+ 2", "- -3"
+ *
+ *   OPER2 MINUS            spine of item 2
+ *   ..OPER2 PLUS           spine of item 1
+ *   ....INTVAL 1           spine of item 0
+ *   ....INTVAL 2
+ *   ..OPER1 MINUS
+ *   ....INTVAL 3
+ *
+ * After an edit scan_table_rescan() says which tokens changed. Parsing
+ * restarts at the item holding the first of them, on top of the spine
+ * of the item before it, and stops as soon as it reaches the start of
+ * an old item past the damage. Linking that item's spine to the new
+ * nodes puts the whole tree back together, so the cost of an edit
+ * depends on the size of the damage, not of the expression. The tokens
+ * and items between this edit and the last one move across their gaps,
+ * which is cheap when edits are close together, as typing is.
+ *
+ * An edit that leaves a parse error keeps the items on both sides of
+ * the damage (see dirty_start in edit_st), so typing through invalid
+ * input like "1 + 2 +" on the way to "1 + 2 + 3" stays incremental.
+ *
+ * Replaced nodes stay in the parse table until there are more of them
+ * than live ones, and then the next edit parses from scratch. The tree
+ * is changed in place by later edits, so it must not be folded.
+ */
+
+void edit_init(struct edit_st *ep) {
+    scan_table_init(&ep->scan);
+    parse_table_init(&ep->parse);
+    ep->items = NULL;
+    ep->items_len = 0;
+    ep->items_cap = 0;
+    ep->gap = 0;
+    ep->gap_len = 0;
+    ep->gap_delta = 0;
+    ep->dirty_start = -1;
+    ep->dirty_end = -1;
+    ep->redo = NULL;
+    ep->redo_cap = 0;
+    ep->live = 0;
+    ep->root = NULL;
+    ep->rescanned = 0;
+    ep->reparsed = 0;
+}
+
+void edit_free(struct edit_st *ep) {
+    scan_table_free(&ep->scan);
+    parse_table_free(&ep->parse);
+    free(ep->items);
+    free(ep->redo);
+    edit_init(ep);
+}
+
+static struct edit_item_st * edit_grow(struct edit_item_st *items, int *cap,
+                                       int need) {
+    if (need <= *cap) {
+        return items;
+    }
+    while (*cap < need) {
+        *cap = (*cap == 0) ? 64 : *cap * 2;
+    }
+    items = realloc(items, *cap * sizeof(struct edit_item_st));
+    if (items == NULL) {
+        printf("edit error: out of memory\n");
+        exit(-1);
+    }
+    return items;
+}
+
+/* Item k (see the gap in edit_st) */
+static struct edit_item_st * edit_item(struct edit_st *ep, int k) {
+    return &ep->items[(k >= ep->gap) ? k + ep->gap_len : k];
+}
+
+/* The first token of item k */
+static int edit_tok(struct edit_st *ep, int k) {
+    return edit_item(ep, k)->tok + ((k >= ep->gap) ? ep->gap_delta : 0);
+}
+
+/* The item holding token tok, the last item if tok is the EOT */
+static int edit_find(struct edit_st *ep, int tok) {
+    int lo = 0, hi = ep->items_len - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi + 1) / 2;
+        if (edit_tok(ep, mid) <= tok) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+/* Move the gap to just before item k */
+static void edit_move_gap(struct edit_st *ep, int k) {
+    int i;
+
+    if (k > ep->gap) {
+        memmove(&ep->items[ep->gap], &ep->items[ep->gap + ep->gap_len],
+                (k - ep->gap) * sizeof(struct edit_item_st));
+        for (i = ep->gap; i < k; i++) {
+            ep->items[i].tok += ep->gap_delta;
+        }
+    } else if (k < ep->gap) {
+        memmove(&ep->items[k + ep->gap_len], &ep->items[k],
+                (ep->gap - k) * sizeof(struct edit_item_st));
+        for (i = k; i < ep->gap; i++) {
+            ep->items[i + ep->gap_len].tok -= ep->gap_delta;
+        }
+    }
+    ep->gap = k;
+}
+
+/* Make room for at least n items in the gap */
+static void edit_widen_gap(struct edit_st *ep, int n) {
+    int grow, tail;
+
+    if (ep->gap_len >= n) {
+        return;
+    }
+    grow = n + 64 + ep->items_len / 4;
+    tail = ep->items_len - ep->gap;
+    ep->items = edit_grow(ep->items, &ep->items_cap, ep->items_len + ep->gap_len + grow);
+    memmove(&ep->items[ep->gap + ep->gap_len + grow], &ep->items[ep->gap + ep->gap_len],
+            tail * sizeof(struct edit_item_st));
+    ep->gap_len += grow;
+}
+
+/* Replace old items [first, old) with the n items in redo and correct
+ * the tok of the items after them by delta. This opens the gap there,
+ * drops the old items into it and puts the new ones in front of it, as
+ * scan_table_rescan() does with tokens.
+ */
+static void edit_splice(struct edit_st *ep, int first, int old, int n, int delta) {
+    int i;
+
+    for (i = first; i < old; i++) {
+        ep->live -= edit_item(ep, i)->nodes;
+    }
+    edit_move_gap(ep, first);
+    ep->gap_len += old - first;
+    edit_widen_gap(ep, n);
+    for (i = 0; i < n; i++) {
+        ep->items[first + i] = ep->redo[i];
+        ep->live += ep->redo[i].nodes;
+    }
+    ep->gap += n;
+    ep->gap_len -= n;
+    ep->gap_delta += delta;
+    ep->items_len += n - (old - first);
+}
+
+/* Parse items from item first on until one ends at or past token end
+ * and an old item starts there, which means the token count before it
+ * changed by delta. Returns false on a parse error (see ep->parse.err).
+ */
+static bool edit_parse(struct edit_st *ep, int first, int end, int delta) {
+    struct scan_table_st *st = &ep->scan;
+    struct parse_table_st *pt = &ep->parse;
+    struct scan_token_st *tp;
+    struct parse_node_st *left, *np;
+    struct edit_item_st *ip;
+    int old = (first > 0) ? first : 1;     /* item 0 has no operator */
+    int n, nodes;
+    bool synced = false;
+
+    st->cur = (first > 0) ? edit_tok(ep, first) : 0;
+    left = (first > 0) ? edit_item(ep, first - 1)->spine : NULL;
+
+    for (n = 0; !synced; n++) {
+        tp = scan_table_get(st, 0);
+        if (left != NULL && tp->id != TK_PLUS && tp->id != TK_MINUS) {
+            break;
+        }
+        ep->redo = edit_grow(ep->redo, &ep->redo_cap, n + 1);
+        ip = &ep->redo[n];
+        ip->tok = st->cur;
+        nodes = pt->len;
+
+        if (left == NULL) {
+            np = parse_operand(pt, st);
+        } else {
+            scan_table_accept(st, TK_ANY);
+            np = parse_node_new(pt);
+            np->type = EX_OPER2;
+            np->oper2.oper = (tp->id == TK_PLUS) ? OP_PLUS : OP_MINUS;
+            np->oper2.left = left;
+            np->oper2.right = parse_operand(pt, st);
+            if (np->oper2.right == NULL) {
+                np = NULL;
+            }
+        }
+        if (np == NULL) {
+            break;
+        }
+        ip->nodes = pt->len - nodes;
+        ip->spine = np;
+        left = np;
+
+        /* Past the damage the tokens are the old ones moved by delta, so
+           an old item starting here starts the same run of items. */
+        if (st->cur >= end) {
+            while (old < ep->items_len && edit_tok(ep, old) < st->cur - delta) {
+                old += 1;
+            }
+            synced = old < ep->items_len && edit_tok(ep, old) == st->cur - delta;
+        }
+    }
+
+    if (!synced && np != NULL && !scan_table_accept(st, TK_EOT)) {
+        parse_error(pt, scan_table_get(st, 0), TK_EOT, "Expecting EOT");
+    }
+    if (pt->err.stage != ERR_NONE) {
+        /* The parser always stops at the bad token */
+        pt->err.pos = scan_table_pos(st, st->cur);
+        return false;
+    }
+
+    if (synced) {
+        edit_item(ep, old)->spine->oper2.left = left;
+    } else {
+        old = ep->items_len;
+    }
+    edit_splice(ep, first, old, n, delta);
+    ep->root = edit_item(ep, ep->items_len - 1)->spine;
+    ep->reparsed = n;
+    return true;
+}
+
+/* Parse the scanned tokens from scratch */
+static struct parse_node_st * edit_parse_all(struct edit_st *ep) {
+    parse_table_reset(&ep->parse);
+    ep->items_len = 0;
+    ep->gap = 0;
+    ep->gap_len = 0;
+    ep->gap_delta = 0;
+    ep->dirty_start = -1;
+    ep->dirty_end = -1;
+    ep->live = 0;
+    ep->root = NULL;
+    ep->reparsed = 0;
+
+    if (ep->scan.err.stage != ERR_NONE) {
+        ep->parse.err = ep->scan.err;
+        return NULL;
+    }
+    if (!edit_parse(ep, 0, 0, 0)) {
+        return NULL;
+    }
+    return ep->root;
+}
+
+/* Scan and parse the input from begin up to (not including) end.
+ * Returns the parse tree, or NULL on an error (see ep->parse.err).
+ */
+struct parse_node_st * edit_load(struct edit_st *ep, char *begin, char *end) {
+    struct scan_table_st *st = &ep->scan;
+    int old_len = st->len;
+
+    scan_table_reset(st);
+    scan_table_scan(st, begin, end);
+    st->damage.start = 0;
+    st->damage.old_end = old_len;
+    st->damage.new_end = st->len;
+    ep->rescanned = st->len;
+    return edit_parse_all(ep);
+}
+
+/* Update the parse tree after an edit replaced old_len characters at pos
+ * with new_len characters, giving the input from begin to end. Returns
+ * the tree, or NULL on an error (see ep->parse.err). The root node may
+ * change, but nodes outside the edit are kept.
+ */
+struct parse_node_st * edit_update(struct edit_st *ep, char *begin, char *end,
+                                   int pos, int old_len, int new_len) {
+    struct scan_table_st *st = &ep->scan;
+    struct parse_table_st *pt = &ep->parse;
+    struct scan_damage_st *dp = &st->damage;
+    int delta, start, stop, first, old;
+
+    if (!scan_table_rescan(st, begin, end, pos, old_len, new_len)) {
+        pt->err = st->err;
+        ep->items_len = 0;
+        ep->root = NULL;
+        ep->rescanned = st->len;
+        ep->reparsed = 0;
+        return NULL;
+    }
+    ep->rescanned = dp->new_end - dp->start;
+
+    /* After a scan error there is no tree to reuse, and once most nodes
+       are garbage starting over is cheaper than keeping it. */
+    if (ep->items_len == 0 || pt->len - ep->live > ep->live + ARENA_CHUNK_LEN) {
+        return edit_parse_all(ep);
+    }
+
+    /* The tokens to parse again: the damage and any dirty range left by
+       an earlier error, which this edit may have moved */
+    delta = dp->new_end - dp->old_end;
+    start = dp->start;
+    stop = dp->new_end;
+    if (ep->dirty_start >= 0) {
+        if (ep->dirty_start < start) {
+            start = ep->dirty_start;
+        }
+        if (ep->dirty_end >= dp->old_end) {
+            stop = (ep->dirty_end + delta > stop) ? ep->dirty_end + delta : stop;
+        }
+    } else if (dp->old_end == start && stop == start) {
+        /* Only whitespace changed, the tokens just moved */
+        ep->reparsed = 0;
+        return ep->root;
+    }
+
+    error_init(&pt->err);
+    first = edit_find(ep, start);
+    if (edit_parse(ep, first, stop, delta)) {
+        ep->dirty_start = -1;
+        ep->dirty_end = -1;
+        return ep->root;
+    }
+
+    /* Drop the items from first up to the first one past the damage,
+       whose tokens did not change, and remember the tokens in between */
+    for (old = first; old < ep->items_len && edit_tok(ep, old) < stop - delta; old++) {
+    }
+    ep->dirty_start = (first > 0) ? edit_tok(ep, first) : 0;
+    ep->dirty_end = (old < ep->items_len) ? edit_tok(ep, old) + delta : stop;
+    edit_splice(ep, first, old, 0, delta);
+    ep->root = NULL;
+    ep->reparsed = 0;
+    if (ep->items_len == 0) {
+        /* Nothing is left to build on */
+        ep->dirty_start = -1;
+    }
+    return NULL;
+}
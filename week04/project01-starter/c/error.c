@@ -0,0 +1,61 @@
+/* error.c - error reports shared by the scanner, parser and evaluators */
+
+#include "ntlang.h"
+
+/* No stage exits on bad input. Each records the first error it finds
+ * in an error_st and returns a failure value, and the driver decides
+ * whether to stop or to report the error and go on to the next input.
+ */
+
+static const char *error_stage_strings[] = {"no", "scan", "parse", "eval"};
+
+void error_init(struct error_st *ep) {
+    ep->stage = ERR_NONE;
+    ep->msg = NULL;
+    ep->pos = -1;
+    ep->len = 0;
+    ep->expected = TK_ANY;
+    ep->found = TK_ANY;
+}
+
+/* Record an error unless one has already been recorded. pos and len
+ * locate the offending text in the input, pos is -1 if there is none.
+ */
+void error_set(struct error_st *ep, enum error_stage_enum stage, char *msg,
+               int pos, int len) {
+    if (ep->stage != ERR_NONE) {
+        return;
+    }
+    ep->stage = stage;
+    ep->msg = msg;
+    ep->pos = pos;
+    ep->len = len;
+}
+
+/* Describe ep in buf (buf_len chars), for example:
+ *
+ *   scan error at 4: invalid char "x"
+ *   parse error at 3: Bad operand: expected TK_INTLIT, found TK_EOT
+ *
+ * input is the text that ep->pos refers to. Returns buf.
+ */
+char * error_format(struct error_st *ep, char *input, char *buf, int buf_len) {
+    int n;
+
+    if (ep->pos >= 0) {
+        n = snprintf(buf, buf_len, "%s error at %d: %s",
+                     error_stage_strings[ep->stage], ep->pos, ep->msg);
+    } else {
+        n = snprintf(buf, buf_len, "%s error: %s",
+                     error_stage_strings[ep->stage], ep->msg);
+    }
+
+    if (n < buf_len && ep->expected != TK_ANY) {
+        n += snprintf(buf + n, buf_len - n, ": expected %s, found %s",
+                      scan_token_name(ep->expected), scan_token_name(ep->found));
+    }
+    if (n < buf_len && ep->len > 0) {
+        snprintf(buf + n, buf_len - n, " \"%.*s\"", ep->len, input + ep->pos);
+    }
+    return buf;
+}
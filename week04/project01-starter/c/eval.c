@@ -2,44 +2,91 @@
 
 #include "ntlang.h"
 
-void eval_error(char *err) {
-    printf("eval_error: %s\n", err);
-    exit(-1);
+/* Record the first error in ep; the caller checks it after eval(). */
+void eval_error(struct error_st *ep, char *msg) {
+    error_set(ep, ERR_EVAL, msg, -1, 0);
 }
 
-uint32_t eval(struct parse_node_st *pt) {
-    uint32_t v1, v2;
+value_t eval(struct parse_node_st *pt, struct error_st *ep) {
+    value_t v1 = 0, v2;
 
     if (pt->type == EX_INTVAL) {
         v1 = pt->intval.value;
     } else if (pt->type == EX_OPER1) {
-        v1 = eval(pt->oper1.operand);
+        v1 = eval(pt->oper1.operand, ep);
         if (pt->oper1.oper == OP_MINUS) {
             v1 = -v1;
         } else {
-            eval_error("Bad operator");
+            eval_error(ep, "Bad operator");
         }
     } else if (pt->type == EX_OPER2) {
-        v1 = eval(pt->oper2.left);
-        v2 = eval(pt->oper2.right);
+        v1 = eval(pt->oper2.left, ep);
+        v2 = eval(pt->oper2.right, ep);
         if (pt->oper2.oper == OP_PLUS) {
             v1 = v1 + v2;
         } else if (pt->oper2.oper == OP_MINUS) {
             v1 = v1 - v2;
         } else {
-            eval_error("Bad operator");            
+            eval_error(ep, "Bad operator");
         }
     }
 
     return v1;
 }
 
-void eval_print(struct config_st *cp, uint32_t value) {
+/* Like eval(), but values are signed and an operator whose result does
+ * not fit in svalue_t is an error instead of wrapping. The builtins
+ * compile to the plain add or subtract and a branch on the overflow
+ * flag, so this costs little more than eval().
+ */
+value_t eval_checked(struct parse_node_st *pt, struct error_st *ep) {
+    svalue_t v1 = 0, v2;
+    bool overflow = false;
+
+    if (pt->type == EX_INTVAL) {
+        v1 = pt->intval.value;
+    } else if (pt->type == EX_OPER1) {
+        v1 = eval_checked(pt->oper1.operand, ep);
+        if (pt->oper1.oper == OP_MINUS) {
+            overflow = __builtin_sub_overflow((svalue_t) 0, v1, &v1);
+        } else {
+            eval_error(ep, "Bad operator");
+        }
+    } else if (pt->type == EX_OPER2) {
+        v1 = eval_checked(pt->oper2.left, ep);
+        v2 = eval_checked(pt->oper2.right, ep);
+        if (pt->oper2.oper == OP_PLUS) {
+            overflow = __builtin_add_overflow(v1, v2, &v1);
+        } else if (pt->oper2.oper == OP_MINUS) {
+            overflow = __builtin_sub_overflow(v1, v2, &v1);
+        } else {
+            eval_error(ep, "Bad operator");
+        }
+    }
+    if (overflow) {
+        eval_error(ep, "Integer overflow");
+    }
+
+    return v1;
+}
+
+/* Format value and a newline into buf, which holds EVAL_OUTPUT_LEN
+ * chars, and return the length. This lets batch workers collect their
+ * results in memory instead of writing to stdout.
+ */
+int eval_format(struct config_st *cp, value_t value, char *buf) {
     /*
      * Handle -b -w -u
      *
-     * Use your own conversion functions for uint32_t to string.
+     * Use your own conversion functions for value_t to string.
      */
 
-    printf("%d\n", value);
+    return snprintf(buf, EVAL_OUTPUT_LEN, "%" PRIdVALUE "\n", (svalue_t) value);
+}
+
+void eval_print(struct config_st *cp, value_t value) {
+    char buf[EVAL_OUTPUT_LEN];
+
+    eval_format(cp, value, buf);
+    fputs(buf, stdout);
 }
@@ -0,0 +1,233 @@
+/* flat.c - flattened postfix parse trees and iterative evaluation */
+
+#include "ntlang.h"
+
+/* A flat table holds a parse tree as an array of flat_node_st in postfix
+ * order: every node comes after its operands. Nodes refer to each other
+ * by 32-bit index rather than by pointer, and evaluation is a single
+ * forward loop over the array with an explicit value stack, so neither
+ * building nor evaluating the table recurses.
+ *
+ * For an OPER1 or OPER2 node at index i the right (or only) operand is
+ * the node at i - 1, so only the left operand of OPER2 is stored.
+ */
+
+static char *flat_op_strings[] = {"INTVAL", "NEG", "PLUS", "MINUS"};
+
+void flat_table_init(struct flat_table_st *ft) {
+    ft->nodes = NULL;
+    ft->len = 0;
+    ft->cap = 0;
+    ft->stack = NULL;
+    ft->stack_cap = 0;
+    ft->depth = 0;
+    ft->work = NULL;
+    ft->work_cap = 0;
+    error_init(&ft->err);
+}
+
+void flat_table_free(struct flat_table_st *ft) {
+    free(ft->nodes);
+    free(ft->stack);
+    free(ft->work);
+    flat_table_init(ft);
+}
+
+static void * flat_grow(void *p, int *cap, int need, int elem_size) {
+    int new_cap = (*cap == 0) ? ARENA_CHUNK_LEN : *cap;
+
+    if (need <= *cap) {
+        return p;
+    }
+    while (new_cap < need) {
+        new_cap *= 2;
+    }
+    p = realloc(p, (size_t) new_cap * elem_size);
+    if (p == NULL) {
+        printf("flat error: out of memory\n");
+        exit(-1);
+    }
+    *cap = new_cap;
+    return p;
+}
+
+static uint32_t flat_op(struct flat_table_st *ft, struct parse_node_st *np) {
+    if (np->type == EX_INTVAL) {
+        return FLAT_INTVAL;
+    } else if (np->type == EX_OPER1 && np->oper1.oper == OP_MINUS) {
+        return FLAT_NEG;
+    } else if (np->type == EX_OPER2 && np->oper2.oper == OP_PLUS) {
+        return FLAT_PLUS;
+    } else if (np->type == EX_OPER2 && np->oper2.oper == OP_MINUS) {
+        return FLAT_MINUS;
+    }
+    eval_error(&ft->err, "Bad operator");
+    return FLAT_INTVAL;
+}
+
+/* Flatten the tree rooted at np into ft, replacing its contents.
+ * Returns false (see ft->err) if the tree has an unknown operator.
+ *
+ * A preorder walk that visits the right operand before the left one
+ * produces the reverse of postfix order, so we walk the tree that way
+ * with an explicit stack and then reverse the array.
+ */
+bool flat_table_build(struct flat_table_st *ft, struct parse_node_st *np) {
+    struct flat_work_st *wp;
+    struct flat_node_st *fp, tmp;
+    int sp = 0;
+    int i, j, n, depth;
+
+    ft->len = 0;
+    error_init(&ft->err);
+
+    ft->work = flat_grow(ft->work, &ft->work_cap, 1, sizeof(struct flat_work_st));
+    ft->work[sp].np = np;
+    ft->work[sp].parent = -1;
+    sp += 1;
+
+    while (sp > 0) {
+        sp -= 1;
+        np = ft->work[sp].np;
+
+        if (ft->len == ft->cap) {
+            ft->nodes = flat_grow(ft->nodes, &ft->cap, ft->len + 1,
+                                  sizeof(struct flat_node_st));
+        }
+        fp = &ft->nodes[ft->len];
+        fp->op = flat_op(ft, np);
+        fp->arg = (np->type == EX_INTVAL) ? np->intval.value : 0;
+        /* Tell our parent where its left operand ended up */
+        if (ft->work[sp].parent >= 0) {
+            ft->nodes[ft->work[sp].parent].arg = ft->len;
+        }
+
+        /* Push left first so the right operand is visited first */
+        if (sp + 2 > ft->work_cap) {
+            ft->work = flat_grow(ft->work, &ft->work_cap, sp + 2,
+                                 sizeof(struct flat_work_st));
+        }
+        if (np->type == EX_OPER1) {
+            wp = &ft->work[sp++];
+            wp->np = np->oper1.operand;
+            wp->parent = -1;
+        } else if (np->type == EX_OPER2) {
+            wp = &ft->work[sp++];
+            wp->np = np->oper2.left;
+            wp->parent = ft->len;
+            wp = &ft->work[sp++];
+            wp->np = np->oper2.right;
+            wp->parent = -1;
+        }
+        ft->len += 1;
+    }
+
+    /* Reverse into postfix order and renumber the left operand indices */
+    n = ft->len;
+    for (i = 0, j = n - 1; i < j; i++, j--) {
+        tmp = ft->nodes[i];
+        ft->nodes[i] = ft->nodes[j];
+        ft->nodes[j] = tmp;
+    }
+    for (i = 0; i < n; i++) {
+        if (ft->nodes[i].op == FLAT_PLUS || ft->nodes[i].op == FLAT_MINUS) {
+            ft->nodes[i].arg = (n - 1) - ft->nodes[i].arg;
+        }
+    }
+
+    /* Size the value stack for the deepest point of the evaluation */
+    ft->depth = 0;
+    depth = 0;
+    for (i = 0; i < n; i++) {
+        if (ft->nodes[i].op == FLAT_INTVAL) {
+            depth += 1;
+            if (depth > ft->depth) {
+                ft->depth = depth;
+            }
+        } else if (ft->nodes[i].op != FLAT_NEG) {
+            depth -= 1;
+        }
+    }
+    ft->stack = flat_grow(ft->stack, &ft->stack_cap, ft->depth, sizeof(value_t));
+
+    return ft->err.stage == ERR_NONE;
+}
+
+value_t flat_eval(struct flat_table_st *ft) {
+    struct flat_node_st *fp = ft->nodes;
+    struct flat_node_st *end = ft->nodes + ft->len;
+    value_t *sp = ft->stack;
+
+    for (; fp < end; fp++) {
+        switch (fp->op) {
+        case FLAT_INTVAL:
+            *sp++ = fp->arg;
+            break;
+        case FLAT_NEG:
+            sp[-1] = -sp[-1];
+            break;
+        case FLAT_PLUS:
+            sp -= 1;
+            sp[-1] = sp[-1] + sp[0];
+            break;
+        case FLAT_MINUS:
+            sp -= 1;
+            sp[-1] = sp[-1] - sp[0];
+            break;
+        }
+    }
+
+    return sp[-1];
+}
+
+/* Like flat_eval(), but values are signed and an operator whose result
+ * does not fit in svalue_t is an error (see eval_checked()). The loop
+ * stops at the first overflow.
+ */
+value_t flat_eval_checked(struct flat_table_st *ft, struct error_st *ep) {
+    struct flat_node_st *fp = ft->nodes;
+    struct flat_node_st *end = ft->nodes + ft->len;
+    svalue_t *sp = (svalue_t *) ft->stack;
+    bool overflow = false;
+
+    for (; fp < end && !overflow; fp++) {
+        switch (fp->op) {
+        case FLAT_INTVAL:
+            *sp++ = fp->arg;
+            break;
+        case FLAT_NEG:
+            overflow = __builtin_sub_overflow((svalue_t) 0, sp[-1], &sp[-1]);
+            break;
+        case FLAT_PLUS:
+            sp -= 1;
+            overflow = __builtin_add_overflow(sp[-1], sp[0], &sp[-1]);
+            break;
+        case FLAT_MINUS:
+            sp -= 1;
+            overflow = __builtin_sub_overflow(sp[-1], sp[0], &sp[-1]);
+            break;
+        }
+    }
+    if (overflow) {
+        eval_error(ep, "Integer overflow");
+    }
+
+    return sp[-1];
+}
+
+void flat_table_print(struct flat_table_st *ft) {
+    struct flat_node_st *fp;
+    int i;
+
+    for (i = 0; i < ft->len; i++) {
+        fp = &ft->nodes[i];
+        printf("[%d] %s", i, flat_op_strings[fp->op]);
+        if (fp->op == FLAT_INTVAL) {
+            printf(" %" PRIdVALUE "\n", (svalue_t) fp->arg);
+        } else if (fp->op == FLAT_NEG) {
+            printf(" [%d]\n", i - 1);
+        } else {
+            printf(" [%d] [%d]\n", (int) fp->arg, i - 1);
+        }
+    }
+}
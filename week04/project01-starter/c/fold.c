@@ -0,0 +1,120 @@
+/* fold.c - constant folding over parse trees */
+
+#include "ntlang.h"
+
+/* fold_tree() rewrites constant subtrees bottom up:
+ *
+ *   OPER1 MINUS (INTVAL n)          => INTVAL -n
+ *   OPER1 MINUS (OPER1 MINUS x)     => x
+ *   OPER2 op (INTVAL a) (INTVAL b)  => INTVAL (a op b)
+ *
+ * Chains like "1 + 2 - 3 + ..." fold one operator at a time from the
+ * bottom of the left-leaning tree. Nodes are rewritten in place, so the
+ * folded tree still lives in the parse table that the parser used.
+ *
+ * The walk uses an explicit stack instead of recursion so that it works
+ * on trees of any depth.
+ *
+ * When checked (--overflow), a fold whose result does not fit in
+ * svalue_t is not made, so the evaluator still reports the overflow.
+ * Neither is -(-x) => x, which would hide an overflow in -x.
+ */
+
+void fold_init(struct fold_st *fs) {
+    fs->work = NULL;
+    fs->cap = 0;
+}
+
+void fold_free(struct fold_st *fs) {
+    free(fs->work);
+    fold_init(fs);
+}
+
+static void fold_push(struct fold_st *fs, int *sp, struct parse_node_st *np,
+                      struct parse_node_st **slot) {
+    if (*sp == fs->cap) {
+        fs->cap = (fs->cap == 0) ? ARENA_CHUNK_LEN : fs->cap * 2;
+        fs->work = realloc(fs->work, fs->cap * sizeof(struct fold_work_st));
+        if (fs->work == NULL) {
+            printf("fold error: out of memory\n");
+            exit(-1);
+        }
+    }
+    fs->work[*sp].np = np;
+    fs->work[*sp].slot = slot;
+    fs->work[*sp].visited = false;
+    *sp += 1;
+}
+
+/* Fold np, whose operands have already been folded. Returns the node
+ * that replaces np in its parent.
+ */
+static struct parse_node_st * fold_node(struct parse_node_st *np, bool checked) {
+    struct parse_node_st *l, *r;
+    svalue_t v;
+
+    if (np->type == EX_OPER1 && np->oper1.oper == OP_MINUS) {
+        r = np->oper1.operand;
+        if (r->type == EX_INTVAL) {
+            if (checked && __builtin_sub_overflow((svalue_t) 0, (svalue_t) r->intval.value, &v)) {
+                return np;
+            }
+            np->type = EX_INTVAL;
+            np->intval.value = -r->intval.value;
+        } else if (r->type == EX_OPER1 && r->oper1.oper == OP_MINUS && !checked) {
+            return r->oper1.operand;
+        }
+    } else if (np->type == EX_OPER2) {
+        l = np->oper2.left;
+        r = np->oper2.right;
+        if (l->type == EX_INTVAL && r->type == EX_INTVAL) {
+            if (np->oper2.oper == OP_PLUS) {
+                if (checked && __builtin_add_overflow((svalue_t) l->intval.value,
+                                                      (svalue_t) r->intval.value, &v)) {
+                    return np;
+                }
+                np->type = EX_INTVAL;
+                np->intval.value = l->intval.value + r->intval.value;
+            } else if (np->oper2.oper == OP_MINUS) {
+                if (checked && __builtin_sub_overflow((svalue_t) l->intval.value,
+                                                      (svalue_t) r->intval.value, &v)) {
+                    return np;
+                }
+                np->type = EX_INTVAL;
+                np->intval.value = l->intval.value - r->intval.value;
+            }
+        }
+    }
+    return np;
+}
+
+struct parse_node_st * fold_tree(struct fold_st *fs, struct parse_node_st *np,
+                                 bool checked) {
+    struct fold_work_st *wp;
+    struct parse_node_st *root = np;
+    int sp = 0;
+
+    fold_push(fs, &sp, root, &root);
+
+    while (sp > 0) {
+        wp = &fs->work[sp - 1];
+        np = wp->np;
+
+        if (wp->visited) {
+            /* Operands are done, fold this node into its parent's slot */
+            *wp->slot = fold_node(np, checked);
+            sp -= 1;
+            continue;
+        }
+
+        wp->visited = true;
+        if (np->type == EX_OPER1) {
+            fold_push(fs, &sp, np->oper1.operand, &np->oper1.operand);
+        } else if (np->type == EX_OPER2) {
+            fold_push(fs, &sp, np->oper2.right, &np->oper2.right);
+            fold_push(fs, &sp, np->oper2.left, &np->oper2.left);
+        }
+    }
+
+    return root;
+}
@@ -1,5 +1,6 @@
 /* ntlang.h - header file for project01 (ntlang) */
 
+#include <inttypes.h>
 #include <stdbool.h> 
 #include <stdio.h>
 #include <stdint.h>
@@ -7,6 +8,61 @@
 #include <string.h>
 
 
+/*
+ * Values
+ */
+
+/* The width of ntlang values, chosen at build time with
+ * make VALUE_BITS=64 (after a make clean). Arithmetic wraps at this
+ * width, except with --overflow (see eval_checked()). Values print as
+ * signed.
+ */
+#ifndef VALUE_BITS
+#define VALUE_BITS 32
+#endif
+
+#if VALUE_BITS == 32
+typedef uint32_t value_t;
+typedef int32_t svalue_t;
+#define SVALUE_MAX INT32_MAX
+#define PRIdVALUE PRId32
+#elif VALUE_BITS == 64
+typedef uint64_t value_t;
+typedef int64_t svalue_t;
+#define SVALUE_MAX INT64_MAX
+#define PRIdVALUE PRId64
+#else
+#error "VALUE_BITS must be 32 or 64"
+#endif
+
+/*
+ * arena.c
+ */
+
+#define ARENA_CHUNK_SHIFT 10
+#define ARENA_CHUNK_LEN (1 << ARENA_CHUNK_SHIFT)
+
+struct arena_st {
+    char **chunks;
+    int chunks_len;
+    int chunks_cap;
+    int elem_size;
+};
+
+void arena_init(struct arena_st *ap, int elem_size);
+void arena_free(struct arena_st *ap);
+void * arena_slot(struct arena_st *ap, int i);
+void arena_move(struct arena_st *ap, int dst, int src, int n);
+
+/* Get slot i, which must already have been returned by arena_slot().
+ * This is on the hot path of scanning and parsing, so it lives here
+ * where the compiler can inline it.
+ */
+static inline void * arena_get(struct arena_st *ap, int i) {
+    return ap->chunks[i >> ARENA_CHUNK_SHIFT]
+        + (size_t) (i & (ARENA_CHUNK_LEN - 1)) * ap->elem_size;
+}
+
 /*
  * scan.c
  */
@@ -27,10 +83,6 @@ whitespace ::= (' ' | '\t') (' ' | '\t')*
 
 */
 
-#define SCAN_TOKEN_LEN 32
-#define SCAN_TABLE_LEN 1024
-#define SCAN_INPUT_LEN 4096
-
 enum scan_token_enum {
     TK_INTLIT, /* 1, 22, 403 */
     TK_PLUS,   /* + */
@@ -47,23 +99,121 @@ enum scan_token_enum {
     "TK_ANY"\
 };
 
+/*
+ * error.c
+ */
+
+enum error_stage_enum {ERR_NONE, ERR_SCAN, ERR_PARSE, ERR_EVAL};
+
+/* The first error found in an input. pos and len locate the offending
+ * text (pos is -1 if there is none). For parse errors, expected is the
+ * token the parser wanted and found is the token it got; otherwise both
+ * are TK_ANY.
+ */
+struct error_st {
+    enum error_stage_enum stage;
+    char *msg;
+    int pos;
+    int len;
+    enum scan_token_enum expected;
+    enum scan_token_enum found;
+};
+
+/* Room for a formatted error message */
+#define ERROR_MSG_LEN 256
+
+void error_init(struct error_st *ep);
+void error_set(struct error_st *ep, enum error_stage_enum stage, char *msg,
+               int pos, int len);
+char * error_format(struct error_st *ep, char *input, char *buf, int buf_len);
+
+/*
+ * scan_simd.c
+ */
+
+/* Character classes used by the scanner */
+enum scan_class_enum {
+    SCAN_CC_INVALID,
+    SCAN_CC_SPACE,
+    SCAN_CC_DIGIT,
+    SCAN_CC_PLUS,
+    SCAN_CC_MINUS,
+};
+
+extern const unsigned char scan_char_class[256];
+
+/* A scanner implementation. space and digit skip the run of whitespace
+ * or digits starting at p and return the first position after it.
+ */
+struct scan_ops_st {
+    char *name;
+    char * (*space)(char *p, char *end);
+    char * (*digit)(char *p, char *end);
+};
+
+const struct scan_ops_st * scan_ops_select(char *name);
+
+/* Tokens do not copy their text. pos and len locate the text from the
+ * begin pointer given to scan_table_scan(), and value holds the converted
+ * integer for TK_INTLIT.
+ */
 struct scan_token_st {
     enum scan_token_enum id;
-    char value[SCAN_TOKEN_LEN];
+    int pos;
+    int len;
+    value_t value;
+};
+
+/* The tokens the last scan_table_rescan() replaced: old tokens
+ * [start, old_end) became tokens [start, new_end), and the tokens after
+ * them only moved.
+ */
+struct scan_damage_st {
+    int start;
+    int old_end;
+    int new_end;
 };
 
+/* Errors do not exit. The first one is recorded in err and scanning
+ * stops there. If overflow is set, a literal above SVALUE_MAX is an
+ * error, otherwise it wraps.
+ *
+ * scan_table_rescan() leaves a gap of unused slots at the last edit so
+ * the next edit nearby moves few tokens. Tokens from gap on are stored
+ * gap_len slots further on, and their pos is gap_delta short. A full
+ * scan leaves no gap.
+ */
 struct scan_table_st {
-    struct scan_token_st table[SCAN_TABLE_LEN];
+    struct arena_st tokens;
+    const struct scan_ops_st *ops;
+    char *input;
     int len;
     int cur;
+    struct error_st err;
+    struct scan_damage_st damage;
+    int gap;
+    int gap_len;
+    int gap_delta;
+    struct scan_token_st *redo;     /* tokens rescanned by scan_table_rescan() */
+    int redo_cap;
+    bool overflow;
 };
 
-void scan_token_print(struct scan_token_st *tk);
+const char * scan_token_name(enum scan_token_enum id);
+void scan_token_print(struct scan_table_st *st, struct scan_token_st *tk);
 void scan_table_init(struct scan_table_st *st);
-void scan_table_scan(struct scan_table_st *st, char *input);
+void scan_table_reset(struct scan_table_st *st);
+void scan_table_free(struct scan_table_st *st);
+bool scan_table_select(struct scan_table_st *st, char *name);
+bool scan_table_scan(struct scan_table_st *st, char *begin, char *end);
+bool scan_table_rescan(struct scan_table_st *st, char *begin, char *end,
+                       int pos, int old_len, int new_len);
+int scan_table_pos(struct scan_table_st *st, int i);
 void scan_table_print(struct scan_table_st *st);
 struct scan_token_st * scan_table_get(struct scan_table_st *st, int i);
 bool scan_table_accept(struct scan_table_st *st, enum scan_token_enum tk_expected);
+bool scan_is_whitespace(char ch);
+bool scan_is_digit(char ch);
 
 /*
  * parse.c
@@ -88,7 +238,7 @@ enum parse_oper_enum {OP_PLUS, OP_MINUS, OP_MULT, OP_DIV};
 struct parse_node_st {
     enum parse_expr_enum type;
     union {
-        struct {uint32_t value;} intval;
+        struct {value_t value;} intval;
         struct {enum parse_oper_enum oper;
                 struct parse_node_st *operand;} oper1;
         struct {enum parse_oper_enum oper;
@@ -98,34 +248,276 @@ struct parse_node_st {
 };
 
 
-#define PARSE_TABLE_LEN 1024
-
 /* The parse_table_st is similar to the scan_table_st and is
  * used to allocatio parse_node_st structs so we can avoid
- * heap allocation.
+ * per-node heap allocation.
  */
 struct parse_table_st {
-    struct parse_node_st table[PARSE_TABLE_LEN];
+    struct arena_st nodes;
     int len;
+    struct error_st err;    /* first scan or parse error */
 };
 
 void parse_table_init(struct parse_table_st *pt);
+void parse_table_reset(struct parse_table_st *pt);
+void parse_table_free(struct parse_table_st *pt);
 struct parse_node_st * parse_node_new(struct parse_table_st *pt);
+void parse_error(struct parse_table_st *pt, struct scan_token_st *tp,
+                 enum scan_token_enum expected, char *msg);
 struct parse_node_st * parse_program(struct parse_table_st *pt,
                                         struct scan_table_st *st);
+struct parse_node_st * parse_operand(struct parse_table_st *pt,
+                                     struct scan_table_st *st);
 void parse_tree_print(struct parse_node_st *np);
 
+/*
+ * edit.c
+ */
+
+/* One operand of the top-level expression with the operator before it
+ * (item 0 has no operator). spine is the tree of the expression up to
+ * and including this item, so the root is the spine of the last item.
+ */
+struct edit_item_st {
+    int tok;                        /* first token of the item */
+    int nodes;                      /* parse nodes the item uses */
+    struct parse_node_st *spine;
+};
+
+/* An expression being edited. After each edit only the damaged tokens
+ * are scanned again and only the items around them parsed again; the
+ * rest of the tree is reused. The items have a gap at the last edit
+ * like the tokens do: items from gap on are stored gap_len entries
+ * further on, and their tok is gap_delta short.
+ *
+ * If an edit leaves a parse error, the items for tokens [dirty_start,
+ * dirty_end) are dropped and the rest kept, so the edit that fixes the
+ * error only parses that far.
+ */
+struct edit_st {
+    struct scan_table_st scan;
+    struct parse_table_st parse;    /* err holds the scan or parse error */
+    struct edit_item_st *items;
+    int items_len;                  /* 0 until the input has been parsed */
+    int items_cap;
+    int gap;
+    int gap_len;
+    int gap_delta;
+    int dirty_start;                /* -1 if the tree is complete */
+    int dirty_end;
+    struct edit_item_st *redo;      /* items parsed by edit_update() */
+    int redo_cap;
+    int live;                       /* parse nodes used by the items */
+    struct parse_node_st *root;     /* NULL on an error */
+    int rescanned;                  /* tokens scanned by the last edit */
+    int reparsed;                   /* items parsed by the last edit */
+};
+
+void edit_init(struct edit_st *ep);
+void edit_free(struct edit_st *ep);
+struct parse_node_st * edit_load(struct edit_st *ep, char *begin, char *end);
+struct parse_node_st * edit_update(struct edit_st *ep, char *begin, char *end,
+                                   int pos, int old_len, int new_len);
+
+/*
+ * flat.c
+ */
+
+enum flat_op_enum {FLAT_INTVAL, FLAT_NEG, FLAT_PLUS, FLAT_MINUS};
+
+/* A parse tree node in a flat postfix table. arg is the value of
+ * FLAT_INTVAL and the index of the left operand of FLAT_PLUS/FLAT_MINUS.
+ */
+struct flat_node_st {
+    uint32_t op;
+    value_t arg;
+};
+
+/* Pending node while flattening */
+struct flat_work_st {
+    struct parse_node_st *np;
+    int parent;
+};
+
+struct flat_table_st {
+    struct flat_node_st *nodes;
+    int len;
+    int cap;
+    value_t *stack;             /* value stack used by flat_eval() */
+    int stack_cap;
+    int depth;                  /* value stack depth the table needs */
+    struct flat_work_st *work;  /* traversal stack used by flat_table_build() */
+    int work_cap;
+    struct error_st err;        /* set if the tree could not be flattened */
+};
+
+void flat_table_init(struct flat_table_st *ft);
+void flat_table_free(struct flat_table_st *ft);
+bool flat_table_build(struct flat_table_st *ft, struct parse_node_st *np);
+value_t flat_eval(struct flat_table_st *ft);
+value_t flat_eval_checked(struct flat_table_st *ft, struct error_st *ep);
+void flat_table_print(struct flat_table_st *ft);
+
+/*
+ * vm.c
+ */
+
+/* The VM_C* ops are the overflow-checked forms of the ones above them,
+   which vm_compile() emits instead when asked to check. */
+enum vm_op_enum {VM_PUSH, VM_ADDI, VM_SUBI, VM_NEG, VM_ADD, VM_SUB, VM_HALT,
+                 VM_CADDI, VM_CSUBI, VM_CNEG, VM_CADD, VM_CSUB};
+
+struct vm_insn_st {
+    uint32_t op;
+    value_t arg;
+};
+
+struct vm_prog_st {
+    struct vm_insn_st *code;
+    int len;
+    int cap;
+    value_t *stack;
+    int stack_cap;
+    struct flat_table_st flat;  /* postfix form the code is compiled from */
+};
+
+void vm_prog_init(struct vm_prog_st *vp);
+void vm_prog_free(struct vm_prog_st *vp);
+bool vm_compile(struct vm_prog_st *vp, struct parse_node_st *np, bool checked);
+value_t vm_run(struct vm_prog_st *vp, struct error_st *ep);
+void vm_prog_print(struct vm_prog_st *vp);
+
+/*
+ * fold.c
+ */
+
+/* Pending node while folding */
+struct fold_work_st {
+    struct parse_node_st *np;
+    struct parse_node_st **slot;   /* where the folded node goes */
+    bool visited;                  /* operands already pushed */
+};
+
+struct fold_st {
+    struct fold_work_st *work;
+    int cap;
+};
+
+void fold_init(struct fold_st *fs);
+void fold_free(struct fold_st *fs);
+struct parse_node_st * fold_tree(struct fold_st *fs, struct parse_node_st *np,
+                                 bool checked);
+
+/*
+ * cache.c
+ */
+
+struct cache_entry_st {
+    uint64_t hash;
+    char *key;        /* normalized input text (not NUL terminated) */
+    int key_len;
+    int key_cap;
+    value_t value;
+    int chain;        /* next entry in the same hash bucket */
+    int prev, next;   /* recency list, most recent at head */
+};
+
+struct cache_st {
+    struct cache_entry_st *entries;
+    int len;
+    int cap;
+    int *buckets;
+    int buckets_len;
+    int head, tail;
+    char *key;        /* normalized key of the last lookup */
+    int key_len;
+    int key_cap;
+    uint64_t key_hash;
+    long hits;
+    long misses;
+    long evictions;
+};
+
+void cache_init(struct cache_st *cp, int len);
+void cache_free(struct cache_st *cp);
+bool cache_lookup(struct cache_st *cp, char *input, int len, value_t *value);
+void cache_insert(struct cache_st *cp, value_t value);
+void cache_print_stats(struct cache_st *cp, FILE *fp);
+
+/*
+ * stats.c
+ */
+
+struct stats_work_st {
+    struct parse_node_st *np;
+    int depth;                  /* depth of np, the root is 1 */
+};
+
+/* Counters for --stats. Times are the sum over all inputs, and the
+ * peaks are the largest seen for any one input.
+ */
+struct stats_st {
+    long inputs;        /* inputs scanned */
+    long tokens;
+    long nodes;
+    int scan_peak;      /* largest scan_table_st.len */
+    int parse_peak;     /* largest parse_table_st.len */
+    int eval_depth;     /* deepest tree evaluated */
+    int64_t scan_ns;
+    int64_t parse_ns;
+    int64_t eval_ns;
+    struct stats_work_st *work; /* traversal stack used by stats_eval() */
+    int work_cap;
+};
+
+void stats_init(struct stats_st *sp);
+void stats_free(struct stats_st *sp);
+int64_t stats_now(void);
+void stats_scan(struct stats_st *sp, struct scan_table_st *st, int64_t ns);
+void stats_parse(struct stats_st *sp, struct parse_table_st *pt, int64_t ns);
+void stats_eval(struct stats_st *sp, struct parse_node_st *np, int64_t ns);
+void stats_add(struct stats_st *total, struct stats_st *src);
+void stats_print(struct stats_st *sp, bool json, FILE *fp);
+
 /*
  * config
  */
 
+/* What --stats prints */
+enum stats_mode_enum {
+    STATS_OFF,
+    STATS_TEXT,     /* --stats: key=value lines */
+    STATS_JSON,     /* --stats-json: one JSON object */
+};
+
+/* How project01 evaluates a parse tree */
+enum eval_mode_enum {
+    EVAL_TREE,  /* eval(): recursive tree walk, single expressions only */
+    EVAL_FLAT,  /* --flat and -f: flat_eval() over a postfix table */
+    EVAL_VM,    /* --vm: vm_run() over compiled bytecode */
+};
+
 struct config_st {
-    char input[SCAN_INPUT_LEN];
+    char *input;
+    char *batch_path;   /* -f <file>: one expression per line, "-" is stdin */
+    char *scan_name;    /* --scan <name>: scanner implementation, NULL is auto */
+    enum eval_mode_enum eval_mode;
+    bool fold;          /* --fold: fold constant subtrees before evaluating */
+    bool overflow;      /* --overflow: signed overflow is an error, not a wrap */
+    int cache_len;      /* --cache <n>: cache n results in batch mode, 0 is off */
+    int jobs;           /* -j <n>: batch worker threads */
+    enum stats_mode_enum stats; /* --stats, --stats-json: print phase counters */
 };
 
 /*
  * eval.c
  */
 
-uint32_t eval(struct parse_node_st *pt);
-void eval_print(struct config_st *cp, uint32_t value);
+/* Room for one formatted value, including the newline */
+#define EVAL_OUTPUT_LEN 64
+
+void eval_error(struct error_st *ep, char *msg);
+value_t eval(struct parse_node_st *pt, struct error_st *ep);
+value_t eval_checked(struct parse_node_st *pt, struct error_st *ep);
+int eval_format(struct config_st *cp, value_t value, char *buf);
+void eval_print(struct config_st *cp, value_t value);
@@ -3,24 +3,46 @@
 #include "ntlang.h"
 
 void parse_table_init(struct parse_table_st *pt) {
+    arena_init(&pt->nodes, sizeof(struct parse_node_st));
     pt->len = 0;
+    error_init(&pt->err);
+}
+
+/* Empty the table for the next input, keeping its storage. */
+void parse_table_reset(struct parse_table_st *pt) {
+    pt->len = 0;
+    error_init(&pt->err);
+}
+
+void parse_table_free(struct parse_table_st *pt) {
+    arena_free(&pt->nodes);
+    parse_table_reset(pt);
 }
 
 struct parse_node_st * parse_node_new(struct parse_table_st *pt) {
     struct parse_node_st *np;
 
-    np = &(pt->table[pt->len]);
+    np = arena_slot(&pt->nodes, pt->len);
     pt->len += 1;
 
     return np;
 }
 
-void parse_error(char *err) {
-    printf("parse_error: %s\n", err);
-    exit(-1);
+/* Record the first error, at the token tp where the parser expected
+ * a different token. The parsing functions then return NULL all the
+ * way up to parse_program(), so nothing here ends the process.
+ */
+void parse_error(struct parse_table_st *pt, struct scan_token_st *tp,
+                 enum scan_token_enum expected, char *msg) {
+    if (pt->err.stage != ERR_NONE) {
+        return;
+    }
+    error_set(&pt->err, ERR_PARSE, msg, tp->pos, tp->len);
+    pt->err.expected = expected;
+    pt->err.found = tp->id;
 }
 
-char *parse_oper_strings[] = {"PLUS", "MINUS", "MULT", "DIV"};
+static const char *parse_oper_strings[] = {"PLUS", "MINUS", "MULT", "DIV"};
 
 
 /* We need to provide prototypes for the parsing functions because
@@ -39,11 +61,22 @@ struct parse_node_st * parse_program(struct parse_table_st *pt,
                                         struct scan_table_st *st) {
     struct parse_node_st *np1;
 
+    /* A scan error ended the token stream early, so report it rather
+       than parsing what came before it. */
+    if (st->err.stage != ERR_NONE) {
+        pt->err = st->err;
+        return NULL;
+    }
+
     /* A program is a single expression followed by EOT */
     np1 = parse_expression(pt, st);
+    if (np1 == NULL) {
+        return NULL;
+    }
 
     if (!scan_table_accept(st, TK_EOT)) {
-        parse_error("Expecting EOT");
+        parse_error(pt, scan_table_get(st, 0), TK_EOT, "Expecting EOT");
+        return NULL;
     }
 
     return np1;
@@ -56,6 +89,9 @@ struct parse_node_st * parse_expression(struct parse_table_st *pt,
 
     /* An expression must start with an operand. */
     np1 = parse_operand(pt, st);
+    if (np1 == NULL) {
+        return NULL;
+    }
 
     while (true) {
         tp = scan_table_get(st, 0);
@@ -73,6 +109,9 @@ struct parse_node_st * parse_expression(struct parse_table_st *pt,
             np2->oper2.left = np1;
             /* Now parse second operand */
             np2->oper2.right = parse_operand(pt, st);
+            if (np2->oper2.right == NULL) {
+                return NULL;
+            }
             np1 = np2;
         } else {
             break;
@@ -85,21 +124,32 @@ struct parse_node_st * parse_expression(struct parse_table_st *pt,
 struct parse_node_st * parse_operand(struct parse_table_st *pt,
                                      struct scan_table_st *st) {
     struct scan_token_st *tp;
-    struct parse_node_st *np1;
+    struct parse_node_st *np1, *np2;
+    struct parse_node_st **link;
+
+    /* A run of unary minus operators is handled with a loop rather than
+     * recursion so that long runs like "- - - ... 1" cannot exhaust
+     * the stack. link points to where the next operand will be stored.
+     */
+    link = &np1;
+    while (scan_table_accept(st, TK_MINUS)) {
+        np2 = parse_node_new(pt);
+        np2->type = EX_OPER1;
+        np2->oper1.oper = OP_MINUS;
+        *link = np2;
+        link = &np2->oper1.operand;
+    }
 
     if (scan_table_accept(st, TK_INTLIT)) {
         tp = scan_table_get(st, -1);
-        np1 = parse_node_new(pt);
-        np1->type = EX_INTVAL;
-        /* For Project01 you need to implement your own version of atoi() */
-        np1->intval.value = atoi(tp->value);
-    } else if (scan_table_accept(st, TK_MINUS)) {
-        np1 = parse_node_new(pt);
-        np1->type = EX_OPER1;
-        np1->oper1.oper = OP_MINUS;
-        np1->oper1.operand = parse_operand(pt, st);
+        np2 = parse_node_new(pt);
+        np2->type = EX_INTVAL;
+        /* The scanner has already converted the literal */
+        np2->intval.value = tp->value;
+        *link = np2;
     } else {
-        parse_error("Bad operand");
+        parse_error(pt, scan_table_get(st, 0), TK_INTLIT, "Bad operand");
+        return NULL;
     }
 
     return np1;
@@ -117,7 +167,7 @@ void parse_tree_print_expr(struct parse_node_st *np, int level) {
     printf("EXPR ");
 
     if (np->type == EX_INTVAL) {
-        printf("INTVAL %d\n", np->intval.value);
+        printf("INTVAL %" PRIdVALUE "\n", (svalue_t) np->intval.value);
     } else if (np->type == EX_OPER1) {
         printf("OPER1 %s\n", parse_oper_strings[np->oper1.oper]);
         parse_tree_print_expr(np->oper1.operand, level+1);
@@ -1,34 +1,706 @@
 /* project01.c - initial parsing implemenation */
 
 #include "ntlang.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-int main(int argc, char **argv) {
-    struct config_st config;
-    struct scan_table_st scan_table;
-    struct parse_table_st parse_table;
-    struct parse_node_st *parse_tree;
-    uint32_t value;
-    
-    if (argc != 2) {
-        printf("Usage: project01 <expression>\n");
-        printf("  Example: project01 \"1 + 2\"\n");
+#define BATCH_OUTPUT_BUF_LEN (1 << 16)
+#define BATCH_READ_LEN (1 << 20)
+#define BATCH_MAX_JOBS 256
+
+/* Printed in place of the value of a bad line, so output lines still
+ * match input lines. The error itself goes to stderr.
+ */
+#define BATCH_ERROR_OUTPUT "error\n"
+
+/* Tables used to evaluate a parse tree, reused between expressions */
+struct eval_tables_st {
+    struct fold_st fold;
+    struct flat_table_st flat;
+    struct vm_prog_st vm;
+};
+
+/* A bad line found by a -j worker, reported by the main thread */
+struct batch_bad_st {
+    long line;                  /* line number within the worker's chunk */
+    char *text;                 /* points into the input, not NUL terminated */
+    int text_len;
+    struct error_st err;
+};
+
+/* Batch input held in memory, mapped if it is a regular file */
+struct batch_input_st {
+    char *buf;
+    size_t len;
+    bool mapped;
+};
+
+/* Everything one batch worker uses. Workers share only the config and
+ * the (read-only) input, so the hot path takes no locks.
+ */
+struct batch_st {
+    struct config_st *cp;
+    struct scan_table_st scan;
+    struct parse_table_st parse;
+    struct eval_tables_st eval;
+    struct cache_st cache;
+    struct stats_st stats;
+    char *begin;                /* lines this worker evaluates */
+    char *end;
+    char *out;                  /* formatted results */
+    size_t out_len;
+    size_t out_cap;
+    FILE *out_fp;               /* if set, write out results as we go */
+    struct batch_bad_st *bad;   /* bad lines, when out_fp is not set */
+    int bad_len;
+    int bad_cap;
+    struct error_st err;        /* error for the last line evaluated */
+    long lines;                 /* input lines seen */
+    long errors;                /* input lines with errors */
+    pthread_t thread;
+};
+
+void usage(void) {
+    printf("Usage: project01 [options] <expression>\n");
+    printf("       project01 [options] -f <file>\n");
+    printf("  Options:\n");
+    printf("    --scan <auto|scalar|sse2|avx2|neon>  scanner implementation\n");
+    printf("    --flat  evaluate a flattened postfix tree without recursion (the -f default)\n");
+    printf("    --vm    compile to bytecode and run it on the VM\n");
+    printf("    --fold  fold constant subtrees before evaluating\n");
+    printf("    --overflow  signed overflow is an error, in every evaluator\n");
+    printf("    --cache <n>  with -f, reuse results of the last n distinct lines\n");
+    printf("    -j <n>  with -f, evaluate on n threads (results stay in order)\n");
+    printf("    --stats  print phase times and counters to stderr\n");
+    printf("    --stats-json  the same as one JSON object\n");
+    printf("  Example: project01 \"1 + 2\"\n");
+    printf("  Example: project01 -f exprs.txt   (use - for stdin)\n");
+    exit(-1);
+}
+
+void parse_args(struct config_st *cp, int argc, char **argv) {
+    int i;
+
+    cp->input = NULL;
+    cp->batch_path = NULL;
+    cp->scan_name = NULL;
+    cp->eval_mode = EVAL_TREE;
+    cp->fold = false;
+    cp->overflow = false;
+    cp->cache_len = 0;
+    cp->jobs = 1;
+    cp->stats = STATS_OFF;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            cp->batch_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            cp->jobs = atoi(argv[++i]);
+            if (cp->jobs < 1 || cp->jobs > BATCH_MAX_JOBS) {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--scan") == 0 && i + 1 < argc) {
+            cp->scan_name = argv[++i];
+        } else if (strcmp(argv[i], "--flat") == 0) {
+            cp->eval_mode = EVAL_FLAT;
+        } else if (strcmp(argv[i], "--vm") == 0) {
+            cp->eval_mode = EVAL_VM;
+        } else if (strcmp(argv[i], "--fold") == 0) {
+            cp->fold = true;
+        } else if (strcmp(argv[i], "--overflow") == 0) {
+            cp->overflow = true;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            cp->stats = STATS_TEXT;
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            cp->stats = STATS_JSON;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cp->cache_len = atoi(argv[++i]);
+            if (cp->cache_len <= 0) {
+                usage();
+            }
+        } else if (cp->input == NULL) {
+            /* Anything else is the expression, which may start with '-' */
+            cp->input = argv[i];
+        } else {
+            usage();
+        }
+    }
+
+    if ((cp->input == NULL) == (cp->batch_path == NULL)) {
+        usage();
+    }
+
+    /* eval() recurses once per operator, so a long batch line can blow
+     * the stack. Batch lines have no length limit, so walk a flat table
+     * instead; the results and errors are the same.
+     */
+    if (cp->batch_path != NULL && cp->eval_mode == EVAL_TREE) {
+        cp->eval_mode = EVAL_FLAT;
+    }
+}
+
+void scan_table_setup(struct config_st *cp, struct scan_table_st *st) {
+    scan_table_init(st);
+    if (!scan_table_select(st, cp->scan_name)) {
+        printf("project01: scanner %s not available\n", cp->scan_name);
         exit(-1);
     }
+    st->overflow = cp->overflow;
+}
+
+void eval_tables_init(struct eval_tables_st *et) {
+    fold_init(&et->fold);
+    flat_table_init(&et->flat);
+    vm_prog_init(&et->vm);
+}
+
+void eval_tables_free(struct eval_tables_st *et) {
+    fold_free(&et->fold);
+    flat_table_free(&et->flat);
+    vm_prog_free(&et->vm);
+}
+
+/* Evaluate a parse tree the way the config asks for. If verbose, also
+ * print the flat table or bytecode that was evaluated. Errors are
+ * recorded in ep, as with eval().
+ */
+value_t eval_expr(struct config_st *cp, struct eval_tables_st *et,
+                   struct parse_node_st *np, bool verbose, struct error_st *ep) {
+    if (cp->eval_mode == EVAL_FLAT) {
+        if (!flat_table_build(&et->flat, np)) {
+            *ep = et->flat.err;
+            return 0;
+        }
+        if (verbose) {
+            flat_table_print(&et->flat);
+            printf("\n");
+        }
+        if (cp->overflow) {
+            return flat_eval_checked(&et->flat, ep);
+        }
+        return flat_eval(&et->flat);
+    } else if (cp->eval_mode == EVAL_VM) {
+        if (!vm_compile(&et->vm, np, cp->overflow)) {
+            *ep = et->vm.flat.err;
+            return 0;
+        }
+        if (verbose) {
+            vm_prog_print(&et->vm);
+            printf("\n");
+        }
+        return vm_run(&et->vm, ep);
+    } else if (cp->overflow) {
+        return eval_checked(np, ep);
+    }
+    return eval(np, ep);
+}
 
-    strncpy(config.input, argv[1], SCAN_INPUT_LEN);
+/* Evaluate a single expression, printing the token table and parse tree. */
+void eval_single(struct config_st *cp) {
+    struct scan_table_st scan_table;
+    struct parse_table_st parse_table;
+    struct parse_node_st *parse_tree;
+    struct eval_tables_st eval_tables;
+    struct error_st err;
+    struct stats_st stats;
+    char msg[ERROR_MSG_LEN];
+    value_t value;
+    int64_t t0;
 
-    scan_table_init(&scan_table);
-    scan_table_scan(&scan_table, config.input);
+    /* On a scan error the table ends at the bad char, and the
+       error is reported by parse_program(). */
+    stats_init(&stats);
+    scan_table_setup(cp, &scan_table);
+    t0 = stats_now();
+    scan_table_scan(&scan_table, cp->input, cp->input + strlen(cp->input));
+    stats_scan(&stats, &scan_table, stats_now() - t0);
     scan_table_print(&scan_table);
     printf("\n");
-    
+
     parse_table_init(&parse_table);
+    t0 = stats_now();
     parse_tree = parse_program(&parse_table, &scan_table);
+    stats_parse(&stats, &parse_table, stats_now() - t0);
+    if (parse_tree == NULL) {
+        printf("%s\n", error_format(&parse_table.err, cp->input, msg, ERROR_MSG_LEN));
+        exit(-1);
+    }
     parse_tree_print(parse_tree);
     printf("\n");
 
-    value = eval(parse_tree);
-    eval_print(&config, value);
+    eval_tables_init(&eval_tables);
+    if (cp->fold) {
+        parse_tree = fold_tree(&eval_tables.fold, parse_tree, cp->overflow);
+        parse_tree_print(parse_tree);
+        printf("\n");
+    }
+    error_init(&err);
+    t0 = stats_now();
+    value = eval_expr(cp, &eval_tables, parse_tree, true, &err);
+    if (cp->stats != STATS_OFF) {
+        stats_eval(&stats, parse_tree, stats_now() - t0);
+    }
+    if (err.stage != ERR_NONE) {
+        printf("%s\n", error_format(&err, cp->input, msg, ERROR_MSG_LEN));
+        exit(-1);
+    }
+    eval_print(cp, value);
+    if (cp->stats != STATS_OFF) {
+        /* The eval time includes printing the flat table or bytecode */
+        stats_print(&stats, cp->stats == STATS_JSON, stderr);
+    }
+
+    scan_table_free(&scan_table);
+    parse_table_free(&parse_table);
+    eval_tables_free(&eval_tables);
+    stats_free(&stats);
+}
+
+void batch_init(struct batch_st *bp, struct config_st *cp) {
+    bp->cp = cp;
+    scan_table_setup(cp, &bp->scan);
+    parse_table_init(&bp->parse);
+    eval_tables_init(&bp->eval);
+    if (cp->cache_len > 0) {
+        cache_init(&bp->cache, cp->cache_len);
+    }
+    bp->begin = NULL;
+    bp->end = NULL;
+    bp->out = NULL;
+    bp->out_len = 0;
+    bp->out_cap = 0;
+    bp->out_fp = NULL;
+    bp->bad = NULL;
+    bp->bad_len = 0;
+    bp->bad_cap = 0;
+    error_init(&bp->err);
+    stats_init(&bp->stats);
+    bp->lines = 0;
+    bp->errors = 0;
+}
+
+void batch_free(struct batch_st *bp) {
+    scan_table_free(&bp->scan);
+    parse_table_free(&bp->parse);
+    eval_tables_free(&bp->eval);
+    if (bp->cp->cache_len > 0) {
+        cache_free(&bp->cache);
+    }
+    free(bp->out);
+    free(bp->bad);
+    stats_free(&bp->stats);
+}
+
+/* Evaluate the len chars of line as one batch input. Returns false and
+ * fills in bp->err if the line has an error. Nothing here exits or
+ * touches shared state, so it is safe to call from several threads
+ * with different bp.
+ */
+bool batch_eval_line(struct batch_st *bp, char *line, int len, value_t *value) {
+    struct config_st *cp = bp->cp;
+    struct parse_node_st *parse_tree;
+    bool timed = cp->stats != STATS_OFF;
+    int64_t t0 = 0, t1;
+
+    if (cp->cache_len > 0 && cache_lookup(&bp->cache, line, len, value)) {
+        return true;
+    }
+
+    /* Scan errors come back through parse_program() */
+    if (timed) {
+        t0 = stats_now();
+    }
+    scan_table_reset(&bp->scan);
+    scan_table_scan(&bp->scan, line, line + len);
+    if (timed) {
+        t1 = stats_now();
+        stats_scan(&bp->stats, &bp->scan, t1 - t0);
+        t0 = t1;
+    }
+
+    parse_table_reset(&bp->parse);
+    parse_tree = parse_program(&bp->parse, &bp->scan);
+    if (timed) {
+        stats_parse(&bp->stats, &bp->parse, stats_now() - t0);
+    }
+    if (parse_tree == NULL) {
+        bp->err = bp->parse.err;
+        return false;
+    }
+    if (cp->fold) {
+        parse_tree = fold_tree(&bp->eval.fold, parse_tree, cp->overflow);
+    }
+
+    error_init(&bp->err);
+    if (timed) {
+        t0 = stats_now();
+    }
+    *value = eval_expr(cp, &bp->eval, parse_tree, false, &bp->err);
+    if (timed) {
+        stats_eval(&bp->stats, parse_tree, stats_now() - t0);
+    }
+    if (bp->err.stage != ERR_NONE) {
+        return false;
+    }
+    if (cp->cache_len > 0) {
+        cache_insert(&bp->cache, *value);
+    }
+    return true;
+}
+
+/* Log a bad line to stderr */
+void batch_report(long line, char *text, int len, struct error_st *ep) {
+    char msg[ERROR_MSG_LEN];
+
+    fprintf(stderr, "project01: line %ld: %s: %.*s\n", line,
+            error_format(ep, text, msg, ERROR_MSG_LEN), len, text);
+}
+
+/* Print a summary of bad lines. Returns false if there were any. */
+bool batch_summary(long lines, long errors) {
+    if (errors > 0) {
+        fprintf(stderr, "project01: %ld of %ld lines had errors\n", errors, lines);
+    }
+    return errors == 0;
+}
+
+/* Evaluate newline-delimited expressions from stdin, one result per
+ * line. Lines are read one at a time so this works on pipes that never
+ * end. The scan and parse tables are reset (not reallocated) between
+ * lines and the debug output is skipped, so the cost per line is just
+ * scan + parse + eval. With --cache, a line that repeats a recent one
+ * skips all three; the cache counters go to stderr at the end.
+ * A bad line, including an empty one, is logged and printed as
+ * BATCH_ERROR_OUTPUT. Returns false if there were any.
+ */
+bool eval_batch_stream(struct config_st *cp) {
+    struct batch_st batch;
+    value_t value;
+    size_t line_cap = 0;
+    ssize_t len;
+    bool ok;
+
+    /* Results go out in large blocks instead of one write per line. */
+    setvbuf(stdout, NULL, _IOFBF, BATCH_OUTPUT_BUF_LEN);
+
+    batch_init(&batch, cp);
+
+    /* getline() grows cp->input as needed, so lines have no length limit. */
+    while ((len = getline(&cp->input, &line_cap, stdin)) != -1) {
+        batch.lines += 1;
+        /* Strip the line terminator */
+        len = strcspn(cp->input, "\r\n");
+
+        if (batch_eval_line(&batch, cp->input, len, &value)) {
+            eval_print(cp, value);
+        } else {
+            batch_report(batch.lines, cp->input, len, &batch.err);
+            batch.errors += 1;
+            fputs(BATCH_ERROR_OUTPUT, stdout);
+        }
+    }
+    fflush(stdout);
+
+    if (cp->cache_len > 0) {
+        cache_print_stats(&batch.cache, stderr);
+    }
+    if (cp->stats != STATS_OFF) {
+        stats_print(&batch.stats, cp->stats == STATS_JSON, stderr);
+    }
+    ok = batch_summary(batch.lines, batch.errors);
+    free(cp->input);
+    batch_free(&batch);
+    return ok;
+}
+
+/* Read all of fp into one buffer. */
+char * batch_read(FILE *fp, size_t *lenp) {
+    char *buf = NULL;
+    size_t len = 0;
+    size_t cap = 0;
+    size_t n;
+
+    do {
+        if (cap - len < BATCH_READ_LEN) {
+            cap = (cap == 0) ? BATCH_READ_LEN * 2 : cap * 2;
+            buf = realloc(buf, cap);
+            if (buf == NULL) {
+                printf("project01: out of memory\n");
+                exit(-1);
+            }
+        }
+        n = fread(buf + len, 1, BATCH_READ_LEN, fp);
+        len += n;
+    } while (n > 0);
+
+    *lenp = len;
+    return buf;
+}
+
+/* Make the batch input available as one block of memory. A regular
+ * file is mapped, so nothing is copied and the OS pages it in as the
+ * scanner reaches it. Anything else (stdin, a pipe) is read in.
+ */
+void batch_input_open(struct config_st *cp, struct batch_input_st *ip) {
+    struct stat sb;
+    FILE *fp;
+    int fd;
+
+    ip->buf = NULL;
+    ip->len = 0;
+    ip->mapped = false;
+
+    if (strcmp(cp->batch_path, "-") == 0) {
+        ip->buf = batch_read(stdin, &ip->len);
+        return;
+    }
+
+    fd = open(cp->batch_path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &sb) < 0) {
+        printf("project01: cannot open %s\n", cp->batch_path);
+        exit(-1);
+    }
+
+    if (S_ISREG(sb.st_mode)) {
+        ip->len = sb.st_size;
+        /* mmap() cannot map an empty file */
+        if (ip->len > 0) {
+            ip->buf = mmap(NULL, ip->len, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ip->buf == MAP_FAILED) {
+                printf("project01: cannot map %s\n", cp->batch_path);
+                exit(-1);
+            }
+            madvise(ip->buf, ip->len, MADV_SEQUENTIAL);
+            ip->mapped = true;
+        }
+        close(fd);
+    } else {
+        fp = fdopen(fd, "r");
+        ip->buf = batch_read(fp, &ip->len);
+        fclose(fp);
+    }
+}
+
+void batch_input_close(struct batch_input_st *ip) {
+    if (ip->mapped) {
+        munmap(ip->buf, ip->len);
+    } else {
+        free(ip->buf);
+    }
+}
+
+/* Make room for at least EVAL_OUTPUT_LEN more chars of output. If the
+ * output goes straight to out_fp, write out what we have instead of
+ * growing the buffer.
+ */
+void batch_out_reserve(struct batch_st *bp) {
+    if (bp->out_cap - bp->out_len >= EVAL_OUTPUT_LEN) {
+        return;
+    }
+    if (bp->out_fp != NULL && bp->out_len > 0) {
+        fwrite(bp->out, 1, bp->out_len, bp->out_fp);
+        bp->out_len = 0;
+        return;
+    }
+    bp->out_cap = (bp->out_cap == 0) ? BATCH_OUTPUT_BUF_LEN : bp->out_cap * 2;
+    bp->out = realloc(bp->out, bp->out_cap);
+    if (bp->out == NULL) {
+        printf("project01: out of memory\n");
+        exit(-1);
+    }
+}
+
+void batch_emit(struct batch_st *bp, value_t value) {
+    batch_out_reserve(bp);
+    bp->out_len += eval_format(bp->cp, value, bp->out + bp->out_len);
+}
+
+/* Report a bad line now if we write to out_fp, otherwise remember it
+ * for the main thread to report in order.
+ */
+void batch_emit_bad(struct batch_st *bp, char *line, int len) {
+    struct batch_bad_st *bad;
+
+    bp->errors += 1;
+    if (bp->out_fp != NULL) {
+        batch_report(bp->lines, line, len, &bp->err);
+    } else {
+        if (bp->bad_len == bp->bad_cap) {
+            bp->bad_cap = (bp->bad_cap == 0) ? 16 : bp->bad_cap * 2;
+            bp->bad = realloc(bp->bad, bp->bad_cap * sizeof(struct batch_bad_st));
+            if (bp->bad == NULL) {
+                printf("project01: out of memory\n");
+                exit(-1);
+            }
+        }
+        bad = &bp->bad[bp->bad_len];
+        bad->line = bp->lines;
+        bad->text = line;
+        bad->text_len = len;
+        bad->err = bp->err;
+        bp->bad_len += 1;
+    }
+
+    batch_out_reserve(bp);
+    memcpy(bp->out + bp->out_len, BATCH_ERROR_OUTPUT, strlen(BATCH_ERROR_OUTPUT));
+    bp->out_len += strlen(BATCH_ERROR_OUTPUT);
+}
+
+/* Evaluate the lines from begin to end. The input is only read, never
+ * written, so it can be a read-only mapping; each line is passed to the
+ * scanner by its begin and end.
+ */
+void * batch_worker(void *arg) {
+    struct batch_st *bp = arg;
+    char *line = bp->begin;
+    char *nl, *cr;
+    value_t value;
+    int len;
+
+    while (line < bp->end) {
+        nl = memchr(line, '\n', bp->end - line);
+        if (nl == NULL) {
+            nl = bp->end;
+        }
+        bp->lines += 1;
+
+        /* Strip the line terminator, including a CR before it */
+        cr = memchr(line, '\r', nl - line);
+        len = ((cr != NULL) ? cr : nl) - line;
+        if (batch_eval_line(bp, line, len, &value)) {
+            batch_emit(bp, value);
+        } else {
+            batch_emit_bad(bp, line, len);
+        }
+        line = nl + 1;
+    }
+
+    if (bp->out_fp != NULL) {
+        fwrite(bp->out, 1, bp->out_len, bp->out_fp);
+        bp->out_len = 0;
+    }
+    return NULL;
+}
+
+void batch_cache_add(struct cache_st *total, struct cache_st *cp) {
+    total->len += cp->len;
+    total->cap += cp->cap;
+    total->hits += cp->hits;
+    total->misses += cp->misses;
+    total->evictions += cp->evictions;
+}
+
+/* Evaluate a batch file that fits in memory (or is mapped into it).
+ *
+ * With one job, the lines are evaluated on this thread and results are
+ * written out in BATCH_OUTPUT_BUF_LEN blocks. With -j, the input is split
+ * into one line-aligned chunk per worker thread. Each worker has its own
+ * tables and cache and collects its results in its own buffer; the
+ * buffers are written out in chunk order, so the output is the same as
+ * with one thread. Returns false if any line had an error.
+ */
+bool eval_batch(struct config_st *cp) {
+    struct batch_input_st input;
+    struct batch_st *workers;
+    struct batch_st *bp;
+    struct cache_st cache_total;
+    struct stats_st stats_total;
+    char *p, *end, *last;
+    long lines = 0, errors = 0;
+    int i, j;
+    bool ok;
+
+    batch_input_open(cp, &input);
+
+    workers = calloc(cp->jobs, sizeof(struct batch_st));
+    if (workers == NULL) {
+        printf("project01: out of memory\n");
+        exit(-1);
+    }
+
+    p = input.buf;
+    last = input.buf + input.len;
+    for (i = 0; i < cp->jobs; i++) {
+        /* End each chunk just after the first newline past its share */
+        end = input.buf + input.len * (i + 1) / cp->jobs;
+        if (end < p) {
+            end = p;
+        }
+        if (i < cp->jobs - 1 && end < last) {
+            end = memchr(end, '\n', last - end);
+            end = (end == NULL) ? last : end + 1;
+        } else {
+            end = last;
+        }
+
+        bp = &workers[i];
+        batch_init(bp, cp);
+        bp->begin = p;
+        bp->end = end;
+        if (cp->jobs == 1) {
+            bp->out_fp = stdout;
+            batch_worker(bp);
+        } else if (pthread_create(&bp->thread, NULL, batch_worker, bp) != 0) {
+            printf("project01: cannot create thread\n");
+            exit(-1);
+        }
+        p = end;
+    }
+
+    /* Write each chunk as soon as it is done, in input order */
+    memset(&cache_total, 0, sizeof(cache_total));
+    stats_init(&stats_total);
+    for (i = 0; i < cp->jobs; i++) {
+        bp = &workers[i];
+        if (cp->jobs > 1) {
+            pthread_join(bp->thread, NULL);
+            fwrite(bp->out, 1, bp->out_len, stdout);
+        }
+        for (j = 0; j < bp->bad_len; j++) {
+            batch_report(lines + bp->bad[j].line, bp->bad[j].text,
+                         bp->bad[j].text_len, &bp->bad[j].err);
+        }
+        lines += bp->lines;
+        errors += bp->errors;
+        if (cp->cache_len > 0) {
+            batch_cache_add(&cache_total, &bp->cache);
+        }
+        stats_add(&stats_total, &bp->stats);
+    }
+    fflush(stdout);
+
+    if (cp->cache_len > 0) {
+        cache_print_stats(&cache_total, stderr);
+    }
+    if (cp->stats != STATS_OFF) {
+        stats_print(&stats_total, cp->stats == STATS_JSON, stderr);
+    }
+    ok = batch_summary(lines, errors);
+    for (i = 0; i < cp->jobs; i++) {
+        batch_free(&workers[i]);
+    }
+    free(workers);
+    batch_input_close(&input);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    struct config_st config;
+    bool ok = true;
+
+    parse_args(&config, argc, argv);
+
+    if (config.batch_path != NULL && config.jobs == 1
+        && strcmp(config.batch_path, "-") == 0) {
+        ok = eval_batch_stream(&config);
+    } else if (config.batch_path != NULL) {
+        ok = eval_batch(&config);
+    } else {
+        eval_single(&config);
+    }
 
-    return 0;
+    return ok ? 0 : -1;
 }
@@ -2,61 +2,147 @@
 
 #include "ntlang.h"
 
-char *scan_token_strings[] = SCAN_TOKEN_STRINGS;
+static const char *scan_token_strings[] = SCAN_TOKEN_STRINGS;
 
 void scan_table_init(struct scan_table_st *st) {
+    arena_init(&st->tokens, sizeof(struct scan_token_st));
+    st->ops = scan_ops_select(NULL);
+    st->input = NULL;
     st->len = 0;
     st->cur = 0;
+    error_init(&st->err);
+    st->gap = 0;
+    st->gap_len = 0;
+    st->gap_delta = 0;
+    st->damage.start = 0;
+    st->damage.old_end = 0;
+    st->damage.new_end = 0;
+    st->redo = NULL;
+    st->redo_cap = 0;
+    st->overflow = false;
 }
 
-void scan_token_print(struct scan_token_st *tp) {
-    printf("%s(\"%s\")\n", scan_token_strings[tp->id], tp->value);
+/* Empty the table for the next input, keeping its storage. */
+void scan_table_reset(struct scan_table_st *st) {
+    st->len = 0;
+    st->cur = 0;
+    error_init(&st->err);
+    st->gap = 0;
+    st->gap_len = 0;
+    st->gap_delta = 0;
+}
+
+void scan_table_free(struct scan_table_st *st) {
+    arena_free(&st->tokens);
+    free(st->redo);
+    st->redo = NULL;
+    st->redo_cap = 0;
+    scan_table_reset(st);
+}
+
+/* Use the named scanner implementation (see scan_ops_select()).
+ * Returns false if it is not available on this machine.
+ */
+bool scan_table_select(struct scan_table_st *st, char *name) {
+    const struct scan_ops_st *ops = scan_ops_select(name);
+
+    if (ops == NULL) {
+        return false;
+    }
+    st->ops = ops;
+    return true;
+}
+
+const char * scan_token_name(enum scan_token_enum id) {
+    return scan_token_strings[id];
+}
+
+void scan_token_print(struct scan_table_st *st, struct scan_token_st *tp) {
+    /* The token text is not stored in the token, print it from the input. */
+    printf("%s(\"%.*s\")\n", scan_token_strings[tp->id],
+           tp->len, st->input + tp->pos);
+}
+
+/* The slot holding token i (see the gap in scan_table_st) */
+static struct scan_token_st * scan_table_slot(struct scan_table_st *st, int i) {
+    if (i >= st->gap) {
+        i += st->gap_len;
+    }
+    return arena_get(&st->tokens, i);
 }
 
 void scan_table_print(struct scan_table_st *st) {
+    struct scan_token_st tk;
     int i;
 
     for (i = 0; i < st->len; i++) {
-        scan_token_print(&st->table[i]);
+        tk = *scan_table_slot(st, i);
+        if (i >= st->gap) {
+            tk.pos += st->gap_delta;
+        }
+        scan_token_print(st, &tk);
     }
 }
 
 struct scan_token_st * scan_table_new_token(struct scan_table_st *st) {
     /* Allocate a new token from the token table */
-    /* We just return a pointer to the next avaiable token in the array. */
+    /* We just return a pointer to the next avaiable token in the arena. */
     struct scan_token_st *tp;
 
-    tp = &(st->table[st->len]);
+    tp = arena_slot(&st->tokens, st->len);
     st->len += 1;
 
     return tp;
 }
 
 bool scan_is_whitespace(char ch) {
-    return (ch == ' ') || (ch == '\t');
+    return scan_char_class[(unsigned char) ch] == SCAN_CC_SPACE;
 }
 
-char *scan_whitespace(char *p, char *end) {
-    while(scan_is_whitespace(*p) && (p < end)) {
-        p += 1;
-    }
-    return p;
+bool scan_is_digit(char ch) {
+    return scan_char_class[(unsigned char) ch] == SCAN_CC_DIGIT;
 }
 
-bool scan_is_digit(char ch) {
-    return (ch >= '0' && ch <= '9');
+/* Whether the digits from p to stop are at most SVALUE_MAX */
+static bool scan_intlit_fits(char *p, char *stop) {
+    svalue_t value = 0;
+
+    for (; p < stop; p++) {
+        if (__builtin_mul_overflow(value, 10, &value)
+            || __builtin_add_overflow(value, *p - '0', &value)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-char * scan_intlit(char *p, char *end, struct scan_token_st *tp) {
-    int i = 0;
+char * scan_intlit(struct scan_table_st *st, char *p, char *end,
+                   struct scan_token_st *tp) {
+    /* Find the end of the digit run first, then convert the digits so
+       the parser does not need a second pass over the token text.
+       The value wraps at VALUE_BITS, unless st->overflow asks for an
+       error, which is only checked for literals long enough to need it. */
+    char *start = p;
+    char *stop = st->ops->digit(p, end);
+    value_t value = 0;
 
-    while (scan_is_digit(*p) && (p < end)) {
-        tp->value[i] = *p;
+    if (st->overflow && stop - start >= VALUE_BITS * 3 / 10
+        && !scan_intlit_fits(start, stop)) {
+        error_set(&st->err, ERR_SCAN, "literal overflow", start - st->input,
+                  stop - start);
+        tp->id = TK_EOT;
+        tp->len = 0;
+        tp->value = 0;
+        return start;
+    }
+
+    while (p < stop) {
+        value = (value * 10) + (*p - '0');
         p += 1;
-        i += 1;
     }
-    tp->value[i] = '\0';
     tp->id = TK_INTLIT;
+    tp->len = p - start;
+    tp->value = value;
 
     return p;
 }
@@ -64,19 +150,15 @@ char * scan_intlit(char *p, char *end, struct scan_token_st *tp) {
 char * scan_token_helper(struct scan_token_st *tp, char *p, int len,
                        enum scan_token_enum id) {
     /* Read a token starting a p for len characters.
-       Update the given token with the token string and token id. */
-    int i;
-
+       Update the given token with the token length and token id. */
     tp->id = id;
-    for (i = 0; i < len; i++) {
-        tp->value[i] = *p;
-        p += 1;
-    }
-    tp->value[i] = '\0';
-    return p;
+    tp->len = len;
+    tp->value = 0;
+    return p + len;
 }
 
-char * scan_token(char *p, char *end, struct scan_token_st *tp) {
+char * scan_token(struct scan_table_st *st, char *p, char *end,
+                  struct scan_token_st *tp) {
     /* Scan the next token at the current location in the input string */
     /* p points to the current location in the input string */
     /* end is a pointer to the end of the string */
@@ -85,54 +167,242 @@ char * scan_token(char *p, char *end, struct scan_token_st *tp) {
 
     if (p == end) {
         /* Check if we are at the end of the input string */
-        tp->value[0] = '\0';
         tp->id = TK_EOT;
-    } else if (scan_is_whitespace(*p)) {
+        tp->len = 0;
+        tp->value = 0;
+        return p;
+    }
+
+    /* One table lookup classifies the character */
+    switch (scan_char_class[(unsigned char) *p]) {
+    case SCAN_CC_SPACE:
         /* Ingore whitespace. Notice the recursive call. */
-        p = scan_whitespace(p, end);
-        p = scan_token(p, end, tp);
-    } else if (scan_is_digit(*p)) {
-        p = scan_intlit(p, end, tp);        
-    } else if (*p == '+') {
+        p = st->ops->space(p, end);
+        p = scan_token(st, p, end, tp);
+        break;
+    case SCAN_CC_DIGIT:
+        p = scan_intlit(st, p, end, tp);
+        break;
+    case SCAN_CC_PLUS:
         p = scan_token_helper(tp, p, 1, TK_PLUS);
-    } else if (*p == '-') {
+        break;
+    case SCAN_CC_MINUS:
         p = scan_token_helper(tp, p, 1, TK_MINUS);
-    } else {
-        /* Instead of returning an error code, we will usually
-           exit on failure. */
-        printf("scan error: invalid char: %c\n", *p);
-        exit(-1);
+        break;
+    default:
+        /* Record the error and end the token stream here. The caller
+           decides what to do, so one bad line need not end the process. */
+        error_set(&st->err, ERR_SCAN, "invalid char", p - st->input, 1);
+        tp->id = TK_EOT;
+        tp->len = 0;
+        tp->value = 0;
+        break;
     }
     return p;
 }
 
-/* Scan valid tokens in the given input string. */
-void scan_table_scan(struct scan_table_st *st, char *input) {
+/* Scan valid tokens in the input from begin up to (not including) end.
+ * The input does not need to be NUL terminated, so it can point into a
+ * larger buffer such as a memory-mapped file.
+ * Returns false if the input has an invalid character (see st->err).
+ */
+bool scan_table_scan(struct scan_table_st *st, char *begin, char *end) {
     struct scan_token_st *tp;
-    char *p = input;
-    char *end;
-    int len;
+    char *p = begin;
 
-    /* Get a pointer to the end of the input string. */
-    /* Technically this pointer points to the null termination character. */
-    len = strnlen(input, SCAN_INPUT_LEN);
-    end = p + len;
+    /* Tokens refer back to the input by offset, so remember it. */
+    st->input = begin;
 
     do {
         /* Allocate a token */
         tp = scan_table_new_token(st);
         /* Scan one token from input string */
-        p = scan_token(p, end, tp);
+        p = scan_token(st, p, end, tp);
+        /* The token text ends where scanning stopped. */
+        tp->pos = (p - begin) - tp->len;
         /* Are we done? */
         if (tp->id == TK_EOT) {
             break;
        }
     } while(true);
+
+    return st->err.stage == ERR_NONE;
+}
+
+/* Incremental scanning
+ *
+ * An edit can only change the tokens from the one touching it up to
+ * where the scanner, past the edit, starts a token at the same place in
+ * the text as it did before. Everything after that is the same tokens
+ * moved by the change in length. The tokens are kept around a gap at
+ * the last edit, see scan_table_st, so that replacing the damaged ones
+ * moves only the tokens between this edit and the last one, and the
+ * positions of the tokens after the gap are corrected all at once.
+ */
+
+/* The position of token i. After a rescan the pos of the tokens
+ * scan_table_get() returns may be off, so use this for them instead.
+ */
+int scan_table_pos(struct scan_table_st *st, int i) {
+    struct scan_token_st *tp = scan_table_slot(st, i);
+
+    return (i >= st->gap) ? tp->pos + st->gap_delta : tp->pos;
+}
+
+/* Index of the first token that ends at or after pos. The EOT token
+ * ends at the end of the input, so there is always one.
+ */
+static int scan_table_find(struct scan_table_st *st, int pos) {
+    int lo = 0, hi = st->len - 1, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (scan_table_pos(st, mid) + scan_table_slot(st, mid)->len >= pos) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+/* Move the gap to just before token i */
+static void scan_table_move_gap(struct scan_table_st *st, int i) {
+    struct scan_token_st *tp;
+    int j;
+
+    if (i > st->gap) {
+        arena_move(&st->tokens, st->gap, st->gap + st->gap_len, i - st->gap);
+        for (j = st->gap; j < i; j++) {
+            tp = arena_get(&st->tokens, j);
+            tp->pos += st->gap_delta;
+        }
+    } else if (i < st->gap) {
+        arena_move(&st->tokens, i + st->gap_len, i, st->gap - i);
+        for (j = i; j < st->gap; j++) {
+            tp = arena_get(&st->tokens, j + st->gap_len);
+            tp->pos -= st->gap_delta;
+        }
+    }
+    st->gap = i;
+}
+
+/* Make room for at least n tokens in the gap. The gap grows with the
+ * table, so that moving the tokens after it is rare.
+ */
+static void scan_table_widen_gap(struct scan_table_st *st, int n) {
+    int grow;
+
+    if (st->gap_len >= n) {
+        return;
+    }
+    grow = n + ARENA_CHUNK_LEN + st->len / 4;
+    arena_slot(&st->tokens, st->len + st->gap_len + grow - 1);
+    arena_move(&st->tokens, st->gap + st->gap_len + grow,
+               st->gap + st->gap_len, st->len - st->gap);
+    st->gap_len += grow;
+}
+
+static struct scan_token_st * scan_table_redo(struct scan_table_st *st, int i) {
+    if (i == st->redo_cap) {
+        st->redo_cap = (st->redo_cap == 0) ? 64 : st->redo_cap * 2;
+        st->redo = realloc(st->redo, st->redo_cap * sizeof(struct scan_token_st));
+        if (st->redo == NULL) {
+            printf("scan error: out of memory\n");
+            exit(-1);
+        }
+    }
+    return &st->redo[i];
+}
+
+/* Scan the whole input again, recording every token as damaged. */
+static bool scan_table_rescan_all(struct scan_table_st *st, char *begin,
+                                  char *end) {
+    int old_len = st->len;
+    bool ok;
+
+    scan_table_reset(st);
+    ok = scan_table_scan(st, begin, end);
+    st->damage.start = 0;
+    st->damage.old_end = old_len;
+    st->damage.new_end = st->len;
+    return ok;
+}
+
+/* Update the table after an edit replaced old_len characters at pos
+ * with new_len characters. begin and end are the edited input, which
+ * may have moved. Only the damaged tokens are scanned (see st->damage).
+ * Without a complete previous scan, or if the edit makes the input
+ * invalid, this falls back to a full scan.
+ * Returns false if the input has an invalid character (see st->err).
+ */
+bool scan_table_rescan(struct scan_table_st *st, char *begin, char *end,
+                       int pos, int old_len, int new_len) {
+    struct scan_token_st *tp;
+    int delta = new_len - old_len;
+    int edit_end = pos + new_len;
+    int first, old, n, i;
+    char *p = begin;
+
+    if (st->len == 0 || st->err.stage != ERR_NONE) {
+        return scan_table_rescan_all(st, begin, end);
+    }
+
+    /* Tokens that end before pos cannot change. The one after them may
+       grow into the edit ("12" becoming "123"), so start there. */
+    first = scan_table_find(st, pos);
+    if (first > 0) {
+        p = begin + scan_table_pos(st, first - 1) + scan_table_slot(st, first - 1)->len;
+    }
+    st->input = begin;
+
+    old = first;
+    for (n = 0; ; n++) {
+        tp = scan_table_redo(st, n);
+        p = scan_token(st, p, end, tp);
+        tp->pos = (p - begin) - tp->len;
+        if (st->err.stage != ERR_NONE) {
+            return scan_table_rescan_all(st, begin, end);
+        }
+        /* Stop at the first token past the edit that an old one matches */
+        if (tp->pos >= edit_end) {
+            while (old < st->len && scan_table_pos(st, old) < tp->pos - delta) {
+                old += 1;
+            }
+            if (old < st->len && scan_table_pos(st, old) == tp->pos - delta) {
+                break;
+            }
+        }
+        if (tp->id == TK_EOT) {
+            old = st->len;
+            n += 1;
+            break;
+        }
+    }
+
+    /* Old tokens [first, old) become the n tokens in redo: open the gap
+       there, drop them into it and put the new ones in front of it. */
+    scan_table_move_gap(st, first);
+    st->gap_len += old - first;
+    scan_table_widen_gap(st, n);
+    for (i = 0; i < n; i++) {
+        *(struct scan_token_st *) arena_get(&st->tokens, first + i) = st->redo[i];
+    }
+    st->gap += n;
+    st->gap_len -= n;
+    st->gap_delta += delta;
+
+    st->len += n - (old - first);
+    st->cur = 0;
+    st->damage.start = first;
+    st->damage.old_end = old;
+    st->damage.new_end = first + n;
+    return true;
 }
 
 /* Get the token at the current (cur) position + i in the token table. */
 struct scan_token_st * scan_table_get(struct scan_table_st *st, int i) {
-    return &(st->table[st->cur + i]);
+    return scan_table_slot(st, st->cur + i);
 }
 
 /* Accept the current token if it matches tk_expected.
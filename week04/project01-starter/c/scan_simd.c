@@ -0,0 +1,205 @@
+/* scan_simd.c - character classes and run scanning (scalar and SIMD) */
+
+#include "ntlang.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SCAN_NEON 1
+#endif
+
+/* Character class of every byte value. The scanner does one table lookup
+ * per character instead of a chain of comparisons. Bytes that are not
+ * listed are SCAN_CC_INVALID (0), which includes '\0'.
+ */
+const unsigned char scan_char_class[256] = {
+    [' ']  = SCAN_CC_SPACE,
+    ['\t'] = SCAN_CC_SPACE,
+    ['0' ... '9'] = SCAN_CC_DIGIT,
+    ['+']  = SCAN_CC_PLUS,
+    ['-']  = SCAN_CC_MINUS,
+};
+
+/* A run scanner returns a pointer to the first character in [p, end)
+ * that is not in its class, or end if they all are. The SIMD versions
+ * look at 16 or 32 characters per step and finish the last partial
+ * block with the scalar version, so they never read past end.
+ */
+
+char * scan_run_space_scalar(char *p, char *end) {
+    while (p < end && scan_char_class[(unsigned char) *p] == SCAN_CC_SPACE) {
+        p += 1;
+    }
+    return p;
+}
+
+char * scan_run_digit_scalar(char *p, char *end) {
+    while (p < end && scan_char_class[(unsigned char) *p] == SCAN_CC_DIGIT) {
+        p += 1;
+    }
+    return p;
+}
+
+#ifdef SCAN_X86
+
+/* SSE2 is part of the x86-64 baseline, so it is always available. */
+
+char * scan_run_space_sse2(char *p, char *end) {
+    __m128i sp = _mm_set1_epi8(' ');
+    __m128i tab = _mm_set1_epi8('\t');
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((__m128i *) p);
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab));
+        /* One bit per byte that is NOT whitespace */
+        unsigned int miss = ~_mm_movemask_epi8(m) & 0xFFFF;
+        if (miss != 0) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 16;
+    }
+    return scan_run_space_scalar(p, end);
+}
+
+char * scan_run_digit_sse2(char *p, char *end) {
+    __m128i zero = _mm_set1_epi8('0');
+    __m128i nine = _mm_set1_epi8(9);
+
+    while (end - p >= 16) {
+        __m128i v = _mm_sub_epi8(_mm_loadu_si128((__m128i *) p), zero);
+        /* v is a digit if (unsigned) v <= 9, i.e. min(v, 9) == v */
+        __m128i m = _mm_cmpeq_epi8(_mm_min_epu8(v, nine), v);
+        unsigned int miss = ~_mm_movemask_epi8(m) & 0xFFFF;
+        if (miss != 0) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 16;
+    }
+    return scan_run_digit_scalar(p, end);
+}
+
+/* AVX2 is optional, these are only called if the CPU reports it. */
+
+__attribute__((target("avx2")))
+char * scan_run_space_avx2(char *p, char *end) {
+    __m256i sp = _mm256_set1_epi8(' ');
+    __m256i tab = _mm256_set1_epi8('\t');
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i *) p);
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, sp),
+                                    _mm256_cmpeq_epi8(v, tab));
+        unsigned int miss = ~(unsigned int) _mm256_movemask_epi8(m);
+        if (miss != 0) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 32;
+    }
+    return scan_run_space_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+char * scan_run_digit_avx2(char *p, char *end) {
+    __m256i zero = _mm256_set1_epi8('0');
+    __m256i nine = _mm256_set1_epi8(9);
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_sub_epi8(_mm256_loadu_si256((__m256i *) p), zero);
+        __m256i m = _mm256_cmpeq_epi8(_mm256_min_epu8(v, nine), v);
+        unsigned int miss = ~(unsigned int) _mm256_movemask_epi8(m);
+        if (miss != 0) {
+            return p + __builtin_ctz(miss);
+        }
+        p += 32;
+    }
+    return scan_run_digit_sse2(p, end);
+}
+
+#endif /* SCAN_X86 */
+
+#ifdef SCAN_NEON
+
+/* NEON is part of the AArch64 baseline. NEON has no movemask, so we only
+ * use it to skip whole blocks and let the scalar loop find the exact
+ * position inside the first block that is not all in the class.
+ */
+
+char * scan_run_space_neon(char *p, char *end) {
+    uint8x16_t sp = vdupq_n_u8(' ');
+    uint8x16_t tab = vdupq_n_u8('\t');
+
+    while (end - p >= 16) {
+        uint8x16_t v = vld1q_u8((uint8_t *) p);
+        uint8x16_t m = vorrq_u8(vceqq_u8(v, sp), vceqq_u8(v, tab));
+        if (vminvq_u8(m) != 0xFF) {
+            break;
+        }
+        p += 16;
+    }
+    return scan_run_space_scalar(p, end);
+}
+
+char * scan_run_digit_neon(char *p, char *end) {
+    uint8x16_t zero = vdupq_n_u8('0');
+    uint8x16_t nine = vdupq_n_u8(9);
+
+    while (end - p >= 16) {
+        uint8x16_t v = vsubq_u8(vld1q_u8((uint8_t *) p), zero);
+        if (vmaxvq_u8(v) > 9) {
+            break;
+        }
+        p += 16;
+    }
+    return scan_run_digit_scalar(p, end);
+}
+
+#endif /* SCAN_NEON */
+
+/* Available implementations, from slowest to fastest. */
+static const struct scan_ops_st scan_ops_table[] = {
+    {"scalar", scan_run_space_scalar, scan_run_digit_scalar},
+#ifdef SCAN_X86
+    {"sse2", scan_run_space_sse2, scan_run_digit_sse2},
+    {"avx2", scan_run_space_avx2, scan_run_digit_avx2},
+#endif
+#ifdef SCAN_NEON
+    {"neon", scan_run_space_neon, scan_run_digit_neon},
+#endif
+};
+
+#define SCAN_OPS_LEN ((int) (sizeof(scan_ops_table) / sizeof(scan_ops_table[0])))
+
+static bool scan_ops_supported(const struct scan_ops_st *op) {
+#ifdef SCAN_X86
+    if (strcmp(op->name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    return true;
+}
+
+/* Look up a scanner implementation by name. NULL or "auto" selects the
+ * fastest one this CPU supports. Returns NULL if name is unknown or not
+ * supported here.
+ */
+const struct scan_ops_st * scan_ops_select(char *name) {
+    int i;
+
+    if (name == NULL || strcmp(name, "auto") == 0) {
+        for (i = SCAN_OPS_LEN - 1; i > 0; i--) {
+            if (scan_ops_supported(&scan_ops_table[i])) {
+                break;
+            }
+        }
+        return &scan_ops_table[i];
+    }
+
+    for (i = 0; i < SCAN_OPS_LEN; i++) {
+        if (strcmp(scan_ops_table[i].name, name) == 0) {
+            return scan_ops_supported(&scan_ops_table[i]) ? &scan_ops_table[i] : NULL;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,147 @@
+/* stats.c - phase counters and timers for --stats */
+
+#include "ntlang.h"
+#include <time.h>
+
+/* The driver times each phase of every input it evaluates and adds the
+ * counts here. Nothing is measured unless --stats is given, so the hot
+ * path only pays for a flag test.
+ */
+
+void stats_init(struct stats_st *sp) {
+    memset(sp, 0, sizeof(*sp));
+}
+
+void stats_free(struct stats_st *sp) {
+    free(sp->work);
+    stats_init(sp);
+}
+
+/* Nanoseconds from CLOCK_MONOTONIC */
+int64_t stats_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Count a scan of st that took ns */
+void stats_scan(struct stats_st *sp, struct scan_table_st *st, int64_t ns) {
+    sp->inputs += 1;
+    sp->tokens += st->len;
+    sp->scan_ns += ns;
+    if (st->len > sp->scan_peak) {
+        sp->scan_peak = st->len;
+    }
+}
+
+/* Count a parse into pt that took ns */
+void stats_parse(struct stats_st *sp, struct parse_table_st *pt, int64_t ns) {
+    sp->nodes += pt->len;
+    sp->parse_ns += ns;
+    if (pt->len > sp->parse_peak) {
+        sp->parse_peak = pt->len;
+    }
+}
+
+static void stats_push(struct stats_st *sp, int *top, struct parse_node_st *np,
+                       int depth) {
+    if (*top == sp->work_cap) {
+        sp->work_cap = (sp->work_cap == 0) ? ARENA_CHUNK_LEN : sp->work_cap * 2;
+        sp->work = realloc(sp->work, sp->work_cap * sizeof(struct stats_work_st));
+        if (sp->work == NULL) {
+            printf("stats error: out of memory\n");
+            exit(-1);
+        }
+    }
+    sp->work[*top].np = np;
+    sp->work[*top].depth = depth;
+    *top += 1;
+}
+
+/* The height of the tree at np, which is how deep eval() recurses. The
+ * walk uses an explicit stack, like fold_tree(), so --stats works on
+ * the trees --flat and --vm evaluate without recursion.
+ */
+static int stats_depth(struct stats_st *sp, struct parse_node_st *np) {
+    struct stats_work_st w;
+    int top = 0, max = 0;
+
+    stats_push(sp, &top, np, 1);
+    while (top > 0) {
+        w = sp->work[--top];
+        if (w.depth > max) {
+            max = w.depth;
+        }
+        if (w.np->type == EX_OPER1) {
+            stats_push(sp, &top, w.np->oper1.operand, w.depth + 1);
+        } else if (w.np->type == EX_OPER2) {
+            stats_push(sp, &top, w.np->oper2.left, w.depth + 1);
+            stats_push(sp, &top, w.np->oper2.right, w.depth + 1);
+        }
+    }
+    return max;
+}
+
+/* Count an evaluation of the tree at np that took ns. The depth is
+ * found after the timer stops, so it does not count as eval time.
+ */
+void stats_eval(struct stats_st *sp, struct parse_node_st *np, int64_t ns) {
+    int depth = stats_depth(sp, np);
+
+    sp->eval_ns += ns;
+    if (depth > sp->eval_depth) {
+        sp->eval_depth = depth;
+    }
+}
+
+/* Add the counts in src to total, as for the workers of a -j batch */
+void stats_add(struct stats_st *total, struct stats_st *src) {
+    total->inputs += src->inputs;
+    total->tokens += src->tokens;
+    total->nodes += src->nodes;
+    total->scan_ns += src->scan_ns;
+    total->parse_ns += src->parse_ns;
+    total->eval_ns += src->eval_ns;
+    if (src->scan_peak > total->scan_peak) {
+        total->scan_peak = src->scan_peak;
+    }
+    if (src->parse_peak > total->parse_peak) {
+        total->parse_peak = src->parse_peak;
+    }
+    if (src->eval_depth > total->eval_depth) {
+        total->eval_depth = src->eval_depth;
+    }
+}
+
+static double stats_rate(long n, int64_t ns) {
+    return (ns == 0) ? 0.0 : n * 1e9 / ns;
+}
+
+/* Print the counts to fp, as key=value lines or with json as one JSON
+ * object. The Rust port prints the same fields in the same format.
+ */
+void stats_print(struct stats_st *sp, bool json, FILE *fp) {
+    double tokens_rate = stats_rate(sp->tokens, sp->scan_ns);
+    double nodes_rate = stats_rate(sp->nodes, sp->parse_ns);
+
+    if (json) {
+        fprintf(fp, "{\"inputs\": %ld, "
+                "\"scan\": {\"time_ns\": %" PRId64 ", \"tokens\": %ld, "
+                "\"peak_len\": %d, \"tokens_per_sec\": %.0f}, "
+                "\"parse\": {\"time_ns\": %" PRId64 ", \"nodes\": %ld, "
+                "\"peak_len\": %d, \"nodes_per_sec\": %.0f}, "
+                "\"eval\": {\"time_ns\": %" PRId64 ", \"max_depth\": %d}}\n",
+                sp->inputs, sp->scan_ns, sp->tokens, sp->scan_peak, tokens_rate,
+                sp->parse_ns, sp->nodes, sp->parse_peak, nodes_rate,
+                sp->eval_ns, sp->eval_depth);
+        return;
+    }
+    fprintf(fp, "stats: inputs=%ld\n", sp->inputs);
+    fprintf(fp, "stats: scan time_ns=%" PRId64 " tokens=%ld peak_len=%d tokens_per_sec=%.0f\n",
+            sp->scan_ns, sp->tokens, sp->scan_peak, tokens_rate);
+    fprintf(fp, "stats: parse time_ns=%" PRId64 " nodes=%ld peak_len=%d nodes_per_sec=%.0f\n",
+            sp->parse_ns, sp->nodes, sp->parse_peak, nodes_rate);
+    fprintf(fp, "stats: eval time_ns=%" PRId64 " max_depth=%d\n",
+            sp->eval_ns, sp->eval_depth);
+}
@@ -0,0 +1,246 @@
+/* vm.c - bytecode compiler and threaded-dispatch virtual machine */
+
+#include "ntlang.h"
+
+/* The VM is a stack machine that keeps the top of the stack in a local
+ * variable (acc), so most instructions touch no memory besides the
+ * instruction itself. Programs are compiled from the postfix order of
+ * a flat table (see flat.c):
+ *
+ *   INTVAL n             VM_PUSH n     push acc, acc = n
+ *   INTVAL n, PLUS       VM_ADDI n     acc = acc + n
+ *   INTVAL n, MINUS      VM_SUBI n     acc = acc - n
+ *   NEG                  VM_NEG        acc = -acc
+ *   PLUS                 VM_ADD        acc = pop + acc
+ *   MINUS                VM_SUB        acc = pop - acc
+ *                        VM_HALT       return acc
+ *
+ * Because the right operand of most operators is a literal, the fused
+ * VM_ADDI/VM_SUBI forms mean "1 + 2 + 3 + ..." runs one instruction per
+ * operator and never touches the stack.
+ *
+ * With --overflow the compiler emits VM_CADDI, VM_CSUBI, VM_CNEG, VM_CADD
+ * and VM_CSUB instead, which do the same on signed values and stop the
+ * program with an error on overflow (see eval_checked()). Checking is
+ * chosen once per program, so the unchecked handlers stay as they are.
+ */
+
+static char *vm_op_strings[] = {"PUSH", "ADDI", "SUBI", "NEG", "ADD", "SUB", "HALT",
+                                "CADDI", "CSUBI", "CNEG", "CADD", "CSUB"};
+
+void vm_prog_init(struct vm_prog_st *vp) {
+    vp->code = NULL;
+    vp->len = 0;
+    vp->cap = 0;
+    vp->stack = NULL;
+    vp->stack_cap = 0;
+    flat_table_init(&vp->flat);
+}
+
+void vm_prog_free(struct vm_prog_st *vp) {
+    free(vp->code);
+    free(vp->stack);
+    flat_table_free(&vp->flat);
+    vm_prog_init(vp);
+}
+
+static void vm_emit(struct vm_prog_st *vp, uint32_t op, value_t arg) {
+    if (vp->len == vp->cap) {
+        vp->cap = (vp->cap == 0) ? ARENA_CHUNK_LEN : vp->cap * 2;
+        vp->code = realloc(vp->code, vp->cap * sizeof(struct vm_insn_st));
+        if (vp->code == NULL) {
+            printf("vm error: out of memory\n");
+            exit(-1);
+        }
+    }
+    vp->code[vp->len].op = op;
+    vp->code[vp->len].arg = arg;
+    vp->len += 1;
+}
+
+/* Compile the tree rooted at np into vp, replacing its contents, with
+ * overflow-checked arithmetic if checked. Returns false (see
+ * vp->flat.err) if the tree could not be compiled.
+ */
+bool vm_compile(struct vm_prog_st *vp, struct parse_node_st *np, bool checked) {
+    struct flat_table_st *ft = &vp->flat;
+    struct flat_node_st *fp, *next;
+    /* How far each arithmetic op is from its checked form */
+    uint32_t c = checked ? VM_CADDI - VM_ADDI : 0;
+    int i;
+
+    vp->len = 0;
+    if (!flat_table_build(ft, np)) {
+        return false;
+    }
+
+    for (i = 0; i < ft->len; i++) {
+        fp = &ft->nodes[i];
+        next = (i + 1 < ft->len) ? &ft->nodes[i + 1] : NULL;
+
+        if (fp->op == FLAT_INTVAL && next != NULL && next->op == FLAT_PLUS) {
+            vm_emit(vp, VM_ADDI + c, fp->arg);
+            i += 1;
+        } else if (fp->op == FLAT_INTVAL && next != NULL && next->op == FLAT_MINUS) {
+            vm_emit(vp, VM_SUBI + c, fp->arg);
+            i += 1;
+        } else if (fp->op == FLAT_INTVAL) {
+            vm_emit(vp, VM_PUSH, fp->arg);
+        } else if (fp->op == FLAT_NEG) {
+            vm_emit(vp, VM_NEG + c, 0);
+        } else if (fp->op == FLAT_PLUS) {
+            vm_emit(vp, VM_ADD + c, 0);
+        } else if (fp->op == FLAT_MINUS) {
+            vm_emit(vp, VM_SUB + c, 0);
+        }
+    }
+    vm_emit(vp, VM_HALT, 0);
+
+    /* The VM stack holds everything below acc; the first VM_PUSH also
+       pushes the initial (unused) acc. */
+    if (ft->depth + 1 > vp->stack_cap) {
+        vp->stack_cap = ft->depth + 1;
+        vp->stack = realloc(vp->stack, vp->stack_cap * sizeof(value_t));
+        if (vp->stack == NULL) {
+            printf("vm error: out of memory\n");
+            exit(-1);
+        }
+    }
+
+    return true;
+}
+
+#if defined(__GNUC__)
+
+/* Threaded dispatch: every handler ends with its own indirect jump to the
+ * next handler, instead of all of them sharing one switch at the top of
+ * a loop. Each jump site gets its own branch history, which makes the
+ * jumps much easier for the CPU to predict.
+ *
+ * An overflow in a checked op is recorded in ep, as eval_checked() does.
+ */
+value_t vm_run(struct vm_prog_st *vp, struct error_st *ep) {
+    static void *labels[] = {
+        [VM_PUSH]  = &&op_push,
+        [VM_ADDI]  = &&op_addi,
+        [VM_SUBI]  = &&op_subi,
+        [VM_NEG]   = &&op_neg,
+        [VM_ADD]   = &&op_add,
+        [VM_SUB]   = &&op_sub,
+        [VM_HALT]  = &&op_halt,
+        [VM_CADDI] = &&op_caddi,
+        [VM_CSUBI] = &&op_csubi,
+        [VM_CNEG]  = &&op_cneg,
+        [VM_CADD]  = &&op_cadd,
+        [VM_CSUB]  = &&op_csub,
+    };
+    struct vm_insn_st *ip = vp->code;
+    value_t *sp = vp->stack;
+    value_t acc = 0;
+    svalue_t r;
+
+    #define VM_NEXT() goto *labels[(++ip)->op]
+
+    goto *labels[ip->op];
+
+op_push:
+    *sp++ = acc;
+    acc = ip->arg;
+    VM_NEXT();
+op_addi:
+    acc = acc + ip->arg;
+    VM_NEXT();
+op_subi:
+    acc = acc - ip->arg;
+    VM_NEXT();
+op_neg:
+    acc = -acc;
+    VM_NEXT();
+op_add:
+    acc = *--sp + acc;
+    VM_NEXT();
+op_sub:
+    acc = *--sp - acc;
+    VM_NEXT();
+op_halt:
+    return acc;
+op_caddi:
+    if (__builtin_add_overflow((svalue_t) acc, (svalue_t) ip->arg, &r)) goto overflow;
+    acc = r;
+    VM_NEXT();
+op_csubi:
+    if (__builtin_sub_overflow((svalue_t) acc, (svalue_t) ip->arg, &r)) goto overflow;
+    acc = r;
+    VM_NEXT();
+op_cneg:
+    if (__builtin_sub_overflow((svalue_t) 0, (svalue_t) acc, &r)) goto overflow;
+    acc = r;
+    VM_NEXT();
+op_cadd:
+    if (__builtin_add_overflow((svalue_t) *--sp, (svalue_t) acc, &r)) goto overflow;
+    acc = r;
+    VM_NEXT();
+op_csub:
+    if (__builtin_sub_overflow((svalue_t) *--sp, (svalue_t) acc, &r)) goto overflow;
+    acc = r;
+    VM_NEXT();
+overflow:
+    eval_error(ep, "Integer overflow");
+    return acc;
+
+    #undef VM_NEXT
+}
+
+#else
+
+/* Portable switch dispatch for compilers without computed goto. The
+   checked ops use the same builtins, which clang has as well. */
+value_t vm_run(struct vm_prog_st *vp, struct error_st *ep) {
+    struct vm_insn_st *ip = vp->code;
+    value_t *sp = vp->stack;
+    value_t acc = 0;
+    svalue_t r;
+    bool overflow = false;
+
+    for (;; ip++) {
+        switch (ip->op) {
+        case VM_PUSH: *sp++ = acc; acc = ip->arg; break;
+        case VM_ADDI: acc = acc + ip->arg; break;
+        case VM_SUBI: acc = acc - ip->arg; break;
+        case VM_NEG:  acc = -acc; break;
+        case VM_ADD:  acc = *--sp + acc; break;
+        case VM_SUB:  acc = *--sp - acc; break;
+        case VM_HALT: return acc;
+        case VM_CADDI: overflow = __builtin_add_overflow((svalue_t) acc, (svalue_t) ip->arg, &r); break;
+        case VM_CSUBI: overflow = __builtin_sub_overflow((svalue_t) acc, (svalue_t) ip->arg, &r); break;
+        case VM_CNEG:  overflow = __builtin_sub_overflow((svalue_t) 0, (svalue_t) acc, &r); break;
+        case VM_CADD:  overflow = __builtin_add_overflow((svalue_t) *--sp, (svalue_t) acc, &r); break;
+        case VM_CSUB:  overflow = __builtin_sub_overflow((svalue_t) *--sp, (svalue_t) acc, &r); break;
+        }
+        if (ip->op >= VM_CADDI) {
+            if (overflow) {
+                eval_error(ep, "Integer overflow");
+                return acc;
+            }
+            acc = r;
+        }
+    }
+}
+
+#endif
+
+void vm_prog_print(struct vm_prog_st *vp) {
+    struct vm_insn_st *ip;
+    int i;
+
+    for (i = 0; i < vp->len; i++) {
+        ip = &vp->code[i];
+        if (ip->op == VM_PUSH || ip->op == VM_ADDI || ip->op == VM_SUBI
+            || ip->op == VM_CADDI || ip->op == VM_CSUBI) {
+            printf("%4d  %-5s %" PRIdVALUE "\n", i, vm_op_strings[ip->op],
+                   (svalue_t) ip->arg);
+        } else {
+            printf("%4d  %s\n", i, vm_op_strings[ip->op]);
+        }
+    }
+}
@@ -0,0 +1,101 @@
+// scan_parse.rs - compare ScanTable and Box trees with the borrowed
+// Tokens iterator and ParseArena
+//
+// Run with cargo bench. The C numbers for the same inputs come from the
+// scan and parse table of make -C ../c bench.
+
+use std::hint::black_box;
+use std::time::Instant;
+
+use project01::eval::{eval, eval_arena};
+use project01::parse::{parse_program, parse_program_arena, ParseArena};
+use project01::scan::{ScanTable, Tokens};
+
+/// Each measurement scans about this many operators in total
+const BENCH_WORK: usize = 2 * 1000 * 1000;
+
+/// A small LCG, so every run sees the same inputs
+struct BenchRand(u64);
+
+impl BenchRand {
+    fn next(&mut self) -> u32 {
+        self.0 = self.0.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+        (self.0 >> 33) as u32
+    }
+}
+
+/// Generate an expression with nopers binary operators, like
+/// bench_expr() in ../c/bench.c
+fn bench_expr(rng: &mut BenchRand, nopers: usize) -> String {
+    let mut s = String::with_capacity((nopers + 1) * 8);
+
+    for i in 0..=nopers {
+        if i > 0 {
+            s.push_str(if rng.next() % 2 == 1 { " + " } else { " - " });
+        }
+        if rng.next().is_multiple_of(8) {
+            s.push('-');
+        }
+        s.push_str(&(rng.next() % 1000).to_string());
+    }
+    s
+}
+
+/// Time reps calls of f, in ns per operator
+fn bench_time<F: FnMut()>(reps: usize, nopers: usize, mut f: F) -> f64 {
+    let t0 = Instant::now();
+    for _ in 0..reps {
+        f();
+    }
+    t0.elapsed().as_secs_f64() * 1e9 / reps as f64 / nopers as f64
+}
+
+fn bench_one(rng: &mut BenchRand, nopers: usize) {
+    let input = bench_expr(rng, nopers);
+    let reps = BENCH_WORK / nopers;
+    let mut scan_table = ScanTable::new();
+    let mut arena = ParseArena::new();
+
+    // Both parsers must build the same tree
+    scan_table.scan(&input);
+    let tree = parse_program(&mut scan_table);
+    let root = parse_program_arena(&mut arena, &input);
+    if eval(&tree) != eval_arena(&arena, root) {
+        eprintln!("bench: results differ for {} operators", nopers);
+        std::process::exit(-1);
+    }
+
+    let t_scan = bench_time(reps, nopers, || {
+        scan_table.scan(black_box(&input));
+    });
+    let t_tokens = bench_time(reps, nopers, || {
+        black_box(Tokens::new(black_box(&input)).count());
+    });
+    let t_parse = bench_time(reps, nopers, || {
+        scan_table.scan(black_box(&input));
+        black_box(parse_program(&mut scan_table));
+    });
+    let t_arena = bench_time(reps, nopers, || {
+        arena.clear();
+        black_box(parse_program_arena(&mut arena, black_box(&input)));
+    });
+
+    println!(
+        "{:9} {:9} {:10.2} {:10.2} {:10.2} {:10.2} {:8.2}x",
+        nopers, reps, t_scan, t_tokens, t_parse, t_arena, t_parse / t_arena
+    );
+}
+
+fn main() {
+    let mut rng = BenchRand(1);
+
+    println!("ns per operator to scan, and to scan and parse\n");
+    println!(
+        "{:>9} {:>9} {:>10} {:>10} {:>10} {:>10} {:>9}",
+        "operators", "reps", "scan", "tokens", "parse", "arena", "speedup"
+    );
+
+    for nopers in [10, 1000, 100000] {
+        bench_one(&mut rng, nopers);
+    }
+}
@@ -2,7 +2,7 @@
 
 use std::process;
 
-use crate::parse::{ParseNode, Operator};
+use crate::parse::{ArenaNode, NodeId, Operator, ParseArena, ParseNode};
 
 fn eval_error(msg: &str) -> ! {
     eprintln!("eval_error: {}", msg);
@@ -31,6 +31,29 @@ pub fn eval(node: &ParseNode) -> u32 {
     }
 }
 
+/// Evaluate the arena tree rooted at id, the same way as eval()
+pub fn eval_arena(arena: &ParseArena, id: NodeId) -> u32 {
+    match arena.get(id) {
+        ArenaNode::IntVal { value } => *value,
+        ArenaNode::Oper1 { oper, operand } => {
+            let v1 = eval_arena(arena, *operand);
+            match oper {
+                Operator::Minus => v1.wrapping_neg(),
+                _ => eval_error("Bad operator"),
+            }
+        }
+        ArenaNode::Oper2 { oper, left, right } => {
+            let v1 = eval_arena(arena, *left);
+            let v2 = eval_arena(arena, *right);
+            match oper {
+                Operator::Plus => v1.wrapping_add(v2),
+                Operator::Minus => v1.wrapping_sub(v2),
+                _ => eval_error("Bad operator"),
+            }
+        }
+    }
+}
+
 pub fn eval_print(value: u32) {
     println!("{}", value as i32);
 }
@@ -0,0 +1,6 @@
+// lib.rs - the project01 modules, shared by main.rs and benches/
+
+pub mod scan;
+pub mod parse;
+pub mod eval;
+pub mod stats;
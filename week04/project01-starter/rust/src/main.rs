@@ -1,39 +1,69 @@
 // project01.rs - initial parsing implementation
 
-mod scan;
-mod parse;
-mod eval;
-
 use std::env;
 use std::process;
+use std::time::Instant;
+
+use project01::scan::ScanTable;
+use project01::parse::{parse_program, parse_tree_print};
+use project01::eval::{eval, eval_print};
+use project01::stats::{stats_elapsed, Stats};
 
-use scan::ScanTable;
-use parse::{parse_program, parse_tree_print};
-use eval::{eval, eval_print};
+fn usage() -> ! {
+    println!("Usage: project01 [--stats | --stats-json] <expression>");
+    println!("  --stats       print phase times and counters to stderr");
+    println!("  --stats-json  the same as one JSON object");
+    println!("  Example: project01 \"1 + 2\"");
+    process::exit(-1);
+}
 
 fn main() {
     let args: Vec<String> = env::args().collect();
+    let mut stats_mode = None;
+    let mut input = None;
 
-    if args.len() != 2 {
-        println!("Usage: project01 <expression>");
-        println!("  Example: project01 \"1 + 2\"");
-        process::exit(-1);
+    for arg in &args[1..] {
+        match arg.as_str() {
+            "--stats" => stats_mode = Some(false),
+            "--stats-json" => stats_mode = Some(true),
+            // Anything else is the expression, which may start with '-'
+            _ if input.is_none() => input = Some(arg),
+            _ => usage(),
+        }
     }
-
-    let input = &args[1];
+    let input = input.unwrap_or_else(|| usage());
+    let mut stats = Stats::new();
+    // Nothing is timed or counted unless --stats is given
+    let timer = || stats_mode.map(|_| Instant::now());
 
     // Scan input into token table
     let mut scan_table = ScanTable::new();
+    let t0 = timer();
     scan_table.scan(input);
+    if let Some(t0) = t0 {
+        stats.scan(&scan_table, stats_elapsed(t0));
+    }
     scan_table.print();
     println!();
 
     // Parse
+    let t0 = timer();
     let parse_tree = parse_program(&mut scan_table);
+    if let Some(t0) = t0 {
+        stats.parse(&parse_tree, stats_elapsed(t0));
+    }
     parse_tree_print(&parse_tree);
     println!();
 
     // Eval
+    let t0 = timer();
     let value = eval(&parse_tree);
+    if let Some(t0) = t0 {
+        stats.eval(&parse_tree, stats_elapsed(t0));
+    }
     eval_print(value);
+
+    if let Some(json) = stats_mode {
+        stats.print(json);
+    }
 }
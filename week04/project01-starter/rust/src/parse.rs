@@ -9,7 +9,7 @@
 
 use std::process;
 
-use crate::scan::{ScanTable, TokenType};
+use crate::scan::{ScanTable, Tok, TokenType, Tokens};
 
 // ============================================================================
 // Parse Tree
@@ -161,3 +161,163 @@ fn parse_operand(scan_table: &mut ScanTable) -> ParseNode {
         parse_error("Bad operand");
     }
 }
+
+// ============================================================================
+// Arena Parse Tree
+// ============================================================================
+
+/// Index of a node in a ParseArena
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct NodeId(u32);
+
+/// Parse tree node types, with children as indexes instead of boxes
+pub enum ArenaNode {
+    IntVal { value: u32 },
+    Oper1 { oper: Operator, operand: NodeId },
+    Oper2 { oper: Operator, left: NodeId, right: NodeId },
+}
+
+/// All the nodes of a parse tree in one Vec. Reusing an arena with
+/// clear() means parsing allocates nothing once it has grown to fit.
+#[derive(Default)]
+pub struct ParseArena {
+    nodes: Vec<ArenaNode>,
+}
+
+impl ParseArena {
+    /// Create a new empty arena
+    pub fn new() -> Self {
+        ParseArena::default()
+    }
+
+    /// Drop all nodes but keep the memory for the next parse
+    pub fn clear(&mut self) {
+        self.nodes.clear();
+    }
+
+    /// Number of nodes in the arena
+    pub fn len(&self) -> usize {
+        self.nodes.len()
+    }
+
+    /// True if the arena holds no nodes
+    pub fn is_empty(&self) -> bool {
+        self.nodes.is_empty()
+    }
+
+    /// Add a node and return its index
+    pub fn push(&mut self, node: ArenaNode) -> NodeId {
+        self.nodes.push(node);
+        NodeId((self.nodes.len() - 1) as u32)
+    }
+
+    /// The node at index id
+    pub fn get(&self, id: NodeId) -> &ArenaNode {
+        &self.nodes[id.0 as usize]
+    }
+}
+
+/// Print an arena node recursively, as parse_tree_print_expr() does
+fn parse_arena_print_expr(arena: &ParseArena, id: NodeId, level: usize) {
+    parse_tree_print_indent(level);
+    print!("EXPR ");
+
+    match arena.get(id) {
+        ArenaNode::IntVal { value } => {
+            println!("INTVAL {}", value);
+        }
+        ArenaNode::Oper1 { oper, operand } => {
+            println!("OPER1 {}", oper.name());
+            parse_arena_print_expr(arena, *operand, level + 1);
+        }
+        ArenaNode::Oper2 { oper, left, right } => {
+            println!("OPER2 {}", oper.name());
+            parse_arena_print_expr(arena, *left, level + 1);
+            parse_arena_print_expr(arena, *right, level + 1);
+        }
+    }
+}
+
+/// Print the tree rooted at id
+pub fn parse_arena_print(arena: &ParseArena, id: NodeId) {
+    parse_arena_print_expr(arena, id, 0);
+}
+
+// ============================================================================
+// Arena Parser
+// ============================================================================
+
+/// Parser state: the token iterator, one token of lookahead and the
+/// arena the nodes go into
+struct ArenaParser<'a, 't> {
+    tokens: Tokens<'a>,
+    cur: Tok<'a>,
+    arena: &'t mut ParseArena,
+}
+
+impl<'a, 't> ArenaParser<'a, 't> {
+    /// Move to the next token
+    fn advance(&mut self) {
+        self.cur = self.tokens.next().unwrap_or(Tok::Eot);
+    }
+
+    /// Accept the current token if it matches the expected type
+    fn accept(&mut self, expected: TokenType) -> bool {
+        if self.cur.token_type() == expected {
+            self.advance();
+            return true;
+        }
+        false
+    }
+
+    /// Parse an expression: operand (operator operand)*
+    fn parse_expression(&mut self) -> NodeId {
+        let mut left = self.parse_operand();
+
+        loop {
+            let oper = match self.cur {
+                Tok::Plus => Operator::Plus,
+                Tok::Minus => Operator::Minus,
+                _ => break,
+            };
+            self.advance();
+            let right = self.parse_operand();
+            left = self.arena.push(ArenaNode::Oper2 { oper, left, right });
+        }
+
+        left
+    }
+
+    /// Parse an operand: intlit | '-' operand
+    fn parse_operand(&mut self) -> NodeId {
+        if let Tok::IntLit(s) = self.cur {
+            self.advance();
+            let value: u32 = s.parse().unwrap_or_else(|_| {
+                parse_error("Invalid integer literal");
+            });
+            self.arena.push(ArenaNode::IntVal { value })
+        } else if self.accept(TokenType::Minus) {
+            let operand = self.parse_operand();
+            self.arena.push(ArenaNode::Oper1 { oper: Operator::Minus, operand })
+        } else {
+            parse_error("Bad operand");
+        }
+    }
+}
+
+/// Scan and parse a complete program straight from the input, pulling
+/// tokens from a Tokens iterator. The nodes are added to arena, and the
+/// root is returned.
+pub fn parse_program_arena(arena: &mut ParseArena, input: &str) -> NodeId {
+    let mut tokens = Tokens::new(input);
+    let cur = tokens.next().unwrap_or(Tok::Eot);
+    let mut parser = ArenaParser { tokens, cur, arena };
+
+    let expr = parser.parse_expression();
+
+    if !parser.accept(TokenType::Eot) {
+        parse_error("Expecting EOT");
+    }
+
+    expr
+}
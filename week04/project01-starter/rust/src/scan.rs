@@ -176,6 +176,7 @@ impl Scanner {
 // ============================================================================
 
 /// Table of scanned tokens with current position tracking for parsing
+#[derive(Default)]
 pub struct ScanTable {
     tokens: Vec<Token>,
     cur: usize, // Current position for parsing
@@ -184,10 +185,7 @@ pub struct ScanTable {
 impl ScanTable {
     /// Create a new empty scan table
     pub fn new() -> Self {
-        ScanTable {
-            tokens: Vec::new(),
-            cur: 0,
-        }
+        ScanTable::default()
     }
 
     /// Scan all tokens from the input string
@@ -197,6 +195,16 @@ impl ScanTable {
         self.cur = 0;
     }
 
+    /// Number of tokens in the table, including the Eot
+    pub fn len(&self) -> usize {
+        self.tokens.len()
+    }
+
+    /// True before anything has been scanned
+    pub fn is_empty(&self) -> bool {
+        self.tokens.is_empty()
+    }
+
     /// Print all tokens in the table
     pub fn print(&self) {
         for token in &self.tokens {
@@ -235,3 +243,96 @@ impl ScanTable {
         true
     }
 }
+
+// ============================================================================
+// Borrowed tokens
+// ============================================================================
+
+/// A token whose text is a slice of the input, so scanning copies nothing
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Tok<'a> {
+    IntLit(&'a str), // Integer literal: "1", "22", "403"
+    Plus,            // +
+    Minus,           // -
+    Eot,             // End of text
+}
+
+impl<'a> Tok<'a> {
+    /// Returns the string value of the token
+    pub fn value(&self) -> &'a str {
+        match self {
+            Tok::IntLit(s) => s,
+            Tok::Plus => "+",
+            Tok::Minus => "-",
+            Tok::Eot => "",
+        }
+    }
+
+    /// Returns the token type for matching
+    pub fn token_type(&self) -> TokenType {
+        match self {
+            Tok::IntLit(_) => TokenType::IntLit,
+            Tok::Plus => TokenType::Plus,
+            Tok::Minus => TokenType::Minus,
+            Tok::Eot => TokenType::Eot,
+        }
+    }
+}
+
+/// Scans the input one token per call to next(), ending with a single
+/// Eot. Unlike ScanTable nothing is collected, the parser pulls tokens
+/// as it needs them.
+pub struct Tokens<'a> {
+    input: &'a str,
+    pos: usize,
+    done: bool,
+}
+
+impl<'a> Tokens<'a> {
+    /// Create a token iterator over the given input
+    pub fn new(input: &'a str) -> Self {
+        Tokens { input, pos: 0, done: false }
+    }
+}
+
+impl<'a> Iterator for Tokens<'a> {
+    type Item = Tok<'a>;
+
+    fn next(&mut self) -> Option<Tok<'a>> {
+        let bytes = self.input.as_bytes();
+
+        if self.done {
+            return None;
+        }
+
+        // Skip whitespace
+        while self.pos < bytes.len() && (bytes[self.pos] == b' ' || bytes[self.pos] == b'\t') {
+            self.pos += 1;
+        }
+
+        if self.pos >= bytes.len() {
+            self.done = true;
+            return Some(Tok::Eot);
+        }
+
+        let start = self.pos;
+        let ch = bytes[start];
+        self.pos += 1;
+
+        match ch {
+            b'0'..=b'9' => {
+                while self.pos < bytes.len() && bytes[self.pos].is_ascii_digit() {
+                    self.pos += 1;
+                }
+                Some(Tok::IntLit(&self.input[start..self.pos]))
+            }
+            b'+' => Some(Tok::Plus),
+            b'-' => Some(Tok::Minus),
+            _ => {
+                let ch = self.input[start..].chars().next().unwrap_or('\0');
+                eprintln!("scan error: invalid char: {}", ch);
+                process::exit(-1);
+            }
+        }
+    }
+}
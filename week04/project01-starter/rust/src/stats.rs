@@ -0,0 +1,115 @@
+// stats.rs - phase counters and timers for --stats
+//
+// The same fields as stats.c in the C version, printed in the same
+// format, so the output of the two can be compared directly.
+
+use std::time::Instant;
+
+use crate::parse::ParseNode;
+use crate::scan::ScanTable;
+
+/// Counters for --stats. Times are the sum over all inputs, and the
+/// peaks are the largest seen for any one input.
+#[derive(Debug, Default, Clone)]
+pub struct Stats {
+    pub inputs: u64,
+    pub tokens: u64,
+    pub nodes: u64,
+    pub scan_peak: usize,  // largest ScanTable length
+    pub parse_peak: usize, // largest tree, in nodes
+    pub eval_depth: usize, // deepest tree evaluated
+    pub scan_ns: u64,
+    pub parse_ns: u64,
+    pub eval_ns: u64,
+}
+
+/// Nanoseconds since start
+pub fn stats_elapsed(start: Instant) -> u64 {
+    start.elapsed().as_nanos() as u64
+}
+
+/// The number of nodes in the tree and its height, which is how deep
+/// eval() recurses. The walk uses an explicit stack so that it works on
+/// trees of any depth.
+fn stats_tree(tree: &ParseNode) -> (usize, usize) {
+    let mut work = vec![(tree, 1)];
+    let (mut nodes, mut depth) = (0, 0);
+
+    while let Some((node, d)) = work.pop() {
+        nodes += 1;
+        depth = depth.max(d);
+        match node {
+            ParseNode::IntVal { .. } => {}
+            ParseNode::Oper1 { operand, .. } => work.push((operand, d + 1)),
+            ParseNode::Oper2 { left, right, .. } => {
+                work.push((left, d + 1));
+                work.push((right, d + 1));
+            }
+        }
+    }
+    (nodes, depth)
+}
+
+fn stats_rate(n: u64, ns: u64) -> f64 {
+    if ns == 0 { 0.0 } else { n as f64 * 1e9 / ns as f64 }
+}
+
+impl Stats {
+    pub fn new() -> Self {
+        Stats::default()
+    }
+
+    /// Count a scan that took ns
+    pub fn scan(&mut self, scan_table: &ScanTable, ns: u64) {
+        self.inputs += 1;
+        self.tokens += scan_table.len() as u64;
+        self.scan_ns += ns;
+        self.scan_peak = self.scan_peak.max(scan_table.len());
+    }
+
+    /// Count a parse that took ns. Trees are not in a table, so the
+    /// nodes are counted after the timer stops.
+    pub fn parse(&mut self, tree: &ParseNode, ns: u64) {
+        let (nodes, _) = stats_tree(tree);
+        self.nodes += nodes as u64;
+        self.parse_ns += ns;
+        self.parse_peak = self.parse_peak.max(nodes);
+    }
+
+    /// Count an evaluation of tree that took ns
+    pub fn eval(&mut self, tree: &ParseNode, ns: u64) {
+        self.eval_ns += ns;
+        self.eval_depth = self.eval_depth.max(stats_tree(tree).1);
+    }
+
+    /// Print the counts to stderr, as key=value lines or with json as
+    /// one JSON object
+    pub fn print(&self, json: bool) {
+        let tokens_rate = stats_rate(self.tokens, self.scan_ns);
+        let nodes_rate = stats_rate(self.nodes, self.parse_ns);
+
+        if json {
+            eprintln!(
+                "{{\"inputs\": {}, \
+                 \"scan\": {{\"time_ns\": {}, \"tokens\": {}, \"peak_len\": {}, \"tokens_per_sec\": {:.0}}}, \
+                 \"parse\": {{\"time_ns\": {}, \"nodes\": {}, \"peak_len\": {}, \"nodes_per_sec\": {:.0}}}, \
+                 \"eval\": {{\"time_ns\": {}, \"max_depth\": {}}}}}",
+                self.inputs,
+                self.scan_ns, self.tokens, self.scan_peak, tokens_rate,
+                self.parse_ns, self.nodes, self.parse_peak, nodes_rate,
+                self.eval_ns, self.eval_depth
+            );
+            return;
+        }
+        eprintln!("stats: inputs={}", self.inputs);
+        eprintln!(
+            "stats: scan time_ns={} tokens={} peak_len={} tokens_per_sec={:.0}",
+            self.scan_ns, self.tokens, self.scan_peak, tokens_rate
+        );
+        eprintln!(
+            "stats: parse time_ns={} nodes={} peak_len={} nodes_per_sec={:.0}",
+            self.parse_ns, self.nodes, self.parse_peak, nodes_rate
+        );
+        eprintln!("stats: eval time_ns={} max_depth={}", self.eval_ns, self.eval_depth);
+    }
+}
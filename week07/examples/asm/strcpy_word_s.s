@@ -0,0 +1,47 @@
+.global strcpy_word_s
+
+.text
+
+# a0 = dest, a1 = src
+# copy string from src to dest, return dest
+#
+# Same result as strcpy_s, but copies 8 bytes per loop iteration,
+# using the zero byte test from strlen_word_s to stop before the word
+# holding the terminator. Bytes are copied one at a time until src is
+# 8-byte aligned, so loads never cross into the next page. Stores to
+# dest may be misaligned, which Linux allows on RISC-V.
+strcpy_word_s:
+    mv t0, a0               # save dest
+strcpy_word_s_head:
+    andi t1, a1, 7
+    beqz t1, strcpy_word_s_aligned
+    lb t1, 0(a1)
+    sb t1, 0(a0)
+    beqz t1, strcpy_word_s_done
+    addi a0, a0, 1
+    addi a1, a1, 1
+    j strcpy_word_s_head
+strcpy_word_s_aligned:
+    li t2, 0x0101010101010101
+    slli t3, t2, 7          # t3 = 0x8080808080808080
+strcpy_word_s_loop:
+    ld t1, 0(a1)            # load 8 bytes from src
+    sub t4, t1, t2
+    not t5, t1
+    and t4, t4, t5
+    and t4, t4, t3
+    bnez t4, strcpy_word_s_tail # a zero byte is in this word
+    sd t1, 0(a0)            # store 8 bytes to dest
+    addi a0, a0, 8
+    addi a1, a1, 8
+    j strcpy_word_s_loop
+strcpy_word_s_tail:
+    lb t1, 0(a1)            # copy the rest, through the terminator
+    sb t1, 0(a0)
+    beqz t1, strcpy_word_s_done
+    addi a0, a0, 1
+    addi a1, a1, 1
+    j strcpy_word_s_tail
+strcpy_word_s_done:
+    mv a0, t0               # return original dest
+    ret
@@ -0,0 +1,43 @@
+.global strlen_word_s
+
+.text
+
+# a0 = pointer to string
+# return length of string
+#
+# Same result as strlen_s, but checks 8 bytes per loop iteration. A
+# 64-bit word x has a zero byte iff
+#
+#     (x - 0x0101010101010101) & ~x & 0x8080808080808080
+#
+# is non-zero. Bytes are checked one at a time until a0 is 8-byte
+# aligned, so the word loads never cross into the next page.
+strlen_word_s:
+    mv t0, a0               # save start
+strlen_word_s_head:
+    andi t1, a0, 7
+    beqz t1, strlen_word_s_aligned
+    lbu t1, 0(a0)
+    beqz t1, strlen_word_s_done
+    addi a0, a0, 1
+    j strlen_word_s_head
+strlen_word_s_aligned:
+    li t2, 0x0101010101010101
+    slli t3, t2, 7          # t3 = 0x8080808080808080
+strlen_word_s_loop:
+    ld t1, 0(a0)            # load 8 bytes
+    sub t4, t1, t2
+    not t5, t1
+    and t4, t4, t5
+    and t4, t4, t3
+    bnez t4, strlen_word_s_tail # a zero byte is in this word
+    addi a0, a0, 8
+    j strlen_word_s_loop
+strlen_word_s_tail:
+    lbu t1, 0(a0)           # find which byte it is
+    beqz t1, strlen_word_s_done
+    addi a0, a0, 1
+    j strlen_word_s_tail
+strlen_word_s_done:
+    sub a0, a0, t0          # return end - start
+    ret
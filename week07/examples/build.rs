@@ -3,6 +3,8 @@ fn main() {
         .file("asm/bits_s.s")
         .file("asm/strlen_s.s")
         .file("asm/strcpy_s.s")
+        .file("asm/strlen_word_s.s")
+        .file("asm/strcpy_word_s.s")
         .file("asm/get_bitseq_s.s")
         .file("asm/intdr_s.s")
         .compile("asm_functions");
@@ -10,6 +12,8 @@ fn main() {
     println!("cargo:rerun-if-changed=asm/bits_s.s");
     println!("cargo:rerun-if-changed=asm/strlen_s.s");
     println!("cargo:rerun-if-changed=asm/strcpy_s.s");
+    println!("cargo:rerun-if-changed=asm/strlen_word_s.s");
+    println!("cargo:rerun-if-changed=asm/strcpy_word_s.s");
     println!("cargo:rerun-if-changed=asm/get_bitseq_s.s");
     println!("cargo:rerun-if-changed=asm/intdr_s.s");
 }
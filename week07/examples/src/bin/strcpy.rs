@@ -1,9 +1,16 @@
 use std::ffi::{CStr, CString};
+use std::hint::black_box;
+
+use week07::timing::time_ns;
 
 extern "C" {
     fn strcpy_s(dest: *mut u8, src: *const u8) -> *mut u8;
+    fn strcpy_word_s(dest: *mut u8, src: *const u8) -> *mut u8;
 }
 
+// Length of the string the speed comparison runs on
+const BENCH_LEN: usize = 1 << 16;
+
 fn strcpy_c(dest: &mut [u8], src: &str) {
     let bytes = src.as_bytes();
     dest[..bytes.len()].copy_from_slice(bytes);
@@ -26,4 +33,37 @@ fn main() {
     unsafe { strcpy_s(buf.as_mut_ptr(), cs.as_ptr() as *const u8) };
     let result = CStr::from_bytes_until_nul(&buf).unwrap();
     println!("Asm: {}", result.to_str().unwrap());
+
+    // Asm version, 8 bytes at a time
+    let mut buf = vec![0u8; 256];
+    unsafe { strcpy_word_s(buf.as_mut_ptr(), cs.as_ptr() as *const u8) };
+    let result = CStr::from_bytes_until_nul(&buf).unwrap();
+    println!("Asm (word): {}", result.to_str().unwrap());
+
+    // Compare the two on a long string built from the input
+    let unit = if s.is_empty() { "x" } else { s };
+    let long = unit.repeat(BENCH_LEN / unit.len() + 1);
+    let cs = CString::new(long.as_str()).unwrap();
+    let p = cs.as_ptr() as *const u8;
+    let mut byte_buf = vec![0u8; long.len() + 1];
+    let mut word_buf = vec![0u8; long.len() + 1];
+
+    unsafe { strcpy_s(byte_buf.as_mut_ptr(), p) };
+    unsafe { strcpy_word_s(word_buf.as_mut_ptr(), p) };
+    if byte_buf != cs.as_bytes_with_nul() || word_buf != cs.as_bytes_with_nul() {
+        println!("MISMATCH copying {} bytes", long.len());
+        std::process::exit(-1);
+    }
+
+    let d = byte_buf.as_mut_ptr();
+    let byte_ns = time_ns(|| unsafe { strcpy_s(black_box(d), black_box(p)) });
+    let d = word_buf.as_mut_ptr();
+    let word_ns = time_ns(|| unsafe { strcpy_word_s(black_box(d), black_box(p)) });
+    println!(
+        "{} bytes: Asm {:.0} ns, Asm (word) {:.0} ns, {:.1}x",
+        long.len(),
+        byte_ns,
+        word_ns,
+        byte_ns / word_ns
+    );
 }
@@ -1,9 +1,16 @@
 use std::ffi::CString;
+use std::hint::black_box;
+
+use week07::timing::time_ns;
 
 extern "C" {
     fn strlen_s(s: *const u8) -> usize;
+    fn strlen_word_s(s: *const u8) -> usize;
 }
 
+// Length of the string the speed comparison runs on
+const BENCH_LEN: usize = 1 << 16;
+
 fn strlen_c(s: &str) -> usize {
     s.len()
 }
@@ -18,4 +25,30 @@ fn main() {
     let cs = CString::new(s).unwrap();
     let r = unsafe { strlen_s(cs.as_ptr() as *const u8) };
     println!("Asm: {}", r);
+
+    let r = unsafe { strlen_word_s(cs.as_ptr() as *const u8) };
+    println!("Asm (word): {}", r);
+
+    // Compare the two on a long string built from the input
+    let unit = if s.is_empty() { "x" } else { s };
+    let long = unit.repeat(BENCH_LEN / unit.len() + 1);
+    let cs = CString::new(long.as_str()).unwrap();
+    let p = cs.as_ptr() as *const u8;
+
+    let byte = unsafe { strlen_s(p) };
+    let word = unsafe { strlen_word_s(p) };
+    if byte != long.len() || word != long.len() {
+        println!("MISMATCH on {} bytes: Asm = {}, Asm (word) = {}", long.len(), byte, word);
+        std::process::exit(-1);
+    }
+
+    let byte_ns = time_ns(|| unsafe { strlen_s(black_box(p)) });
+    let word_ns = time_ns(|| unsafe { strlen_word_s(black_box(p)) });
+    println!(
+        "{} bytes: Asm {:.0} ns, Asm (word) {:.0} ns, {:.1}x",
+        long.len(),
+        byte_ns,
+        word_ns,
+        byte_ns / word_ns
+    );
 }
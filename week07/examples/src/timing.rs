@@ -0,0 +1,67 @@
+// Timing for the speed comparisons in the src/bin drivers and benches,
+// here, in project02 and in week09
+
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+// Each measurement repeats calls until it has run at least this long
+pub const BENCH_TIME: Duration = Duration::from_millis(100);
+
+// Return ns per call of f. After one call to warm up, the call count
+// doubles until one batch of calls takes BENCH_TIME.
+pub fn time_ns<T, F: FnMut() -> T>(mut f: F) -> f64 {
+    black_box(f());
+
+    let mut iters: u64 = 1;
+    loop {
+        let t = Instant::now();
+        for _ in 0..iters {
+            black_box(f());
+        }
+        let elapsed = t.elapsed();
+        if elapsed >= BENCH_TIME {
+            return elapsed.as_nanos() as f64 / iters as f64;
+        }
+        iters *= 2;
+    }
+}
+
+// Return ns per value of f, which handles n values per call
+pub fn time_ns_per<T, F: FnMut() -> T>(n: usize, f: F) -> f64 {
+    time_ns(f) / n as f64
+}
+
+// Scalar against slice
+//
+// The bits_bench programs time each helper once called per value and
+// once on a whole slice, and print a row per helper. The scalar
+// function is called through black_box so it stays one call per value
+// instead of being inlined into a vectorized loop.
+
+pub fn report_header(width: usize) {
+    println!("{:<width$} {:>10} {:>10} {:>9}", "helper", "scalar ns", "slice ns", "speedup");
+}
+
+pub fn report(width: usize, name: &str, scalar_ns: f64, slice_ns: f64) {
+    println!(
+        "{:<width$} {:>10.3} {:>10.3} {:>8.1}x",
+        name,
+        scalar_ns,
+        slice_ns,
+        scalar_ns / slice_ns
+    );
+}
+
+// n arbitrary values from a xorshift generator, the same every run
+pub fn xorshift_input(n: usize) -> Vec<u64> {
+    let mut x: u64 = 88172645463325252;
+
+    (0..n)
+        .map(|_| {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            x
+        })
+        .collect()
+}
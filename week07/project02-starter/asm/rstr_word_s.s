@@ -0,0 +1,80 @@
+.global rstr_word_s
+.global strlen
+
+# a0 - char *dst
+# a1 - char *src
+#
+# Same result as rstr_s, but iterative, and moves 8 bytes per loop
+# iteration: each word is loaded from the end of src, byte-swapped and
+# stored at the front of dst. Bytes are copied one at a time until the
+# end of src is 8-byte aligned, so the loads are aligned. Stores to dst
+# may be misaligned, which Linux allows on RISC-V.
+
+rstr_word_s:
+    addi sp, sp, -32
+    sd ra, 0(sp)
+    sd s0, 8(sp)
+    sd s1, 16(sp)
+    mv s0, a0               # s0 = dst
+    mv s1, a1               # s1 = src
+
+    mv a0, a1
+    call strlen             # a0 = strlen(src)
+
+    add t0, s1, a0          # t0 = one past the last byte of src
+    add t1, s0, a0
+    sb zero, 0(t1)          # dst[len] = '\0'
+
+rstr_word_s_head:
+    andi t2, t0, 7
+    beqz t2, rstr_word_s_aligned
+    beq t0, s1, rstr_word_s_done
+    addi t0, t0, -1
+    lb t2, 0(t0)
+    sb t2, 0(s0)
+    addi s0, s0, 1
+    j rstr_word_s_head
+
+rstr_word_s_aligned:
+    li t4, 0x00ff00ff00ff00ff   # byte swap masks
+    li t5, 0x0000ffff0000ffff
+
+rstr_word_s_loop:
+    sub t2, t0, s1
+    li t3, 8
+    blt t2, t3, rstr_word_s_tail # fewer than 8 bytes left
+    addi t0, t0, -8
+    ld t2, 0(t0)
+
+    srli t3, t2, 8          # swap adjacent bytes
+    and t3, t3, t4
+    and t2, t2, t4
+    slli t2, t2, 8
+    or t2, t2, t3
+    srli t3, t2, 16         # swap adjacent halfwords
+    and t3, t3, t5
+    and t2, t2, t5
+    slli t2, t2, 16
+    or t2, t2, t3
+    srli t3, t2, 32         # swap the two words
+    slli t2, t2, 32
+    or t2, t2, t3
+
+    sd t2, 0(s0)
+    addi s0, s0, 8
+    j rstr_word_s_loop
+
+rstr_word_s_tail:
+    beq t0, s1, rstr_word_s_done
+    addi t0, t0, -1
+    lb t2, 0(t0)
+    sb t2, 0(s0)
+    addi s0, s0, 1
+    j rstr_word_s_tail
+
+rstr_word_s_done:
+    ld ra, 0(sp)
+    ld s0, 8(sp)
+    ld s1, 16(sp)
+    addi sp, sp, 32
+    ret
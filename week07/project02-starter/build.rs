@@ -9,6 +9,7 @@ fn main() {
             .file("asm/unpack_bytes_s.s")
             .file("asm/rstr_s.s")
             .file("asm/rstr_rec_s.s")
+            .file("asm/rstr_word_s.s")
             .compile("asm_functions");
 
         // Explicitly pass link flags to binary targets, since the [lib] crate
@@ -22,4 +23,5 @@ fn main() {
     println!("cargo:rerun-if-changed=asm/unpack_bytes_s.s");
     println!("cargo:rerun-if-changed=asm/rstr_s.s");
     println!("cargo:rerun-if-changed=asm/rstr_rec_s.s");
+    println!("cargo:rerun-if-changed=asm/rstr_word_s.s");
 }
@@ -0,0 +1,97 @@
+// bits_bench - compare the scalar bit and byte helpers with their slice
+// versions in project02::bits
+//
+// usage: bits_bench [n]
+//
+// Runs each helper over n values (default 64K), checks that the two
+// versions agree, and prints ns per value and the speedup. The scalar
+// side makes one call per value, as the src/bin drivers do; the slice
+// side makes one call for all n, into a buffer it reuses.
+
+use std::hint::black_box;
+
+use project02::bits::*;
+use project02::timing::{report, report_header, time_ns_per, xorshift_input};
+
+// Width of the helper name column
+const WIDTH: usize = 18;
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let n: usize = args.get(1).and_then(|s| s.parse().ok()).unwrap_or(1 << 16);
+
+    let nums: Vec<u32> = xorshift_input(n).iter().map(|&x| (x >> 32) as u32).collect();
+    let bytes = unpack_bytes_slice(&nums);
+
+    let (start, end) = (5, 17);
+    let mut words = vec![0u32; n];
+    let mut signed = vec![0i32; n];
+    let mut out_bytes = vec![0u8; n * 4];
+
+    report_header(WIDTH);
+
+    let f = black_box(get_bitseq as fn(u32, i32, i32) -> u32);
+    let want: Vec<u32> = nums.iter().map(|&v| f(v, start, end)).collect();
+    assert!(get_bitseq_slice(&nums, start, end) == want, "get_bitseq_slice differs");
+    let scalar = time_ns_per(n, || {
+        for (o, &v) in words.iter_mut().zip(nums.iter()) {
+            *o = f(v, start, end);
+        }
+        black_box(&words);
+    });
+    let slice = time_ns_per(n, || {
+        get_bitseq_into(black_box(&nums), start, end, &mut words);
+        black_box(&words);
+    });
+    report(WIDTH, "get_bitseq", scalar, slice);
+
+    let f = black_box(get_bitseq_signed as fn(u32, i32, i32) -> i32);
+    let want: Vec<i32> = nums.iter().map(|&v| f(v, start, end)).collect();
+    assert!(get_bitseq_signed_slice(&nums, start, end) == want, "get_bitseq_signed_slice differs");
+    let scalar = time_ns_per(n, || {
+        for (o, &v) in signed.iter_mut().zip(nums.iter()) {
+            *o = f(v, start, end);
+        }
+        black_box(&signed);
+    });
+    let slice = time_ns_per(n, || {
+        get_bitseq_signed_into(black_box(&nums), start, end, &mut signed);
+        black_box(&signed);
+    });
+    report(WIDTH, "get_bitseq_signed", scalar, slice);
+
+    let f = black_box(pack_bytes as fn(u32, u32, u32, u32) -> i32);
+    let want: Vec<u32> = bytes
+        .chunks_exact(4)
+        .map(|b| f(b[0] as u32, b[1] as u32, b[2] as u32, b[3] as u32) as u32)
+        .collect();
+    assert!(pack_bytes_slice(&bytes) == want && want == nums, "pack_bytes_slice differs");
+    let scalar = time_ns_per(n, || {
+        for (o, b) in words.iter_mut().zip(bytes.chunks_exact(4)) {
+            *o = f(b[0] as u32, b[1] as u32, b[2] as u32, b[3] as u32) as u32;
+        }
+        black_box(&words);
+    });
+    let slice = time_ns_per(n, || {
+        pack_bytes_into(black_box(&bytes), &mut words);
+        black_box(&words);
+    });
+    report(WIDTH, "pack_bytes", scalar, slice);
+
+    let f = black_box(unpack_bytes as fn(i32, &mut [u32; 4]));
+    let scalar = time_ns_per(n, || {
+        for (o, &v) in out_bytes.chunks_exact_mut(4).zip(nums.iter()) {
+            let mut b = [0u32; 4];
+            f(v as i32, &mut b);
+            o.copy_from_slice(&[b[3] as u8, b[2] as u8, b[1] as u8, b[0] as u8]);
+        }
+        black_box(&out_bytes);
+    });
+    assert!(out_bytes == bytes, "unpack_bytes differs");
+    let slice = time_ns_per(n, || {
+        unpack_bytes_into(black_box(&nums), &mut out_bytes);
+        black_box(&out_bytes);
+    });
+    assert!(out_bytes == bytes, "unpack_bytes_into differs");
+    report(WIDTH, "unpack_bytes", scalar, slice);
+}
@@ -1,21 +1,12 @@
 use std::env;
 use std::process;
 
+use project02::bits::get_bitseq;
+
 unsafe extern "C" {
     fn get_bitseq_s(num: u32, start: i32, end: i32) -> u32;
 }
 
-fn get_bitseq(num: u32, start: i32, end: i32) -> u32 {
-    let len = (end - start) + 1;
-    let val = num >> start;
-    let mask = if len == 32 {
-        0xFFFFFFFF
-    } else {
-        (1u32 << len) - 1
-    };
-    val & mask
-}
-
 fn main() {
     let args: Vec<String> = env::args().collect();
     if args.len() != 4 {
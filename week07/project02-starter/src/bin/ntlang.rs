@@ -1,5 +1,12 @@
+use std::fs;
+use std::path::Path;
 use std::process::{self, Command};
 
+use project02::codegen::{codegen, codegen_asm};
+use project02::jit::JitFunc;
+use project02::parse::parse_program;
+use project02::scan::ScanTable;
+
 fn find_gcc() -> String {
     // Prefer cross-compiler if available (Docker), fall back to native gcc
     if Command::new("riscv64-linux-gnu-gcc").arg("--version")
@@ -12,6 +19,93 @@ fn find_gcc() -> String {
     }
 }
 
+fn usage() -> ! {
+    println!("usage: ntlang -e <expression> [-c <name> [-s] | -r [arg ...]]");
+    println!("  -e <expression>  expression to compile");
+    println!("  -c <name>        write <name>.s and link it into executable <name>");
+    println!("  -s               with -c, stop after writing <name>.s");
+    println!("  -r [arg ...]     run the code now with up to 8 int args (default 0)");
+    println!("Without -c the generated assembly is printed.");
+    process::exit(-1);
+}
+
 fn main() {
-    println!("ntlang");
+    let args: Vec<String> = std::env::args().collect();
+    let mut input: Option<String> = None;
+    let mut name: Option<String> = None;
+    let mut asm_only = false;
+    let mut run_args: Option<[i32; 8]> = None;
+
+    let mut i = 1;
+    while i < args.len() {
+        match args[i].as_str() {
+            "-e" if i + 1 < args.len() => {
+                input = Some(args[i + 1].clone());
+                i += 1;
+            }
+            "-c" if i + 1 < args.len() => {
+                name = Some(args[i + 1].clone());
+                i += 1;
+            }
+            "-s" => asm_only = true,
+            "-r" => {
+                let rest = &args[i + 1..];
+                if rest.len() > 8 {
+                    usage();
+                }
+                let mut a = [0i32; 8];
+                for (v, s) in a.iter_mut().zip(rest) {
+                    *v = s.parse().unwrap_or_else(|_| usage());
+                }
+                run_args = Some(a);
+                break;
+            }
+            _ => usage(),
+        }
+        i += 1;
+    }
+    let Some(input) = input else { usage() };
+
+    let mut scan_table = ScanTable::new();
+    scan_table.scan(&input);
+    let parse_tree = parse_program(&mut scan_table);
+    let cg = codegen(&parse_tree);
+
+    if let Some(a) = run_args {
+        let mut f = JitFunc::new(&cg.code);
+        let r = f.call(&a);
+        println!("{} (0x{:X})", r, r);
+        return;
+    }
+
+    let asm = codegen_asm(&cg, &input);
+
+    let Some(name) = name else {
+        print!("{}", asm);
+        return;
+    };
+
+    let asm_path = format!("{}.s", name);
+    if let Err(e) = fs::write(&asm_path, &asm) {
+        eprintln!("cannot write {}: {}", asm_path, e);
+        process::exit(-1);
+    }
+    if asm_only {
+        return;
+    }
+
+    let main_c = Path::new(env!("CARGO_MANIFEST_DIR")).join("c/codegen_main.c");
+    let status = Command::new(find_gcc())
+        .args(["-o", &name, &asm_path])
+        .arg(&main_c)
+        .status();
+    match status {
+        Ok(s) if s.success() => {
+            let _ = fs::remove_file(&asm_path);
+        }
+        _ => {
+            eprintln!("linking {} failed", name);
+            process::exit(-1);
+        }
+    }
 }
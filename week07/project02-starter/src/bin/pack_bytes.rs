@@ -1,18 +1,12 @@
 use std::env;
 use std::process;
 
+use project02::bits::pack_bytes;
+
 unsafe extern "C" {
     fn pack_bytes_s(b3: u32, b2: u32, b1: u32, b0: u32) -> i32;
 }
 
-fn pack_bytes(b3: u32, b2: u32, b1: u32, b0: u32) -> i32 {
-    let mut val: u32 = b3;
-    val = (val << 8) | b2;
-    val = (val << 8) | b1;
-    val = (val << 8) | b0;
-    val as i32
-}
-
 fn main() {
     let args: Vec<String> = env::args().collect();
     if args.len() != 5 {
@@ -1,11 +1,18 @@
 use std::env;
 use std::ffi::{CStr, CString};
+use std::hint::black_box;
 use std::process;
 
+use project02::timing::time_ns;
+
 unsafe extern "C" {
     fn rstr_s(dst: *mut u8, src: *const u8);
+    fn rstr_word_s(dst: *mut u8, src: *const u8);
 }
 
+// Length of the string the speed comparison runs on
+const BENCH_LEN: usize = 1 << 16;
+
 fn rstr(src: &str) -> String {
     let src_bytes = src.as_bytes();
     let src_len = src_bytes.len();
@@ -34,8 +41,38 @@ fn main() {
 
     let c_src = CString::new(input.as_str()).unwrap();
 
-    let mut dst_buf = [0u8; 1024];
+    let mut dst_buf = vec![0u8; input.len() + 1];
     unsafe { rstr_s(dst_buf.as_mut_ptr(), c_src.as_ptr() as *const u8) };
     let s_result = unsafe { CStr::from_ptr(dst_buf.as_ptr() as *const std::ffi::c_char) };
     println!("Asm: {}", s_result.to_str().unwrap());
+
+    let mut dst_buf = vec![0u8; input.len() + 1];
+    unsafe { rstr_word_s(dst_buf.as_mut_ptr(), c_src.as_ptr() as *const u8) };
+    let s_result = unsafe { CStr::from_ptr(dst_buf.as_ptr() as *const std::ffi::c_char) };
+    println!("Asm (word): {}", s_result.to_str().unwrap());
+
+    // Compare rstr_s and rstr_word_s on a long string built from the
+    // input. Only rstr_word_s is checked, since rstr_s may not be
+    // written yet.
+    let long = input.repeat(BENCH_LEN / input.len().max(1) + 1);
+    let c_long = CString::new(long.as_str()).unwrap();
+    let p = c_long.as_ptr() as *const u8;
+    let mut dst = vec![0u8; long.len() + 1];
+
+    unsafe { rstr_word_s(dst.as_mut_ptr(), p) };
+    if dst[..long.len()] != *rstr(&long).as_bytes() {
+        println!("MISMATCH reversing {} bytes", long.len());
+        process::exit(-1);
+    }
+
+    let d = dst.as_mut_ptr();
+    let byte_ns = time_ns(|| unsafe { rstr_s(black_box(d), black_box(p)) });
+    let word_ns = time_ns(|| unsafe { rstr_word_s(black_box(d), black_box(p)) });
+    println!(
+        "{} bytes: Asm {:.0} ns, Asm (word) {:.0} ns, {:.1}x",
+        long.len(),
+        byte_ns,
+        word_ns,
+        byte_ns / word_ns
+    );
 }
@@ -1,18 +1,12 @@
 use std::env;
 use std::process;
 
+use project02::bits::unpack_bytes;
+
 unsafe extern "C" {
     fn unpack_bytes_s(val: i32, bytes: *mut u32);
 }
 
-fn unpack_bytes(val: i32, bytes: &mut [u32; 4]) {
-    let mut v = val as u32;
-    for i in 0..4 {
-        bytes[i] = v & 0xFF;
-        v >>= 8;
-    }
-}
-
 fn main() {
     let args: Vec<String> = env::args().collect();
     if args.len() != 2 {
@@ -0,0 +1,186 @@
+// Slice versions of the bit and byte helpers
+//
+// Each binary in src/bin has a scalar Rust reference that handles one
+// value per call. These do the same work over a whole slice, except
+// that the byte order is reversed: unpack_bytes() puts b0 in bytes[0],
+// but unpack_bytes_into() writes b3, b2, b1, b0, the order
+// pack_bytes_into() reads them back in. The loops
+// are written so the compiler can vectorize them: the per-call setup
+// (masks, shift amounts) is hoisted out, there are no branches in the
+// loop body, and the input is walked with chunks_exact() so there are
+// no bounds checks.
+//
+// The scalar versions live here too, so the src/bin drivers and the
+// benchmarks compare against the same ones.
+
+// Scalar references
+
+pub fn get_bitseq(num: u32, start: i32, end: i32) -> u32 {
+    let len = (end - start) + 1;
+    let val = num >> start;
+    let mask = if len == 32 {
+        0xFFFFFFFF
+    } else {
+        (1u32 << len) - 1
+    };
+    val & mask
+}
+
+pub fn get_bitseq_signed(num: u32, start: i32, end: i32) -> i32 {
+    let val = get_bitseq(num, start, end);
+    let len = (end - start) + 1;
+    let shift_amt = 32 - len;
+    let val = val << shift_amt;
+    ((val as i32) >> shift_amt) as i32
+}
+
+pub fn pack_bytes(b3: u32, b2: u32, b1: u32, b0: u32) -> i32 {
+    let mut val: u32 = b3;
+    val = (val << 8) | b2;
+    val = (val << 8) | b1;
+    val = (val << 8) | b0;
+    val as i32
+}
+
+pub fn unpack_bytes(val: i32, bytes: &mut [u32; 4]) {
+    let mut v = val as u32;
+    for i in 0..4 {
+        bytes[i] = v & 0xFF;
+        v >>= 8;
+    }
+}
+
+// Slice versions. Each *_into function writes into a buffer the
+// caller can reuse, which must be exactly as long as the result; the
+// *_slice functions allocate the result.
+
+fn bitseq_mask(start: i32, end: i32) -> u32 {
+    let len = (end - start) + 1;
+    if len == 32 { 0xFFFFFFFF } else { (1u32 << len) - 1 }
+}
+
+// out[i] = get_bitseq(nums[i], start, end)
+pub fn get_bitseq_into(nums: &[u32], start: i32, end: i32, out: &mut [u32]) {
+    assert_eq!(out.len(), nums.len(), "get_bitseq: out and nums differ in length");
+
+    let mask = bitseq_mask(start, end);
+    let shift = start as u32;
+    for (o, &n) in out.iter_mut().zip(nums.iter()) {
+        *o = (n >> shift) & mask;
+    }
+}
+
+pub fn get_bitseq_slice(nums: &[u32], start: i32, end: i32) -> Vec<u32> {
+    let mut out = vec![0; nums.len()];
+    get_bitseq_into(nums, start, end, &mut out);
+    out
+}
+
+// out[i] = get_bitseq_signed(nums[i], start, end). The field is moved
+// to the top of the word and shifted back down arithmetically, which
+// needs no mask.
+pub fn get_bitseq_signed_into(nums: &[u32], start: i32, end: i32, out: &mut [i32]) {
+    assert_eq!(out.len(), nums.len(), "get_bitseq_signed: out and nums differ in length");
+
+    let up = (31 - end) as u32;
+    let down = (32 - (end - start + 1)) as u32;
+    for (o, &n) in out.iter_mut().zip(nums.iter()) {
+        *o = ((n << up) as i32) >> down;
+    }
+}
+
+pub fn get_bitseq_signed_slice(nums: &[u32], start: i32, end: i32) -> Vec<i32> {
+    let mut out = vec![0; nums.len()];
+    get_bitseq_signed_into(nums, start, end, &mut out);
+    out
+}
+
+// Packing and unpacking are byte swaps. Baseline x86_64 (SSE2) has no
+// byte shuffle, so on x86_64 the same loops are also compiled for SSSE3
+// and AVX2 (pshufb) and picked at run time. Elsewhere, including
+// RISC-V, the compiler vectorizes them for the target it is given.
+
+#[inline(always)]
+fn pack_bytes_loop(bytes: &[u8], out: &mut [u32]) {
+    for (o, b) in out.iter_mut().zip(bytes.chunks_exact(4)) {
+        *o = u32::from_be_bytes([b[0], b[1], b[2], b[3]]);
+    }
+}
+
+#[inline(always)]
+fn unpack_bytes_loop(vals: &[u32], out: &mut [u8]) {
+    for (o, &v) in out.chunks_exact_mut(4).zip(vals.iter()) {
+        o.copy_from_slice(&v.to_be_bytes());
+    }
+}
+
+#[cfg(target_arch = "x86_64")]
+mod x86 {
+    #[target_feature(enable = "avx2")]
+    pub fn pack_bytes_avx2(bytes: &[u8], out: &mut [u32]) {
+        super::pack_bytes_loop(bytes, out);
+    }
+
+    #[target_feature(enable = "ssse3")]
+    pub fn pack_bytes_ssse3(bytes: &[u8], out: &mut [u32]) {
+        super::pack_bytes_loop(bytes, out);
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub fn unpack_bytes_avx2(vals: &[u32], out: &mut [u8]) {
+        super::unpack_bytes_loop(vals, out);
+    }
+
+    #[target_feature(enable = "ssse3")]
+    pub fn unpack_bytes_ssse3(vals: &[u32], out: &mut [u8]) {
+        super::unpack_bytes_loop(vals, out);
+    }
+}
+
+// Pack each group of four bytes b3, b2, b1, b0 in bytes into one word,
+// as pack_bytes(b3, b2, b1, b0) does. bytes.len() must be a multiple
+// of 4.
+pub fn pack_bytes_into(bytes: &[u8], out: &mut [u32]) {
+    assert!(bytes.len().is_multiple_of(4), "pack_bytes: {} bytes is not a multiple of 4", bytes.len());
+    assert_eq!(out.len(), bytes.len() / 4, "pack_bytes: out is not one word per 4 bytes");
+
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return unsafe { x86::pack_bytes_avx2(bytes, out) };
+        }
+        if is_x86_feature_detected!("ssse3") {
+            return unsafe { x86::pack_bytes_ssse3(bytes, out) };
+        }
+    }
+    pack_bytes_loop(bytes, out);
+}
+
+pub fn pack_bytes_slice(bytes: &[u8]) -> Vec<u32> {
+    let mut out = vec![0; bytes.len() / 4];
+    pack_bytes_into(bytes, &mut out);
+    out
+}
+
+// Unpack each word in vals into its bytes b3, b2, b1, b0, so that
+// pack_bytes_slice(&unpack_bytes_slice(v)) == v
+pub fn unpack_bytes_into(vals: &[u32], out: &mut [u8]) {
+    assert_eq!(out.len(), vals.len() * 4, "unpack_bytes: out is not 4 bytes per word");
+
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return unsafe { x86::unpack_bytes_avx2(vals, out) };
+        }
+        if is_x86_feature_detected!("ssse3") {
+            return unsafe { x86::unpack_bytes_ssse3(vals, out) };
+        }
+    }
+    unpack_bytes_loop(vals, out);
+}
+
+pub fn unpack_bytes_slice(vals: &[u32]) -> Vec<u8> {
+    let mut out = vec![0; vals.len() * 4];
+    unpack_bytes_into(vals, &mut out);
+    out
+}
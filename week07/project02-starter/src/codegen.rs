@@ -0,0 +1,481 @@
+// codegen.rs - compile a parse tree to a RISC-V function
+//
+// The generated function is codegen_func_s(a0, ..., a7), which returns
+// the value of the expression as an int. Values are 32 bits, so the
+// arithmetic uses the RV64 *w instructions and every register holds a
+// sign-extended 32-bit value.
+//
+// Registers are allocated over the tree with Sethi-Ullman numbering:
+// need() is the number of temporaries a subtree takes, and the child
+// that needs more is evaluated first so its result ties up one register
+// through the cheaper child instead of the other way around. Argument
+// registers are used in place. A result only goes to the stack when the
+// other child cannot be evaluated in the registers that are left. A
+// peephole pass then folds li into the instruction using it.
+
+use std::collections::HashMap;
+
+use crate::parse::{Operator, ParseNode};
+
+// ============================================================================
+// Registers and instructions
+// ============================================================================
+
+pub const ZERO: u8 = 0;
+pub const SP: u8 = 2;
+pub const A0: u8 = 10;
+
+/// Temporaries the allocator may always use
+const TEMPS: [u8; 7] = [5, 6, 7, 28, 29, 30, 31];
+
+const REG_NAMES: [&str; 32] = [
+    "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1", "a2", "a3", "a4",
+    "a5", "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7", "s8", "s9", "s10", "s11", "t3", "t4",
+    "t5", "t6",
+];
+
+pub fn reg_name(r: u8) -> &'static str {
+    REG_NAMES[r as usize]
+}
+
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum InsnOp {
+    Li,
+    Mv,
+    Addw,
+    Subw,
+    Mulw,
+    Divw,
+    Sllw,
+    Srlw,
+    Sraw,
+    And,
+    Or,
+    Xor,
+    Addiw,
+    Andi,
+    Ori,
+    Xori,
+    Slliw,
+    Srliw,
+    Sraiw,
+    Addi,
+    Sw,
+    Lw,
+    Ret,
+}
+
+impl InsnOp {
+    pub fn name(&self) -> &str {
+        match self {
+            InsnOp::Li => "li",
+            InsnOp::Mv => "mv",
+            InsnOp::Addw => "addw",
+            InsnOp::Subw => "subw",
+            InsnOp::Mulw => "mulw",
+            InsnOp::Divw => "divw",
+            InsnOp::Sllw => "sllw",
+            InsnOp::Srlw => "srlw",
+            InsnOp::Sraw => "sraw",
+            InsnOp::And => "and",
+            InsnOp::Or => "or",
+            InsnOp::Xor => "xor",
+            InsnOp::Addiw => "addiw",
+            InsnOp::Andi => "andi",
+            InsnOp::Ori => "ori",
+            InsnOp::Xori => "xori",
+            InsnOp::Slliw => "slliw",
+            InsnOp::Srliw => "srliw",
+            InsnOp::Sraiw => "sraiw",
+            InsnOp::Addi => "addi",
+            InsnOp::Sw => "sw",
+            InsnOp::Lw => "lw",
+            InsnOp::Ret => "ret",
+        }
+    }
+}
+
+/// One instruction. li takes any 32-bit imm; the assembler expands it.
+/// For sw, rs2 is the value stored.
+#[derive(Debug, Clone, Copy)]
+pub struct Insn {
+    pub op: InsnOp,
+    pub rd: u8,
+    pub rs1: u8,
+    pub rs2: u8,
+    pub imm: i32,
+}
+
+impl Insn {
+    pub fn rr(op: InsnOp, rd: u8, rs1: u8, rs2: u8) -> Self {
+        Insn { op, rd, rs1, rs2, imm: 0 }
+    }
+
+    pub fn ri(op: InsnOp, rd: u8, rs1: u8, imm: i32) -> Self {
+        Insn { op, rd, rs1, rs2: ZERO, imm }
+    }
+
+    /// Registers read
+    fn reads(&self) -> [Option<u8>; 2] {
+        match self.op {
+            InsnOp::Li | InsnOp::Ret => [None, None],
+            InsnOp::Mv
+            | InsnOp::Addiw
+            | InsnOp::Andi
+            | InsnOp::Ori
+            | InsnOp::Xori
+            | InsnOp::Slliw
+            | InsnOp::Srliw
+            | InsnOp::Sraiw
+            | InsnOp::Addi
+            | InsnOp::Lw => [Some(self.rs1), None],
+            _ => [Some(self.rs1), Some(self.rs2)],
+        }
+    }
+
+    fn reads_reg(&self, r: u8) -> bool {
+        self.reads().contains(&Some(r))
+    }
+
+    /// Register written
+    fn writes(&self) -> Option<u8> {
+        match self.op {
+            InsnOp::Sw | InsnOp::Ret => None,
+            _ => Some(self.rd),
+        }
+    }
+
+    /// The form of this instruction with the register operand `reg`
+    /// replaced by the constant c, if there is one
+    fn with_imm(&self, reg: u8, c: i32) -> Option<Insn> {
+        let fits = |v: i32| (-2048..=2047).contains(&v);
+        let (other, first) = if self.op == InsnOp::Mv {
+            return (self.rs1 == reg).then(|| Insn::ri(InsnOp::Li, self.rd, ZERO, c));
+        } else if self.rs2 == reg && self.rs1 != reg {
+            (self.rs1, false)
+        } else if self.rs1 == reg && self.rs2 != reg {
+            (self.rs2, true)
+        } else {
+            return None;
+        };
+
+        // Only commutative ops can take the constant on the left
+        let (op, imm) = match self.op {
+            InsnOp::Addw if fits(c) => (InsnOp::Addiw, c),
+            InsnOp::And if fits(c) => (InsnOp::Andi, c),
+            InsnOp::Or if fits(c) => (InsnOp::Ori, c),
+            InsnOp::Xor if fits(c) => (InsnOp::Xori, c),
+            InsnOp::Subw if !first && c != i32::MIN && fits(-c) => (InsnOp::Addiw, -c),
+            InsnOp::Sllw if !first => (InsnOp::Slliw, c & 31),
+            InsnOp::Srlw if !first => (InsnOp::Srliw, c & 31),
+            InsnOp::Sraw if !first => (InsnOp::Sraiw, c & 31),
+            _ => return None,
+        };
+        Some(Insn::ri(op, self.rd, other, imm))
+    }
+
+    /// Format as an assembly statement
+    pub fn asm(&self) -> String {
+        let (rd, rs1, rs2) = (reg_name(self.rd), reg_name(self.rs1), reg_name(self.rs2));
+        let name = self.op.name();
+        match self.op {
+            InsnOp::Li => format!("{} {}, {}", name, rd, self.imm),
+            InsnOp::Mv => format!("{} {}, {}", name, rd, rs1),
+            InsnOp::Sw => format!("{} {}, {}({})", name, rs2, self.imm, rs1),
+            InsnOp::Lw => format!("{} {}, {}({})", name, rd, self.imm, rs1),
+            InsnOp::Ret => name.to_string(),
+            _ if self.reads()[1].is_none() => format!("{} {}, {}, {}", name, rd, rs1, self.imm),
+            _ => format!("{} {}, {}, {}", name, rd, rs1, rs2),
+        }
+    }
+}
+
+// ============================================================================
+// Code generation
+// ============================================================================
+
+fn codegen_error(msg: &str) -> ! {
+    eprintln!("codegen_error: {}", msg);
+    std::process::exit(-1);
+}
+
+/// Counts of what the generator did, for comparing code quality
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CodegenStats {
+    pub max_need: u32, // Sethi-Ullman number of the whole tree
+    pub temps: usize,  // registers available for temporaries
+    pub spills: usize, // results stored to the stack
+    pub folded: usize, // li instructions removed by the peephole pass
+}
+
+pub struct Codegen {
+    pub code: Vec<Insn>,
+    pub stats: CodegenStats,
+    need: HashMap<*const ParseNode, u32>,
+    pool: [bool; 32], // registers handed to the allocator
+    free: Vec<u8>,    // free ones, next one last
+    spill_depth: i32,
+    spill_max: i32,
+}
+
+/// Mark the argument registers the tree reads
+fn codegen_used_args(node: &ParseNode, used: &mut [bool; 8]) {
+    let mut work = vec![node];
+    while let Some(n) = work.pop() {
+        match n {
+            ParseNode::IntVal { .. } => {}
+            ParseNode::Reg { num } => used[*num as usize] = true,
+            ParseNode::Oper1 { operand, .. } => work.push(operand),
+            ParseNode::Oper2 { left, right, .. } => {
+                work.push(left);
+                work.push(right);
+            }
+        }
+    }
+}
+
+fn is_arg(node: &ParseNode) -> bool {
+    matches!(node, ParseNode::Reg { .. })
+}
+
+fn oper_insn(oper: Operator) -> InsnOp {
+    match oper {
+        Operator::Plus => InsnOp::Addw,
+        Operator::Minus => InsnOp::Subw,
+        Operator::Mult => InsnOp::Mulw,
+        Operator::Div => InsnOp::Divw,
+        Operator::Lsr => InsnOp::Srlw,
+        Operator::Asr => InsnOp::Sraw,
+        Operator::Lsl => InsnOp::Sllw,
+        Operator::And => InsnOp::And,
+        Operator::Or => InsnOp::Or,
+        Operator::Xor => InsnOp::Xor,
+        Operator::Not => codegen_error("Bad operator"),
+    }
+}
+
+impl Codegen {
+    /// Set up to compile node. Besides the t registers, argument
+    /// registers the expression never reads are free for temporaries.
+    fn new(node: &ParseNode) -> Self {
+        let mut used = [false; 8];
+        codegen_used_args(node, &mut used);
+
+        let mut free: Vec<u8> = (0..8).rev().filter(|&i| !used[i]).map(|i| A0 + i as u8).collect();
+        free.extend(TEMPS.iter().rev());
+        let mut pool = [false; 32];
+        for &r in free.iter() {
+            pool[r as usize] = true;
+        }
+
+        Codegen {
+            code: Vec::new(),
+            stats: CodegenStats { temps: free.len(), ..Default::default() },
+            need: HashMap::new(),
+            pool,
+            free,
+            spill_depth: 0,
+            spill_max: 0,
+        }
+    }
+
+    fn emit(&mut self, insn: Insn) {
+        self.code.push(insn);
+    }
+
+    fn alloc(&mut self) -> u8 {
+        self.free.pop().unwrap_or_else(|| codegen_error("out of registers"))
+    }
+
+    /// Give r back if it is a temporary
+    fn release(&mut self, r: u8) {
+        if self.pool[r as usize] {
+            self.free.push(r);
+        }
+    }
+
+    /// A register for the result of an operation on r: r itself if it
+    /// is a temporary, a new one otherwise
+    fn target(&mut self, r: u8) -> u8 {
+        if self.pool[r as usize] { r } else { self.alloc() }
+    }
+
+    /// Compute need() for every node. Arguments need no register, and
+    /// every other result needs one. For a binary node, evaluating one
+    /// child first holds its result (if it is not an argument) while the
+    /// other child is evaluated, and the cheaper order wins.
+    fn label(&mut self, node: &ParseNode) -> u32 {
+        let need = match node {
+            ParseNode::Reg { .. } => 0,
+            ParseNode::IntVal { .. } => 1,
+            ParseNode::Oper1 { operand, .. } => self.label(operand).max(1),
+            ParseNode::Oper2 { left, right, .. } => {
+                let (a, b) = (self.label(left), self.label(right));
+                let (hl, hr) = (!is_arg(left) as u32, !is_arg(right) as u32);
+                a.max(hl + b).min(b.max(hr + a)).max(1)
+            }
+        };
+        self.need.insert(node as *const ParseNode, need);
+        need
+    }
+
+    fn need(&self, node: &ParseNode) -> u32 {
+        self.need[&(node as *const ParseNode)]
+    }
+
+    /// Emit code for node and return the register holding its value
+    fn gen_expr(&mut self, node: &ParseNode) -> u8 {
+        match node {
+            ParseNode::Reg { num } => A0 + *num as u8,
+            ParseNode::IntVal { value } => {
+                let rd = self.alloc();
+                self.emit(Insn::ri(InsnOp::Li, rd, ZERO, *value as i32));
+                rd
+            }
+            ParseNode::Oper1 { oper, operand } => {
+                let r = self.gen_expr(operand);
+                let rd = self.target(r);
+                match oper {
+                    Operator::Minus => self.emit(Insn::rr(InsnOp::Subw, rd, ZERO, r)),
+                    Operator::Not => self.emit(Insn::ri(InsnOp::Xori, rd, r, -1)),
+                    _ => codegen_error("Bad operator"),
+                }
+                rd
+            }
+            ParseNode::Oper2 { oper, left, right } => {
+                let (a, b) = (self.need(left), self.need(right));
+                let (hl, hr) = (!is_arg(left) as u32, !is_arg(right) as u32);
+                let left_first = a.max(hl + b) <= b.max(hr + a);
+                let (first, second) = if left_first { (left, right) } else { (right, left) };
+
+                let mut r1 = self.gen_expr(first);
+
+                // Spill only if the second child does not fit in what is left
+                let spill = self.pool[r1 as usize] && (self.free.len() as u32) < self.need(second);
+                let slot = self.spill_depth * 4;
+                if spill {
+                    self.emit(Insn { op: InsnOp::Sw, rd: ZERO, rs1: SP, rs2: r1, imm: slot });
+                    self.release(r1);
+                    self.spill_depth += 1;
+                    self.spill_max = self.spill_max.max(self.spill_depth);
+                    self.stats.spills += 1;
+                }
+
+                let r2 = self.gen_expr(second);
+
+                if spill {
+                    self.spill_depth -= 1;
+                    r1 = self.alloc();
+                    self.emit(Insn::ri(InsnOp::Lw, r1, SP, slot));
+                }
+
+                let (rs1, rs2) = if left_first { (r1, r2) } else { (r2, r1) };
+                let rd = if self.pool[rs1 as usize] { rs1 } else { self.target(rs2) };
+                if rs1 != rd {
+                    self.release(rs1);
+                }
+                if rs2 != rd {
+                    self.release(rs2);
+                }
+                self.emit(Insn::rr(oper_insn(*oper), rd, rs1, rs2));
+                rd
+            }
+        }
+    }
+}
+
+/// Whether r is dead after code[i]: written before it is read again
+fn reg_dead_after(code: &[Insn], i: usize, r: u8) -> bool {
+    for insn in &code[i + 1..] {
+        if insn.reads_reg(r) {
+            return false;
+        }
+        if insn.writes() == Some(r) {
+            return true;
+        }
+        if insn.op == InsnOp::Ret {
+            return r != A0;
+        }
+    }
+    true
+}
+
+/// Fold li into the instruction that uses the constant, and make an
+/// instruction whose result is only moved elsewhere write there itself.
+/// Returns the number of li instructions removed.
+fn peephole(code: &mut Vec<Insn>) -> usize {
+    let mut folded = 0;
+    let mut i = 0;
+    while i < code.len() {
+        let insn = code[i];
+
+        if insn.op == InsnOp::Li {
+            // The first instruction after i that touches rd
+            let x = insn.rd;
+            let use_at = (i + 1..code.len()).find(|&j| code[j].reads_reg(x) || code[j].writes() == Some(x));
+            if let Some(j) = use_at {
+                let user = code[j];
+                if user.reads_reg(x)
+                    && (user.writes() == Some(x) || reg_dead_after(code, j, x))
+                    && let Some(new) = user.with_imm(x, insn.imm)
+                {
+                    code[j] = new;
+                    code.remove(i);
+                    folded += 1;
+                    continue;
+                }
+            }
+        }
+
+        if i + 1 < code.len() {
+            let next = code[i + 1];
+            if next.op == InsnOp::Mv
+                && insn.writes() == Some(next.rs1)
+                && reg_dead_after(code, i + 1, next.rs1)
+            {
+                code[i].rd = next.rd;
+                code.remove(i + 1);
+                continue;
+            }
+        }
+
+        i += 1;
+    }
+    folded
+}
+
+/// Compile node to the body of codegen_func_s
+pub fn codegen(node: &ParseNode) -> Codegen {
+    let mut cg = Codegen::new(node);
+    cg.stats.max_need = cg.label(node);
+
+    let r = cg.gen_expr(node);
+    if r != A0 {
+        cg.emit(Insn::rr(InsnOp::Mv, A0, r, ZERO));
+    }
+    cg.emit(Insn::rr(InsnOp::Ret, ZERO, ZERO, ZERO));
+    cg.stats.folded = peephole(&mut cg.code);
+
+    // One frame for all spill slots, kept 16-byte aligned
+    let frame = (cg.spill_max * 4 + 15) & !15;
+    if frame > 0 {
+        cg.code.insert(0, Insn::ri(InsnOp::Addi, SP, SP, -frame));
+        let ret = cg.code.len() - 1;
+        cg.code.insert(ret, Insn::ri(InsnOp::Addi, SP, SP, frame));
+    }
+    cg
+}
+
+/// Format the generated function as an assembly file
+pub fn codegen_asm(cg: &Codegen, input: &str) -> String {
+    let mut out = String::new();
+    out.push_str(".global codegen_func_s\n\n");
+    out.push_str(&format!("# {}\n\n", input));
+    out.push_str("codegen_func_s:\n");
+    for insn in cg.code.iter() {
+        out.push_str("    ");
+        out.push_str(&insn.asm());
+        out.push('\n');
+    }
+    out
+}
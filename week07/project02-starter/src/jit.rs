@@ -0,0 +1,164 @@
+// jit.rs - run generated code without assembling and linking it
+//
+// jit_encode() turns the instructions from codegen() into RISC-V
+// machine code. On a RISC-V host JitFunc copies the code into an
+// executable mmap-ed page and calls it through a function pointer.
+// Everywhere else it runs the same words in week09's rv_emu.
+
+use crate::codegen::{Insn, InsnOp};
+
+// week09's rvisa, the same tables rv_emu decodes with
+use rvisa::*;
+
+// ============================================================================
+// Encoder
+// ============================================================================
+
+/// Append the machine code for li rd, c: one addi if c fits in 12
+/// bits, otherwise lui plus addiw for the low bits
+fn encode_li(out: &mut Vec<u32>, rd: u32, c: i32) {
+    if (-2048..=2047).contains(&c) {
+        out.push(encode(&insn_i(OP_ADDI, rd, REG_ZERO, c)));
+        return;
+    }
+    let hi = ((c as i64 + 0x800) >> 12) << 12;
+    let lo = (c as i64 - hi) as i32;
+    out.push(encode(&insn_i(OP_LUI, rd, 0, hi as i32)));
+    if lo != 0 {
+        out.push(encode(&insn_i(OP_ADDIW, rd, rd, lo)));
+    }
+}
+
+/// The rvisa instruction for insn, which must not be a li
+fn jit_insn(insn: &Insn) -> rvisa::Insn {
+    let (rd, rs1, rs2, imm) = (insn.rd as u32, insn.rs1 as u32, insn.rs2 as u32, insn.imm);
+    match insn.op {
+        InsnOp::Li => unreachable!("li expands to more than one instruction"),
+        InsnOp::Mv => insn_i(OP_ADDI, rd, rs1, 0),
+        InsnOp::Addw => insn_r(OP_ADDW, rd, rs1, rs2),
+        InsnOp::Subw => insn_r(OP_SUBW, rd, rs1, rs2),
+        InsnOp::Mulw => insn_r(OP_MULW, rd, rs1, rs2),
+        InsnOp::Divw => insn_r(OP_DIVW, rd, rs1, rs2),
+        InsnOp::Sllw => insn_r(OP_SLLW, rd, rs1, rs2),
+        InsnOp::Srlw => insn_r(OP_SRLW, rd, rs1, rs2),
+        InsnOp::Sraw => insn_r(OP_SRAW, rd, rs1, rs2),
+        InsnOp::And => insn_r(OP_AND, rd, rs1, rs2),
+        InsnOp::Or => insn_r(OP_OR, rd, rs1, rs2),
+        InsnOp::Xor => insn_r(OP_XOR, rd, rs1, rs2),
+        InsnOp::Addiw => insn_i(OP_ADDIW, rd, rs1, imm),
+        InsnOp::Andi => insn_i(OP_ANDI, rd, rs1, imm),
+        InsnOp::Ori => insn_i(OP_ORI, rd, rs1, imm),
+        InsnOp::Xori => insn_i(OP_XORI, rd, rs1, imm),
+        InsnOp::Slliw => insn_i(OP_SLLIW, rd, rs1, imm),
+        InsnOp::Srliw => insn_i(OP_SRLIW, rd, rs1, imm),
+        InsnOp::Sraiw => insn_i(OP_SRAIW, rd, rs1, imm),
+        InsnOp::Addi => insn_i(OP_ADDI, rd, rs1, imm),
+        InsnOp::Sw => insn_s(OP_SW, rs1, rs2, imm),
+        InsnOp::Lw => insn_i(OP_LW, rd, rs1, imm),
+        InsnOp::Ret => insn_i(OP_JALR, REG_ZERO, REG_RA, 0),
+    }
+}
+
+/// Encode insn and append it to out
+pub fn jit_encode_insn(out: &mut Vec<u32>, insn: &Insn) {
+    match insn.op {
+        InsnOp::Li => encode_li(out, insn.rd as u32, insn.imm),
+        _ => out.push(encode(&jit_insn(insn))),
+    }
+}
+
+/// Encode a whole function
+pub fn jit_encode(code: &[Insn]) -> Vec<u32> {
+    let mut out = Vec::with_capacity(code.len() * 2);
+    for insn in code.iter() {
+        jit_encode_insn(&mut out, insn);
+    }
+    out
+}
+
+// ============================================================================
+// Running the code
+// ============================================================================
+
+/// A compiled codegen_func_s, ready to call
+pub struct JitFunc {
+    pub words: Vec<u32>,
+    #[cfg(target_arch = "riscv64")]
+    page: *mut libc::c_void,
+    #[cfg(target_arch = "riscv64")]
+    page_len: usize,
+    #[cfg(not(target_arch = "riscv64"))]
+    state: Box<week09::rv_emu::RvState>,
+}
+
+#[cfg(target_arch = "riscv64")]
+fn jit_error(msg: &str) -> ! {
+    eprintln!("jit_error: {}", msg);
+    std::process::exit(-1);
+}
+
+#[cfg(target_arch = "riscv64")]
+impl JitFunc {
+    pub fn new(code: &[Insn]) -> Self {
+        // riscv_flush_icache(start, end, flags), which libc does not name
+        const SYS_RISCV_FLUSH_ICACHE: libc::c_long = 259;
+
+        let words = jit_encode(code);
+        let page_len = (words.len() * 4).div_ceil(4096) * 4096;
+        unsafe {
+            let page = libc::mmap(
+                std::ptr::null_mut(),
+                page_len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS,
+                -1,
+                0,
+            );
+            if page == libc::MAP_FAILED {
+                jit_error("cannot map a code page");
+            }
+            std::ptr::copy_nonoverlapping(words.as_ptr(), page as *mut u32, words.len());
+            if libc::mprotect(page, page_len, libc::PROT_READ | libc::PROT_EXEC) != 0 {
+                jit_error("cannot make the code page executable");
+            }
+            // Make the new code visible to instruction fetch on every hart
+            let end = (page as usize + words.len() * 4) as libc::c_long;
+            libc::syscall(SYS_RISCV_FLUSH_ICACHE, page as libc::c_long, end, 0 as libc::c_long);
+            JitFunc { words, page, page_len }
+        }
+    }
+
+    pub fn call(&mut self, args: &[i32; 8]) -> i32 {
+        type CodegenFunc = extern "C" fn(i32, i32, i32, i32, i32, i32, i32, i32) -> i32;
+        let f: CodegenFunc = unsafe { std::mem::transmute(self.page) };
+        let a = args;
+        f(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7])
+    }
+}
+
+#[cfg(target_arch = "riscv64")]
+impl Drop for JitFunc {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.page, self.page_len) };
+    }
+}
+
+#[cfg(not(target_arch = "riscv64"))]
+impl JitFunc {
+    pub fn new(code: &[Insn]) -> Self {
+        JitFunc { words: jit_encode(code), state: week09::rv_emu::RvState::new() }
+    }
+
+    pub fn call(&mut self, args: &[i32; 8]) -> i32 {
+        use week09::rv_emu::{rv_emulate, rv_init, RV_A0};
+
+        let s = &mut self.state;
+        s.reset();
+        rv_init(s, self.words.as_ptr(), 0, 0, 0, 0);
+        // Arguments are sign-extended, as the calling convention requires
+        for (i, &a) in args.iter().enumerate() {
+            s.regs[RV_A0 + i] = a as i64 as u64;
+        }
+        rv_emulate(s) as i32
+    }
+}
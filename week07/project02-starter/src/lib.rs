@@ -0,0 +1,9 @@
+pub mod bits;
+pub mod codegen;
+pub mod jit;
+pub mod parse;
+pub mod scan;
+
+// Shared with the week07 examples
+#[path = "../../examples/src/timing.rs"]
+pub mod timing;
@@ -0,0 +1,209 @@
+// parse.rs - parsing and parse tree construction
+//
+// # Parser EBNF
+//
+// program    ::= expression EOT
+// expression ::= operand (operator operand)*
+// operand    ::= intlit | hexlit | binlit | register
+//              | '-' operand | '~' operand | '(' expression ')'
+// operator   ::= '+' | '-' | '*' | '/' | '>>' | '>-' | '<<'
+//              | '&' | '|' | '^'
+//
+// Operators have no precedence and group left to right, so
+// 1 + 2 * 3 is (1 + 2) * 3.
+
+use std::process;
+
+use crate::scan::{ScanTable, Token, TokenType};
+
+// ============================================================================
+// Parse Tree
+// ============================================================================
+
+/// Operator types
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Operator {
+    Plus,
+    Minus,
+    Mult,
+    Div,
+    Lsr,
+    Asr,
+    Lsl,
+    And,
+    Or,
+    Xor,
+    Not,
+}
+
+impl Operator {
+    pub fn name(&self) -> &str {
+        match self {
+            Operator::Plus => "PLUS",
+            Operator::Minus => "MINUS",
+            Operator::Mult => "MULT",
+            Operator::Div => "DIV",
+            Operator::Lsr => "LSR",
+            Operator::Asr => "ASR",
+            Operator::Lsl => "LSL",
+            Operator::And => "AND",
+            Operator::Or => "OR",
+            Operator::Xor => "XOR",
+            Operator::Not => "NOT",
+        }
+    }
+}
+
+/// Parse tree node types
+pub enum ParseNode {
+    IntVal { value: u32 },
+    Reg { num: u32 },
+    Oper1 { oper: Operator, operand: Box<ParseNode> },
+    Oper2 { oper: Operator, left: Box<ParseNode>, right: Box<ParseNode> },
+}
+
+impl ParseNode {
+    /// Create a new IntVal node
+    pub fn new_intval(value: u32) -> Self {
+        ParseNode::IntVal { value }
+    }
+
+    /// Create a new Reg node
+    pub fn new_reg(num: u32) -> Self {
+        ParseNode::Reg { num }
+    }
+
+    /// Create a new Oper1 node
+    pub fn new_oper1(oper: Operator, operand: ParseNode) -> Self {
+        ParseNode::Oper1 {
+            oper,
+            operand: Box::new(operand),
+        }
+    }
+
+    /// Create a new Oper2 node
+    pub fn new_oper2(oper: Operator, left: ParseNode, right: ParseNode) -> Self {
+        ParseNode::Oper2 {
+            oper,
+            left: Box::new(left),
+            right: Box::new(right),
+        }
+    }
+}
+
+/// Print indentation for parse tree output
+fn parse_tree_print_indent(level: usize) {
+    for _ in 0..(level * 2) {
+        print!(".");
+    }
+}
+
+/// Print a parse tree node recursively
+fn parse_tree_print_expr(node: &ParseNode, level: usize) {
+    parse_tree_print_indent(level);
+    print!("EXPR ");
+
+    match node {
+        ParseNode::IntVal { value } => {
+            println!("INTVAL {}", value);
+        }
+        ParseNode::Reg { num } => {
+            println!("REG a{}", num);
+        }
+        ParseNode::Oper1 { oper, operand } => {
+            println!("OPER1 {}", oper.name());
+            parse_tree_print_expr(operand, level + 1);
+        }
+        ParseNode::Oper2 { oper, left, right } => {
+            println!("OPER2 {}", oper.name());
+            parse_tree_print_expr(left, level + 1);
+            parse_tree_print_expr(right, level + 1);
+        }
+    }
+}
+
+/// Print the entire parse tree
+pub fn parse_tree_print(node: &ParseNode) {
+    parse_tree_print_expr(node, 0);
+}
+
+// ============================================================================
+// Parser
+// ============================================================================
+
+/// Report a parse error and exit
+fn parse_error(msg: &str) -> ! {
+    eprintln!("parse_error: {}", msg);
+    process::exit(-1);
+}
+
+/// Parse a complete program: expression EOT
+pub fn parse_program(scan_table: &mut ScanTable) -> ParseNode {
+    let expr = parse_expression(scan_table);
+
+    if !scan_table.accept(TokenType::Eot) {
+        parse_error("Expecting EOT");
+    }
+
+    expr
+}
+
+/// Map a binary operator token to its operator
+fn parse_operator(token: &Token) -> Option<Operator> {
+    match token.token_type() {
+        TokenType::Plus => Some(Operator::Plus),
+        TokenType::Minus => Some(Operator::Minus),
+        TokenType::Mult => Some(Operator::Mult),
+        TokenType::Div => Some(Operator::Div),
+        TokenType::Lsr => Some(Operator::Lsr),
+        TokenType::Asr => Some(Operator::Asr),
+        TokenType::Lsl => Some(Operator::Lsl),
+        TokenType::And => Some(Operator::And),
+        TokenType::Or => Some(Operator::Or),
+        TokenType::Xor => Some(Operator::Xor),
+        _ => None,
+    }
+}
+
+/// Parse an expression: operand (operator operand)*
+fn parse_expression(scan_table: &mut ScanTable) -> ParseNode {
+    let mut left = parse_operand(scan_table);
+
+    while let Some(oper) = parse_operator(scan_table.get(0)) {
+        scan_table.accept_any();
+        let right = parse_operand(scan_table);
+        left = ParseNode::new_oper2(oper, left, right);
+    }
+
+    left
+}
+
+/// Convert literal digits in the given radix, which must fit in 32 bits
+fn parse_literal(digits: &str, radix: u32) -> u32 {
+    u32::from_str_radix(digits, radix).unwrap_or_else(|_| {
+        parse_error("Invalid integer literal");
+    })
+}
+
+/// Parse an operand
+fn parse_operand(scan_table: &mut ScanTable) -> ParseNode {
+    let token = scan_table.get(0).clone();
+    scan_table.accept_any();
+
+    match token {
+        Token::IntLit(s) => ParseNode::new_intval(parse_literal(&s, 10)),
+        Token::HexLit(s) => ParseNode::new_intval(parse_literal(&s, 16)),
+        Token::BinLit(s) => ParseNode::new_intval(parse_literal(&s, 2)),
+        Token::Reg(num) => ParseNode::new_reg(num),
+        Token::Minus => ParseNode::new_oper1(Operator::Minus, parse_operand(scan_table)),
+        Token::Not => ParseNode::new_oper1(Operator::Not, parse_operand(scan_table)),
+        Token::LParen => {
+            let expr = parse_expression(scan_table);
+            if !scan_table.accept(TokenType::RParen) {
+                parse_error("Expecting ')'");
+            }
+            expr
+        }
+        _ => parse_error("Bad operand"),
+    }
+}
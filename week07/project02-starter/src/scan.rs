@@ -0,0 +1,352 @@
+// scan.rs - the ntlang scanner
+//
+// # Scanner EBNF (microsyntax)
+//
+// tokens   ::= (token)*
+// token    ::= intlit | hexlit | binlit | register | symbol
+// symbol   ::= '+' | '-' | '*' | '/' | '>>' | '>-' | '<<' | '&' | '|'
+//            | '^' | '~' | '(' | ')'
+// intlit   ::= digit (digit)*
+// hexlit   ::= '0x' hexdigit (hexdigit)*
+// binlit   ::= '0b' bindigit (bindigit)*
+// register ::= 'a' ('0' | '1' | ... | '7')
+// digit    ::= '0' | '1' | ... | '9'
+//
+// # Ignore
+// whitespace ::= (' ' | '\t') (' ' | '\t')*
+
+use std::fmt;
+use std::process;
+
+// ============================================================================
+// Token types
+// ============================================================================
+
+/// Token type identifier for matching (without associated data)
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum TokenType {
+    IntLit,
+    HexLit,
+    BinLit,
+    Reg,
+    Plus,
+    Minus,
+    Mult,
+    Div,
+    Lsr,
+    Asr,
+    Lsl,
+    And,
+    Or,
+    Xor,
+    Not,
+    LParen,
+    RParen,
+    Eot,
+}
+
+/// Token enum with associated data
+#[derive(Debug, Clone)]
+pub enum Token {
+    IntLit(String), // Integer literal: "1", "22", "403"
+    HexLit(String), // Hex literal, digits only: "ff" for 0xff
+    BinLit(String), // Binary literal, digits only: "101" for 0b101
+    Reg(u32),       // Argument register: a0 .. a7
+    Plus,           // +
+    Minus,          // -
+    Mult,           // *
+    Div,            // /
+    Lsr,            // >>
+    Asr,            // >-
+    Lsl,            // <<
+    And,            // &
+    Or,             // |
+    Xor,            // ^
+    Not,            // ~
+    LParen,         // (
+    RParen,         // )
+    Eot,            // End of text
+}
+
+impl Token {
+    /// Returns the string value of the token
+    pub fn value(&self) -> String {
+        match self {
+            Token::IntLit(s) | Token::HexLit(s) | Token::BinLit(s) => s.clone(),
+            Token::Reg(n) => format!("a{}", n),
+            Token::Plus => "+".to_string(),
+            Token::Minus => "-".to_string(),
+            Token::Mult => "*".to_string(),
+            Token::Div => "/".to_string(),
+            Token::Lsr => ">>".to_string(),
+            Token::Asr => ">-".to_string(),
+            Token::Lsl => "<<".to_string(),
+            Token::And => "&".to_string(),
+            Token::Or => "|".to_string(),
+            Token::Xor => "^".to_string(),
+            Token::Not => "~".to_string(),
+            Token::LParen => "(".to_string(),
+            Token::RParen => ")".to_string(),
+            Token::Eot => "".to_string(),
+        }
+    }
+
+    /// Returns the token name (for printing)
+    pub fn name(&self) -> &str {
+        match self {
+            Token::IntLit(_) => "TK_INTLIT",
+            Token::HexLit(_) => "TK_HEXLIT",
+            Token::BinLit(_) => "TK_BINLIT",
+            Token::Reg(_) => "TK_REG",
+            Token::Plus => "TK_PLUS",
+            Token::Minus => "TK_MINUS",
+            Token::Mult => "TK_MULT",
+            Token::Div => "TK_DIV",
+            Token::Lsr => "TK_LSR",
+            Token::Asr => "TK_ASR",
+            Token::Lsl => "TK_LSL",
+            Token::And => "TK_AND",
+            Token::Or => "TK_OR",
+            Token::Xor => "TK_XOR",
+            Token::Not => "TK_NOT",
+            Token::LParen => "TK_LPAREN",
+            Token::RParen => "TK_RPAREN",
+            Token::Eot => "TK_EOT",
+        }
+    }
+
+    /// Returns the token type for matching
+    pub fn token_type(&self) -> TokenType {
+        match self {
+            Token::IntLit(_) => TokenType::IntLit,
+            Token::HexLit(_) => TokenType::HexLit,
+            Token::BinLit(_) => TokenType::BinLit,
+            Token::Reg(_) => TokenType::Reg,
+            Token::Plus => TokenType::Plus,
+            Token::Minus => TokenType::Minus,
+            Token::Mult => TokenType::Mult,
+            Token::Div => TokenType::Div,
+            Token::Lsr => TokenType::Lsr,
+            Token::Asr => TokenType::Asr,
+            Token::Lsl => TokenType::Lsl,
+            Token::And => TokenType::And,
+            Token::Or => TokenType::Or,
+            Token::Xor => TokenType::Xor,
+            Token::Not => TokenType::Not,
+            Token::LParen => TokenType::LParen,
+            Token::RParen => TokenType::RParen,
+            Token::Eot => TokenType::Eot,
+        }
+    }
+}
+
+impl fmt::Display for Token {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        write!(f, "{}(\"{}\")", self.name(), self.value())
+    }
+}
+
+// ============================================================================
+// Scanner
+// ============================================================================
+
+/// Scanner for tokenizing input strings
+struct Scanner {
+    chars: Vec<char>,
+    pos: usize,
+}
+
+fn scan_error(msg: &str) -> ! {
+    eprintln!("scan error: {}", msg);
+    process::exit(-1);
+}
+
+impl Scanner {
+    /// Create a new scanner for the given input
+    fn new(input: &str) -> Self {
+        Scanner {
+            chars: input.chars().collect(),
+            pos: 0,
+        }
+    }
+
+    /// Check if we've reached the end of input
+    fn at_end(&self) -> bool {
+        self.pos >= self.chars.len()
+    }
+
+    /// Get the character i past the current one (or '\0' past the end)
+    fn peek(&self, i: usize) -> char {
+        self.chars.get(self.pos + i).copied().unwrap_or('\0')
+    }
+
+    /// Get the current character (or '\0' if at end)
+    fn current(&self) -> char {
+        self.peek(0)
+    }
+
+    /// Advance position and return the character we just passed
+    fn advance(&mut self) -> char {
+        let ch = self.current();
+        self.pos += 1;
+        ch
+    }
+
+    /// Skip whitespace characters
+    fn skip_whitespace(&mut self) {
+        while !self.at_end() && (self.current() == ' ' || self.current() == '\t') {
+            self.advance();
+        }
+    }
+
+    /// Collect the run of characters accepted by is_digit
+    fn scan_digits(&mut self, is_digit: fn(char) -> bool) -> String {
+        let mut value = String::new();
+        while !self.at_end() && is_digit(self.current()) {
+            value.push(self.advance());
+        }
+        value
+    }
+
+    /// Scan an integer, hex or binary literal
+    fn scan_intlit(&mut self) -> Token {
+        if self.current() == '0' && (self.peek(1) == 'x' || self.peek(1) == 'b') {
+            self.advance();
+            let hex = self.advance() == 'x';
+            let digits = if hex {
+                self.scan_digits(|c| c.is_ascii_hexdigit())
+            } else {
+                self.scan_digits(|c| c == '0' || c == '1')
+            };
+            if digits.is_empty() {
+                scan_error("missing digits after literal prefix");
+            }
+            return if hex { Token::HexLit(digits) } else { Token::BinLit(digits) };
+        }
+        Token::IntLit(self.scan_digits(|c| c.is_ascii_digit()))
+    }
+
+    /// Scan a single token from the input
+    fn scan_token(&mut self) -> Token {
+        self.skip_whitespace();
+
+        if self.at_end() {
+            return Token::Eot;
+        }
+
+        let ch = self.current();
+
+        if ch.is_ascii_digit() {
+            return self.scan_intlit();
+        }
+
+        if ch == 'a' && ('0'..='7').contains(&self.peek(1)) {
+            self.advance();
+            return Token::Reg(self.advance() as u32 - '0' as u32);
+        }
+
+        // Two character tokens
+        let two = match (ch, self.peek(1)) {
+            ('>', '>') => Some(Token::Lsr),
+            ('>', '-') => Some(Token::Asr),
+            ('<', '<') => Some(Token::Lsl),
+            _ => None,
+        };
+        if let Some(token) = two {
+            self.pos += 2;
+            return token;
+        }
+
+        // Single character tokens
+        self.advance();
+        match ch {
+            '+' => Token::Plus,
+            '-' => Token::Minus,
+            '*' => Token::Mult,
+            '/' => Token::Div,
+            '&' => Token::And,
+            '|' => Token::Or,
+            '^' => Token::Xor,
+            '~' => Token::Not,
+            '(' => Token::LParen,
+            ')' => Token::RParen,
+            _ => scan_error(&format!("invalid char: {}", ch)),
+        }
+    }
+
+    /// Scan all tokens from the input
+    fn scan_all(&mut self) -> Vec<Token> {
+        let mut tokens = Vec::new();
+        loop {
+            let token = self.scan_token();
+            let is_eot = matches!(token, Token::Eot);
+            tokens.push(token);
+            if is_eot {
+                break;
+            }
+        }
+        tokens
+    }
+}
+
+// ============================================================================
+// Scan Table
+// ============================================================================
+
+/// Table of scanned tokens with current position tracking for parsing
+#[derive(Default)]
+pub struct ScanTable {
+    tokens: Vec<Token>,
+    cur: usize, // Current position for parsing
+}
+
+impl ScanTable {
+    /// Create a new empty scan table
+    pub fn new() -> Self {
+        ScanTable::default()
+    }
+
+    /// Scan all tokens from the input string
+    pub fn scan(&mut self, input: &str) {
+        let mut scanner = Scanner::new(input);
+        self.tokens = scanner.scan_all();
+        self.cur = 0;
+    }
+
+    /// Print all tokens in the table
+    pub fn print(&self) {
+        for token in &self.tokens {
+            println!("{}", token);
+        }
+    }
+
+    /// Get the token at position cur + i
+    pub fn get(&self, i: isize) -> &Token {
+        let index = (self.cur as isize + i) as usize;
+        &self.tokens[index]
+    }
+
+    /// Accept the current token if it matches the expected type
+    /// Returns true and advances cur if it matches, false otherwise
+    pub fn accept(&mut self, expected: TokenType) -> bool {
+        if self.cur >= self.tokens.len() {
+            return false;
+        }
+
+        if self.tokens[self.cur].token_type() == expected {
+            self.cur += 1;
+            return true;
+        }
+
+        false
+    }
+
+    /// Accept any token (wildcard match) - always succeeds if not at end
+    pub fn accept_any(&mut self) -> bool {
+        if self.cur >= self.tokens.len() {
+            return false;
+        }
+        self.cur += 1;
+        true
+    }
+}
@@ -0,0 +1,21 @@
+.global amo_count_s
+
+.text
+
+# a0 = pointer to a shared int counter
+# a1 = n
+# return n
+#
+# Add 1 to the counter n times with amoadd.w. Harts running this on the
+# same counter at once never lose an add.
+amo_count_s:
+    li t0, 1
+    mv t1, a1               # t1 = adds left
+amo_count_s_loop:
+    beqz t1, amo_count_s_done
+    amoadd.w zero, t0, (a0) # *counter += 1, atomically
+    addi t1, t1, -1
+    j amo_count_s_loop
+amo_count_s_done:
+    mv a0, a1
+    ret
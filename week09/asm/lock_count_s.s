@@ -0,0 +1,34 @@
+.global lock_count_s
+
+.text
+
+# a0 = pointer to a shared int lock, 0 when free
+# a1 = pointer to a shared int counter
+# a2 = n
+# return the number of failed sc.w
+#
+# Add 1 to the counter n times with a plain lw and sw, each time holding
+# a spin lock taken with lr.w/sc.w and released with amoswap.w.rl. The
+# count is only right if the lock works.
+lock_count_s:
+    li t0, 1
+    li t3, 0                # t3 = failed sc.w
+lock_count_s_loop:
+    beqz a2, lock_count_s_done
+lock_count_s_acquire:
+    lr.w.aq t1, (a0)
+    bnez t1, lock_count_s_acquire   # held by another hart, wait
+    sc.w t2, t0, (a0)
+    beqz t2, lock_count_s_locked
+    addi t3, t3, 1
+    j lock_count_s_acquire
+lock_count_s_locked:
+    lw t1, 0(a1)            # *counter += 1 while holding the lock
+    addi t1, t1, 1
+    sw t1, 0(a1)
+    amoswap.w.rl zero, zero, (a0)   # release
+    addi a2, a2, -1
+    j lock_count_s_loop
+lock_count_s_done:
+    mv a0, t3
+    ret
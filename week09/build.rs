@@ -1,3 +1,5 @@
+// The kernels bench shares with week06 and week07 are built from their
+// sources there rather than from copies
 fn main() {
     let target = std::env::var("TARGET").unwrap_or_default();
 
@@ -5,10 +7,26 @@ fn main() {
         cc::Build::new()
             .flag("-march=rv64g")
             .file("asm/add2_s.s")
+            .file("../week06/asm/sumarr_idx_s.s")
+            .file("../week06/asm/sumarr_ptr_s.s")
+            .file("../week06/asm/factrec_s.s")
+            .file("../week07/examples/asm/strlen_s.s")
+            .file("../week07/examples/asm/strlen_word_s.s")
+            .file("../week07/examples/asm/get_bitseq_s.s")
+            .file("asm/amo_count_s.s")
+            .file("asm/lock_count_s.s")
             .compile("asm_functions");
 
         println!("cargo:rustc-link-arg-bins=-lasm_functions");
     }
 
     println!("cargo:rerun-if-changed=asm/add2_s.s");
+    println!("cargo:rerun-if-changed=../week06/asm/sumarr_idx_s.s");
+    println!("cargo:rerun-if-changed=../week06/asm/sumarr_ptr_s.s");
+    println!("cargo:rerun-if-changed=../week06/asm/factrec_s.s");
+    println!("cargo:rerun-if-changed=../week07/examples/asm/strlen_s.s");
+    println!("cargo:rerun-if-changed=../week07/examples/asm/strlen_word_s.s");
+    println!("cargo:rerun-if-changed=../week07/examples/asm/get_bitseq_s.s");
+    println!("cargo:rerun-if-changed=asm/amo_count_s.s");
+    println!("cargo:rerun-if-changed=asm/lock_count_s.s");
 }
@@ -0,0 +1,585 @@
+// rvisa - RV64IMA instruction fields, encoding and decoding
+//
+// week09's rv_emu decodes guest code with this crate and project02's
+// ntlang JIT encodes its code with it, so both agree on every bit of
+// every format. Everything that can be is a const fn.
+
+// ============================================================================
+// Registers and major opcodes
+// ============================================================================
+
+pub const REG_ZERO: u32 = 0;
+pub const REG_RA: u32 = 1;
+pub const REG_SP: u32 = 2;
+pub const REG_A0: u32 = 10;
+
+// Major opcodes (iw bits 6:0)
+pub const OPC_LOAD: u32 = 0b0000011;
+pub const OPC_MISC_MEM: u32 = 0b0001111;
+pub const OPC_OP_IMM: u32 = 0b0010011;
+pub const OPC_AUIPC: u32 = 0b0010111;
+pub const OPC_OP_IMM_32: u32 = 0b0011011;
+pub const OPC_STORE: u32 = 0b0100011;
+pub const OPC_AMO: u32 = 0b0101111;
+pub const OPC_OP: u32 = 0b0110011;
+pub const OPC_LUI: u32 = 0b0110111;
+pub const OPC_OP_32: u32 = 0b0111011;
+pub const OPC_BRANCH: u32 = 0b1100011;
+pub const OPC_JALR: u32 = 0b1100111;
+pub const OPC_JAL: u32 = 0b1101111;
+
+// ============================================================================
+// Fields
+// ============================================================================
+
+pub const fn get_opcode(iw: u32) -> u32 {
+    iw & 0x7f
+}
+
+pub const fn get_rd(iw: u32) -> u32 {
+    (iw >> 7) & 0x1f
+}
+
+pub const fn get_funct3(iw: u32) -> u32 {
+    (iw >> 12) & 0x7
+}
+
+pub const fn get_rs1(iw: u32) -> u32 {
+    (iw >> 15) & 0x1f
+}
+
+pub const fn get_rs2(iw: u32) -> u32 {
+    (iw >> 20) & 0x1f
+}
+
+pub const fn get_funct7(iw: u32) -> u32 {
+    iw >> 25
+}
+
+// The A extension splits funct7 into funct5 and the aq and rl bits
+pub const fn get_funct5(iw: u32) -> u32 {
+    iw >> 27
+}
+
+pub const fn get_aqrl(iw: u32) -> u32 {
+    (iw >> 25) & 0x3
+}
+
+// The immediates are sign-extended from iw bit 31 in every format
+
+pub const fn get_imm_i(iw: u32) -> i32 {
+    (iw as i32) >> 20
+}
+
+pub const fn get_imm_s(iw: u32) -> i32 {
+    ((iw as i32) >> 25) << 5 | ((iw >> 7) & 0x1f) as i32
+}
+
+pub const fn get_imm_b(iw: u32) -> i32 {
+    ((iw as i32) >> 31) << 12
+        | (((iw >> 7) & 0x1) << 11) as i32
+        | (((iw >> 25) & 0x3f) << 5) as i32
+        | (((iw >> 8) & 0xf) << 1) as i32
+}
+
+// The upper 20 bits in place, as lui loads them
+pub const fn get_imm_u(iw: u32) -> i32 {
+    (iw & 0xfffff000) as i32
+}
+
+pub const fn get_imm_j(iw: u32) -> i32 {
+    ((iw as i32) >> 31) << 20
+        | (((iw >> 12) & 0xff) << 12) as i32
+        | (((iw >> 20) & 0x1) << 11) as i32
+        | (((iw >> 21) & 0x3ff) << 1) as i32
+}
+
+// ============================================================================
+// Formats
+// ============================================================================
+
+// Each encoder is the inverse of the field getters above. Immediates
+// are truncated to what the format holds.
+
+pub const fn encode_r(opcode: u32, funct3: u32, funct7: u32, rd: u32, rs1: u32, rs2: u32) -> u32 {
+    funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode
+}
+
+pub const fn encode_i(opcode: u32, funct3: u32, rd: u32, rs1: u32, imm: i32) -> u32 {
+    ((imm as u32) & 0xfff) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode
+}
+
+pub const fn encode_s(opcode: u32, funct3: u32, rs1: u32, rs2: u32, imm: i32) -> u32 {
+    let imm = imm as u32;
+    ((imm >> 5) & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (imm & 0x1f) << 7 | opcode
+}
+
+pub const fn encode_b(opcode: u32, funct3: u32, rs1: u32, rs2: u32, imm: i32) -> u32 {
+    let imm = imm as u32;
+    ((imm >> 12) & 0x1) << 31
+        | ((imm >> 5) & 0x3f) << 25
+        | rs2 << 20
+        | rs1 << 15
+        | funct3 << 12
+        | ((imm >> 1) & 0xf) << 8
+        | ((imm >> 11) & 0x1) << 7
+        | opcode
+}
+
+// imm is the value lui would load; its low 12 bits are dropped
+pub const fn encode_u(opcode: u32, rd: u32, imm: i32) -> u32 {
+    (imm as u32) & 0xfffff000 | rd << 7 | opcode
+}
+
+pub const fn encode_j(opcode: u32, rd: u32, imm: i32) -> u32 {
+    let imm = imm as u32;
+    ((imm >> 20) & 0x1) << 31
+        | ((imm >> 1) & 0x3ff) << 21
+        | ((imm >> 11) & 0x1) << 20
+        | ((imm >> 12) & 0xff) << 12
+        | rd << 7
+        | opcode
+}
+
+// ============================================================================
+// Instructions
+// ============================================================================
+
+// Define the number of each instruction, in order, OP_COUNT and
+// OP_NAMES
+macro_rules! rv_ops {
+    (@def $n:expr,) => {};
+    (@def $n:expr, $name:ident, $($rest:ident,)*) => {
+        pub const $name: u8 = $n;
+        rv_ops!(@def $n + 1, $($rest,)*);
+    };
+    ($($name:ident),* $(,)?) => {
+        rv_ops!(@def 0, $($name,)*);
+        pub const OP_COUNT: usize = [$(stringify!($name)),*].len();
+        pub static OP_NAMES: [&str; OP_COUNT] = [$(stringify!($name)),*];
+    };
+}
+
+// Everything from OP_JAL on changes pc
+rv_ops!(
+    OP_UNSUPPORTED,
+    OP_LUI, OP_AUIPC,
+    OP_ADDI, OP_SLTI, OP_SLTIU, OP_XORI, OP_ORI, OP_ANDI,
+    OP_SLLI, OP_SRLI, OP_SRAI,
+    OP_ADD, OP_SUB, OP_SLL, OP_SLT, OP_SLTU, OP_XOR, OP_SRL, OP_SRA, OP_OR, OP_AND,
+    OP_ADDIW, OP_SLLIW, OP_SRLIW, OP_SRAIW,
+    OP_ADDW, OP_SUBW, OP_SLLW, OP_SRLW, OP_SRAW,
+    OP_MUL, OP_MULH, OP_MULHSU, OP_MULHU, OP_DIV, OP_DIVU, OP_REM, OP_REMU,
+    OP_MULW, OP_DIVW, OP_DIVUW, OP_REMW, OP_REMUW,
+    OP_FENCE,
+    OP_LB, OP_LH, OP_LW, OP_LD, OP_LBU, OP_LHU, OP_LWU,
+    OP_SB, OP_SH, OP_SW, OP_SD,
+    OP_LR_W, OP_SC_W, OP_AMOSWAP_W, OP_AMOADD_W, OP_AMOXOR_W, OP_AMOAND_W, OP_AMOOR_W,
+    OP_AMOMIN_W, OP_AMOMAX_W, OP_AMOMINU_W, OP_AMOMAXU_W,
+    OP_LR_D, OP_SC_D, OP_AMOSWAP_D, OP_AMOADD_D, OP_AMOXOR_D, OP_AMOAND_D, OP_AMOOR_D,
+    OP_AMOMIN_D, OP_AMOMAX_D, OP_AMOMINU_D, OP_AMOMAXU_D,
+    OP_JAL, OP_JALR,
+    OP_BEQ, OP_BNE, OP_BLT, OP_BGE, OP_BLTU, OP_BGEU,
+);
+
+// A decoded instruction. imm is the sign-extended immediate of the
+// instruction's format, the shift amount for immediate shifts, or the
+// aq and rl bits for atomics, whose address is rs1 alone. An
+// unsupported instruction keeps its instruction word in imm.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub struct Insn {
+    pub op: u8,
+    pub rd: u8,
+    pub rs1: u8,
+    pub rs2: u8,
+    pub imm: i32,
+}
+
+// Decoding
+//
+// DECODE finds the op of an instruction with one table lookup instead
+// of matching on opcode, then funct3, then funct7. The index is opcode
+// bits 6:2, funct3, and a 2-bit class for the bits above: 0 = 0000000,
+// 1 = 0100000, 2 = 0000001 (M extension), 3 = anything else. For
+// immediate shifts on RV64 the class comes from funct6, since bit 25
+// is part of the shift amount.
+//
+// Atomics have too many funct5 values for a class, so they are found
+// in AMO_DECODE by funct5 instead, after checking funct3 for the width.
+//
+// FENCE is decoded by opcode and funct3 alone. Its fm, pred and succ
+// fields end up in imm and its reserved rd and rs1 in rd and rs1, but
+// nothing checks them, so fence.tso and a fence with reserved bits set
+// are plain fences like any other.
+
+const DECODE_LEN: usize = 1 << 10;
+
+// Matches any funct3 or class in OPS
+const ANY: u32 = 8;
+
+// funct7 of each class
+const CLASS_FUNCT7: [u32; 3] = [0b0000000, 0b0100000, 0b0000001];
+
+const fn decode_key(opcode: u32, funct3: u32, class: u32) -> usize {
+    (((opcode >> 2) << 5) | (funct3 << 2) | class) as usize
+}
+
+const fn is_shift(funct3: u32) -> bool {
+    funct3 == 0b001 || funct3 == 0b101
+}
+
+const fn decode_class(iw: u32, opcode: u32, funct3: u32) -> u32 {
+    let upper = match opcode {
+        OPC_OP | OPC_OP_32 => get_funct7(iw),
+        OPC_OP_IMM_32 if is_shift(funct3) => get_funct7(iw),
+        OPC_OP_IMM if is_shift(funct3) => (iw >> 26) << 1,
+        _ => return 0,
+    };
+    match upper {
+        0b0000000 => 0,
+        0b0100000 => 1,
+        0b0000001 => 2,
+        _ => 3,
+    }
+}
+
+// (opcode, funct3, class, op) for every supported instruction
+const OPS: &[(u32, u32, u32, u8)] = &[
+    (OPC_LUI, ANY, ANY, OP_LUI),
+    (OPC_AUIPC, ANY, ANY, OP_AUIPC),
+    (OPC_JAL, ANY, ANY, OP_JAL),
+    (OPC_JALR, 0b000, ANY, OP_JALR),
+    (OPC_BRANCH, 0b000, ANY, OP_BEQ),
+    (OPC_BRANCH, 0b001, ANY, OP_BNE),
+    (OPC_BRANCH, 0b100, ANY, OP_BLT),
+    (OPC_BRANCH, 0b101, ANY, OP_BGE),
+    (OPC_BRANCH, 0b110, ANY, OP_BLTU),
+    (OPC_BRANCH, 0b111, ANY, OP_BGEU),
+    (OPC_LOAD, 0b000, ANY, OP_LB),
+    (OPC_LOAD, 0b001, ANY, OP_LH),
+    (OPC_LOAD, 0b010, ANY, OP_LW),
+    (OPC_LOAD, 0b011, ANY, OP_LD),
+    (OPC_LOAD, 0b100, ANY, OP_LBU),
+    (OPC_LOAD, 0b101, ANY, OP_LHU),
+    (OPC_LOAD, 0b110, ANY, OP_LWU),
+    (OPC_STORE, 0b000, ANY, OP_SB),
+    (OPC_STORE, 0b001, ANY, OP_SH),
+    (OPC_STORE, 0b010, ANY, OP_SW),
+    (OPC_STORE, 0b011, ANY, OP_SD),
+    (OPC_MISC_MEM, 0b000, ANY, OP_FENCE),
+    (OPC_OP_IMM, 0b000, ANY, OP_ADDI),
+    (OPC_OP_IMM, 0b010, ANY, OP_SLTI),
+    (OPC_OP_IMM, 0b011, ANY, OP_SLTIU),
+    (OPC_OP_IMM, 0b100, ANY, OP_XORI),
+    (OPC_OP_IMM, 0b110, ANY, OP_ORI),
+    (OPC_OP_IMM, 0b111, ANY, OP_ANDI),
+    (OPC_OP_IMM, 0b001, 0, OP_SLLI),
+    (OPC_OP_IMM, 0b101, 0, OP_SRLI),
+    (OPC_OP_IMM, 0b101, 1, OP_SRAI),
+    (OPC_OP, 0b000, 0, OP_ADD),
+    (OPC_OP, 0b000, 1, OP_SUB),
+    (OPC_OP, 0b001, 0, OP_SLL),
+    (OPC_OP, 0b010, 0, OP_SLT),
+    (OPC_OP, 0b011, 0, OP_SLTU),
+    (OPC_OP, 0b100, 0, OP_XOR),
+    (OPC_OP, 0b101, 0, OP_SRL),
+    (OPC_OP, 0b101, 1, OP_SRA),
+    (OPC_OP, 0b110, 0, OP_OR),
+    (OPC_OP, 0b111, 0, OP_AND),
+    (OPC_OP, 0b000, 2, OP_MUL),
+    (OPC_OP, 0b001, 2, OP_MULH),
+    (OPC_OP, 0b010, 2, OP_MULHSU),
+    (OPC_OP, 0b011, 2, OP_MULHU),
+    (OPC_OP, 0b100, 2, OP_DIV),
+    (OPC_OP, 0b101, 2, OP_DIVU),
+    (OPC_OP, 0b110, 2, OP_REM),
+    (OPC_OP, 0b111, 2, OP_REMU),
+    (OPC_OP_IMM_32, 0b000, ANY, OP_ADDIW),
+    (OPC_OP_IMM_32, 0b001, 0, OP_SLLIW),
+    (OPC_OP_IMM_32, 0b101, 0, OP_SRLIW),
+    (OPC_OP_IMM_32, 0b101, 1, OP_SRAIW),
+    (OPC_OP_32, 0b000, 0, OP_ADDW),
+    (OPC_OP_32, 0b000, 1, OP_SUBW),
+    (OPC_OP_32, 0b001, 0, OP_SLLW),
+    (OPC_OP_32, 0b101, 0, OP_SRLW),
+    (OPC_OP_32, 0b101, 1, OP_SRAW),
+    (OPC_OP_32, 0b000, 2, OP_MULW),
+    (OPC_OP_32, 0b100, 2, OP_DIVW),
+    (OPC_OP_32, 0b101, 2, OP_DIVUW),
+    (OPC_OP_32, 0b110, 2, OP_REMW),
+    (OPC_OP_32, 0b111, 2, OP_REMUW),
+];
+
+// (funct5, op) for every .W atomic. Each .D op is its .W op + AMO_D.
+const AMO_OPS: &[(u32, u8)] = &[
+    (0b00010, OP_LR_W),
+    (0b00011, OP_SC_W),
+    (0b00001, OP_AMOSWAP_W),
+    (0b00000, OP_AMOADD_W),
+    (0b00100, OP_AMOXOR_W),
+    (0b01100, OP_AMOAND_W),
+    (0b01000, OP_AMOOR_W),
+    (0b10000, OP_AMOMIN_W),
+    (0b10100, OP_AMOMAX_W),
+    (0b11000, OP_AMOMINU_W),
+    (0b11100, OP_AMOMAXU_W),
+];
+
+pub const AMO_D: u8 = OP_LR_D - OP_LR_W;
+
+const AMO_FUNCT3_W: u32 = 0b010;
+const AMO_FUNCT3_D: u32 = 0b011;
+
+// The .W op of each funct5
+static AMO_DECODE: [u8; 32] = {
+    let mut t = [OP_UNSUPPORTED; 32];
+    let mut i = 0;
+
+    while i < AMO_OPS.len() {
+        t[AMO_OPS[i].0 as usize] = AMO_OPS[i].1;
+        i += 1;
+    }
+    t
+};
+
+static DECODE: [u8; DECODE_LEN] = {
+    let mut t = [OP_UNSUPPORTED; DECODE_LEN];
+    let mut i = 0;
+
+    while i < OPS.len() {
+        let (opcode, funct3, class, op) = OPS[i];
+        let mut f3 = 0;
+        while f3 < 8 {
+            let mut c = 0;
+            while c < 4 {
+                if (funct3 == ANY || funct3 == f3) && (class == ANY || class == c) {
+                    t[decode_key(opcode, f3, c)] = op;
+                }
+                c += 1;
+            }
+            f3 += 1;
+        }
+        i += 1;
+    }
+    t
+};
+
+// (opcode, funct3, funct7) of every op, the same table run backwards.
+// Fields OPS leaves open are 0.
+const ENCODE: [(u32, u32, u32); OP_COUNT] = {
+    let mut t = [(0, 0, 0); OP_COUNT];
+    let mut i = 0;
+
+    while i < OPS.len() {
+        let (opcode, funct3, class, op) = OPS[i];
+        let funct3 = if funct3 == ANY { 0 } else { funct3 };
+        let funct7 = if class == ANY { 0 } else { CLASS_FUNCT7[class as usize] };
+        t[op as usize] = (opcode, funct3, funct7);
+        i += 1;
+    }
+
+    // Atomics are R-type with funct5 and aq = rl = 0 as funct7
+    i = 0;
+    while i < AMO_OPS.len() {
+        let (funct5, op) = AMO_OPS[i];
+        t[op as usize] = (OPC_AMO, AMO_FUNCT3_W, funct5 << 2);
+        t[(op + AMO_D) as usize] = (OPC_AMO, AMO_FUNCT3_D, funct5 << 2);
+        i += 1;
+    }
+    t
+};
+
+pub const fn is_amo(op: u8) -> bool {
+    op >= OP_LR_W && op <= OP_AMOMAXU_D
+}
+
+const fn decode_amo(iw: u32) -> u8 {
+    let op = AMO_DECODE[get_funct5(iw) as usize];
+    let d = match get_funct3(iw) {
+        AMO_FUNCT3_W => 0,
+        AMO_FUNCT3_D => AMO_D,
+        _ => return OP_UNSUPPORTED,
+    };
+
+    // lr has no rs2
+    if op == OP_UNSUPPORTED || (op == OP_LR_W && get_rs2(iw) != 0) {
+        return OP_UNSUPPORTED;
+    }
+    op + d
+}
+
+// Just the op of iw
+pub const fn decode_op(iw: u32) -> u8 {
+    let opcode = get_opcode(iw);
+    let funct3 = get_funct3(iw);
+
+    // Compressed (16-bit) encodings do not end in 0b11
+    if opcode & 0b11 != 0b11 {
+        return OP_UNSUPPORTED;
+    }
+    if opcode == OPC_AMO {
+        return decode_amo(iw);
+    }
+    DECODE[decode_key(opcode, funct3, decode_class(iw, opcode, funct3))]
+}
+
+pub const fn decode(iw: u32) -> Insn {
+    let op = decode_op(iw);
+    let opcode = get_opcode(iw);
+    let shift = is_shift(get_funct3(iw));
+
+    let imm = match opcode {
+        _ if op == OP_UNSUPPORTED => iw as i32,
+        OPC_STORE => get_imm_s(iw),
+        OPC_BRANCH => get_imm_b(iw),
+        OPC_LUI | OPC_AUIPC => get_imm_u(iw),
+        OPC_JAL => get_imm_j(iw),
+        OPC_AMO => get_aqrl(iw) as i32,
+        OPC_OP_IMM if shift => ((iw >> 20) & 0x3f) as i32,
+        OPC_OP_IMM_32 if shift => ((iw >> 20) & 0x1f) as i32,
+        _ => get_imm_i(iw),
+    };
+
+    Insn {
+        op,
+        rd: get_rd(iw) as u8,
+        rs1: get_rs1(iw) as u8,
+        rs2: get_rs2(iw) as u8,
+        imm,
+    }
+}
+
+// The instruction word of insn. Registers a format does not have are
+// ignored, so encode(decode(iw)) == iw for any supported iw.
+pub const fn encode(insn: &Insn) -> u32 {
+    if insn.op == OP_UNSUPPORTED {
+        return insn.imm as u32;
+    }
+
+    let (opcode, funct3, funct7) = ENCODE[insn.op as usize];
+    let (rd, rs1, rs2, imm) = (insn.rd as u32, insn.rs1 as u32, insn.rs2 as u32, insn.imm);
+
+    match opcode {
+        OPC_OP | OPC_OP_32 => encode_r(opcode, funct3, funct7, rd, rs1, rs2),
+        OPC_AMO => encode_r(opcode, funct3, funct7 | (imm as u32 & 0x3), rd, rs1, rs2),
+        OPC_OP_IMM if is_shift(funct3) => {
+            encode_i(opcode, funct3, rd, rs1, (imm & 0x3f) | (funct7 << 5) as i32)
+        }
+        OPC_OP_IMM_32 if is_shift(funct3) => {
+            encode_i(opcode, funct3, rd, rs1, (imm & 0x1f) | (funct7 << 5) as i32)
+        }
+        OPC_STORE => encode_s(opcode, funct3, rs1, rs2, imm),
+        OPC_BRANCH => encode_b(opcode, funct3, rs1, rs2, imm),
+        OPC_LUI | OPC_AUIPC => encode_u(opcode, rd, imm),
+        OPC_JAL => encode_j(opcode, rd, imm),
+        _ => encode_i(opcode, funct3, rd, rs1, imm),
+    }
+}
+
+// Shorthands for building instructions to encode
+
+pub const fn insn_r(op: u8, rd: u32, rs1: u32, rs2: u32) -> Insn {
+    Insn { op, rd: rd as u8, rs1: rs1 as u8, rs2: rs2 as u8, imm: 0 }
+}
+
+pub const fn insn_i(op: u8, rd: u32, rs1: u32, imm: i32) -> Insn {
+    Insn { op, rd: rd as u8, rs1: rs1 as u8, rs2: 0, imm }
+}
+
+// For stores and branches
+pub const fn insn_s(op: u8, rs1: u32, rs2: u32, imm: i32) -> Insn {
+    Insn { op, rd: 0, rs1: rs1 as u8, rs2: rs2 as u8, imm }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // (instruction word, instruction) pairs, the words from llvm-mc
+    const KNOWN: &[(u32, Insn)] = &[
+        (0xfff58513, insn_i(OP_ADDI, 10, 11, -1)),           // addi a0, a1, -1
+        (0x123452b7, insn_i(OP_LUI, 5, 0, 0x12345000)),      // lui t0, 0x12345
+        (0x00001097, insn_i(OP_AUIPC, 1, 0, 0x1000)),        // auipc ra, 1
+        (0xff9ff0ef, insn_i(OP_JAL, 1, 0, -8)),              // jal ra, -8
+        (0x00008067, insn_i(OP_JALR, 0, 1, 0)),              // jalr zero, 0(ra)
+        (0x00b50863, insn_s(OP_BEQ, 10, 11, 16)),            // beq a0, a1, 16
+        (0xfe62fee3, insn_s(OP_BGEU, 5, 6, -4)),             // bgeu t0, t1, -4
+        (0x00813503, insn_i(OP_LD, 10, 2, 8)),               // ld a0, 8(sp)
+        (0xfff54303, insn_i(OP_LBU, 6, 10, -1)),             // lbu t1, -1(a0)
+        (0xfe113823, insn_s(OP_SD, 2, 1, -16)),              // sd ra, -16(sp)
+        (0x7eb52fa3, insn_s(OP_SW, 10, 11, 2047)),           // sw a1, 2047(a0)
+        (0x03f51513, insn_i(OP_SLLI, 10, 10, 63)),           // slli a0, a0, 63
+        (0x40365593, insn_i(OP_SRAI, 11, 12, 3)),            // srai a1, a2, 3
+        (0x41f6559b, insn_i(OP_SRAIW, 11, 12, 31)),          // sraiw a1, a2, 31
+        (0x40c58533, insn_r(OP_SUB, 10, 11, 12)),            // sub a0, a1, a2
+        (0x407352bb, insn_r(OP_SRAW, 5, 6, 7)),              // sraw t0, t1, t2
+        (0x02c58533, insn_r(OP_MUL, 10, 11, 12)),            // mul a0, a1, a2
+        (0x02c5a533, insn_r(OP_MULHSU, 10, 11, 12)),         // mulhsu a0, a1, a2
+        (0x027352b3, insn_r(OP_DIVU, 5, 6, 7)),              // divu t0, t1, t2
+        (0x02b5653b, insn_r(OP_REMW, 10, 10, 11)),           // remw a0, a0, a1
+        (0x02f756bb, insn_r(OP_DIVUW, 13, 14, 15)),          // divuw a3, a4, a5
+        (0x0ff0000f, insn_i(OP_FENCE, 0, 0, 0x0ff)),         // fence
+        (0x0330000f, insn_i(OP_FENCE, 0, 0, 0x033)),         // fence rw, rw
+        (0x8330000f, insn_i(OP_FENCE, 0, 0, 0x833 - 0x1000)), // fence.tso
+        (0x1005a52f, insn_r(OP_LR_W, 10, 11, 0)),            // lr.w a0, (a1)
+        (0x1ad5a62f, Insn { imm: 1, ..insn_r(OP_SC_W, 12, 11, 13) }), // sc.w.rl a2, a3, (a1)
+        (0x00b6252f, insn_r(OP_AMOADD_W, 10, 12, 11)),       // amoadd.w a0, a1, (a2)
+        (0x0eb6352f, Insn { imm: 3, ..insn_r(OP_AMOSWAP_D, 10, 12, 11) }), // amoswap.d.aqrl
+        (0xe463b2af, Insn { imm: 2, ..insn_r(OP_AMOMAXU_D, 5, 7, 6) }), // amomaxu.d.aq
+        (0x1405352f, Insn { imm: 2, ..insn_r(OP_LR_D, 10, 10, 0) }), // lr.d.aq a0, (a0)
+    ];
+
+    #[test]
+    fn known_encodings() {
+        for &(iw, insn) in KNOWN {
+            let name = OP_NAMES[insn.op as usize];
+            let d = decode(iw);
+
+            assert_eq!(encode(&insn), iw, "encode {}", name);
+            assert_eq!(d.op, insn.op, "decode {:#010x}", iw);
+
+            // R-type has no immediate, so imm is whatever is in its place
+            if !matches!(get_opcode(iw), OPC_OP | OPC_OP_32) {
+                assert_eq!(d.imm, insn.imm, "decode {}", name);
+            }
+        }
+    }
+
+    #[test]
+    fn unsupported() {
+        // c.nop, ecall, lr.w with rs2 set, amoadd.h, a load with funct3 7
+        for iw in [0x0001, 0x00000073, 0x1015a52f, 0x00b6152f, 0x0000f003] {
+            let d = decode(iw);
+
+            assert_eq!(d.op, OP_UNSUPPORTED, "{:#010x}", iw);
+            assert_eq!(encode(&d), iw);
+        }
+    }
+
+    // encode(decode(iw)) == iw over many words, mostly with a major
+    // opcode that has supported instructions so most of them decode
+    #[test]
+    fn round_trip() {
+        const OPCODES: [u32; 13] = [
+            OPC_LOAD, OPC_MISC_MEM, OPC_OP_IMM, OPC_AUIPC, OPC_OP_IMM_32, OPC_STORE, OPC_AMO,
+            OPC_OP, OPC_LUI, OPC_OP_32, OPC_BRANCH, OPC_JALR, OPC_JAL,
+        ];
+        let mut seen = [false; OP_COUNT];
+        let mut x: u64 = 1;
+
+        for i in 0..1_000_000u32 {
+            x = x.wrapping_mul(6364136223846793005).wrapping_add(1442695040888963407);
+            let mut iw = (x >> 32) as u32;
+            if i % 8 != 0 {
+                iw = (iw & !0x7f) | OPCODES[i as usize % OPCODES.len()];
+            }
+            let d = decode(iw);
+
+            seen[d.op as usize] = true;
+            assert_eq!(encode(&d), iw, "{:#010x} ({})", iw, OP_NAMES[d.op as usize]);
+        }
+        for op in 0..OP_COUNT {
+            assert!(seen[op], "never decoded {}", OP_NAMES[op]);
+        }
+    }
+}
@@ -0,0 +1,220 @@
+// bench - time the Rust reference, the native assembly and the rv_emu
+// run of the same kernels over a range of input sizes.
+//
+// usage: bench [kernel]
+//
+// For each kernel and input size this prints ns/call for each of the
+// three, the instructions rv_emu retires per call, and how many times
+// slower the emulated call is than the native one.
+
+use std::ffi::CString;
+use std::hint::black_box;
+
+use week09::rv_emu::{rv_emulate, rv_emulate_with, rv_init, RvCount, RvState};
+use week09::timing::time_ns;
+
+unsafe extern "C" {
+    fn add2_s(a0: i32, a1: i32) -> i32;
+    fn sumarr_idx_s(arr: *const i32, len: i32) -> i32;
+    fn sumarr_ptr_s(arr: *const i32, len: i32) -> i32;
+    fn factrec_s(n: i32) -> i32;
+    fn strlen_s(s: *const u8) -> usize;
+    fn strlen_word_s(s: *const u8) -> usize;
+    fn get_bitseq_s(num: u32, start: u32, end: u32) -> u32;
+}
+
+#[inline(never)]
+fn add2(a: i32, b: i32) -> i32 {
+    a + b
+}
+
+#[inline(never)]
+fn sumarr(arr: &[i32]) -> i32 {
+    let mut sum = 0;
+    for &v in arr {
+        sum += v;
+    }
+    sum
+}
+
+#[inline(never)]
+fn factrec(n: i32) -> i32 {
+    if n <= 0 { 1 } else { n * factrec(n - 1) }
+}
+
+#[inline(never)]
+fn strlen_c(s: &[u8]) -> usize {
+    s.iter().position(|&b| b == 0).unwrap_or(s.len())
+}
+
+#[inline(never)]
+fn get_bitseq(num: u32, start: u32, end: u32) -> u32 {
+    let shifted = num >> start;
+    let mask = (1u32 << (end - start + 1)) - 1;
+    shifted & mask
+}
+
+// One kernel call: its Rust and native versions, and the entry point,
+// arguments and input data (address, bytes) rv_emu runs with. Results
+// are compared after mask.
+struct Case<'a> {
+    name: &'static str,
+    n: usize,
+    rust: Box<dyn Fn() -> u64 + 'a>,
+    native: Box<dyn Fn() -> u64 + 'a>,
+    target: *const u32,
+    args: [u64; 4],
+    data: (u64, u64),
+    mask: u64,
+}
+
+fn emulate(state: &mut RvState, c: &Case) -> u64 {
+    let a = c.args;
+    rv_init(state, c.target, a[0], a[1], a[2], a[3]);
+    rv_emulate(state)
+}
+
+fn run_case(state: &mut RvState, c: &Case) {
+    state.mem.unmap_all();
+    state.mem.map_raw(c.data.0, c.data.1, false);
+
+    let want = (c.rust)() & c.mask;
+    let native = (c.native)() & c.mask;
+    let emu = emulate(state, c) & c.mask;
+    if native != want || emu != want {
+        println!(
+            "{:<14} {:>7}  MISMATCH: rust = {}, asm = {}, emu = {}",
+            c.name, c.n, want, native, emu
+        );
+        return;
+    }
+
+    let mut count = RvCount { retired: 0 };
+    let a = c.args;
+    rv_init(state, c.target, a[0], a[1], a[2], a[3]);
+    rv_emulate_with(state, &mut count);
+
+    let rust_ns = time_ns(|| (c.rust)());
+    let native_ns = time_ns(|| (c.native)());
+    let emu_ns = time_ns(|| emulate(state, c));
+
+    println!(
+        "{:<14} {:>7} {:>12.1} {:>12.1} {:>12.1} {:>10} {:>9.1}x",
+        c.name,
+        c.n,
+        rust_ns,
+        native_ns,
+        emu_ns,
+        count.retired,
+        emu_ns / native_ns
+    );
+}
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let filter = args.get(1).map(|s| s.as_str()).unwrap_or("");
+
+    // Inputs, which the cases borrow
+    let sizes = [16, 256, 4096, 65536];
+    let arrs: Vec<Vec<i32>> = sizes.iter().map(|&n| (0..n as i32).collect()).collect();
+    let strs: Vec<CString> = sizes.iter().map(|&n| CString::new("x".repeat(n)).unwrap()).collect();
+
+    // The block cache stays warm across calls, as it would in a long run
+    let mut state = RvState::new();
+    let mut cases: Vec<Case> = Vec::new();
+
+    cases.push(Case {
+        name: "add2_s",
+        n: 1,
+        rust: Box::new(|| add2(black_box(3), black_box(4)) as u64),
+        native: Box::new(|| unsafe { add2_s(black_box(3), black_box(4)) } as u64),
+        target: add2_s as *const u32,
+        args: [3, 4, 0, 0],
+        data: (0, 0),
+        mask: u32::MAX as u64,
+    });
+
+    cases.push(Case {
+        name: "get_bitseq_s",
+        n: 1,
+        rust: Box::new(|| get_bitseq(black_box(552), 3, 5) as u64),
+        native: Box::new(|| unsafe { get_bitseq_s(black_box(552), 3, 5) } as u64),
+        target: get_bitseq_s as *const u32,
+        args: [552, 3, 5, 0],
+        data: (0, 0),
+        mask: u32::MAX as u64,
+    });
+
+    for n in [1, 6, 12] {
+        cases.push(Case {
+            name: "factrec_s",
+            n: n as usize,
+            rust: Box::new(move || factrec(black_box(n)) as u64),
+            native: Box::new(move || unsafe { factrec_s(black_box(n)) } as u64),
+            target: factrec_s as *const u32,
+            args: [n as u64, 0, 0, 0],
+            data: (0, 0),
+            mask: u32::MAX as u64,
+        });
+    }
+
+    for a in arrs.iter() {
+        let len = a.len() as i32;
+        cases.push(Case {
+            name: "sumarr_idx_s",
+            n: a.len(),
+            rust: Box::new(move || sumarr(black_box(a)) as u64),
+            native: Box::new(move || unsafe { sumarr_idx_s(black_box(a.as_ptr()), len) } as u64),
+            target: sumarr_idx_s as *const u32,
+            args: [a.as_ptr() as u64, a.len() as u64, 0, 0],
+            data: (a.as_ptr() as u64, size_of_val(a.as_slice()) as u64),
+            mask: u32::MAX as u64,
+        });
+        cases.push(Case {
+            name: "sumarr_ptr_s",
+            n: a.len(),
+            rust: Box::new(move || sumarr(black_box(a)) as u64),
+            native: Box::new(move || unsafe { sumarr_ptr_s(black_box(a.as_ptr()), len) } as u64),
+            target: sumarr_ptr_s as *const u32,
+            args: [a.as_ptr() as u64, a.len() as u64, 0, 0],
+            data: (a.as_ptr() as u64, size_of_val(a.as_slice()) as u64),
+            mask: u32::MAX as u64,
+        });
+    }
+
+    for s in strs.iter() {
+        let p = s.as_ptr() as *const u8;
+        cases.push(Case {
+            name: "strlen_s",
+            n: s.as_bytes().len(),
+            rust: Box::new(move || strlen_c(black_box(s.as_bytes_with_nul())) as u64),
+            native: Box::new(move || unsafe { strlen_s(black_box(p)) } as u64),
+            target: strlen_s as *const u32,
+            args: [p as u64, 0, 0, 0],
+            data: (p as u64, s.as_bytes_with_nul().len() as u64),
+            mask: u64::MAX,
+        });
+        // strlen_word_s loads the whole aligned word holding the
+        // terminator. malloc never splits a word, so the bytes past it
+        // are readable on the host too.
+        let word_end = (p as u64 + s.as_bytes_with_nul().len() as u64 + 7) & !7;
+        cases.push(Case {
+            name: "strlen_word_s",
+            n: s.as_bytes().len(),
+            rust: Box::new(move || strlen_c(black_box(s.as_bytes_with_nul())) as u64),
+            native: Box::new(move || unsafe { strlen_word_s(black_box(p)) } as u64),
+            target: strlen_word_s as *const u32,
+            args: [p as u64, 0, 0, 0],
+            data: (p as u64, word_end - p as u64),
+            mask: u64::MAX,
+        });
+    }
+
+    println!(
+        "{:<14} {:>7} {:>12} {:>12} {:>12} {:>10} {:>10}",
+        "kernel", "n", "rust ns", "asm ns", "emu ns", "emu insns", "emu/asm"
+    );
+    for c in cases.iter().filter(|c| c.name.contains(filter)) {
+        run_case(&mut state, c);
+    }
+}
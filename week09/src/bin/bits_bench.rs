@@ -0,0 +1,60 @@
+// bits_bench - compare get_bits() and sign_extend() with their slice
+// versions
+//
+// usage: bits_bench [n]
+//
+// Runs each over n values (default 64K), checks that the scalar and
+// slice versions agree, and prints ns per value and the speedup. The
+// scalar side makes one call per value, as the decoder does.
+
+use std::hint::black_box;
+
+use week09::bits::{get_bits, get_bits_into, get_bits_slice, sign_extend, sign_extend_into, sign_extend_slice};
+use week09::timing::{report, report_header, time_ns_per, xorshift_input};
+
+// Width of the helper name column
+const WIDTH: usize = 12;
+
+fn main() {
+    let args: Vec<String> = std::env::args().collect();
+    let n: usize = args.get(1).and_then(|s| s.parse().ok()).unwrap_or(1 << 16);
+
+    let nums = xorshift_input(n);
+
+    // The I-type immediate field
+    let (start, count) = (20, 12);
+    let mut fields = vec![0u32; n];
+    let mut extended = vec![0i64; n];
+
+    report_header(WIDTH);
+
+    let f = black_box(get_bits as fn(u64, u32, u32) -> u32);
+    let want: Vec<u32> = nums.iter().map(|&v| f(v, start, count)).collect();
+    assert!(get_bits_slice(&nums, start, count) == want, "get_bits_slice differs");
+    let scalar = time_ns_per(n, || {
+        for (o, &v) in fields.iter_mut().zip(nums.iter()) {
+            *o = f(v, start, count);
+        }
+        black_box(&fields);
+    });
+    let slice = time_ns_per(n, || {
+        get_bits_into(black_box(&nums), start, count, &mut fields);
+        black_box(&fields);
+    });
+    report(WIDTH, "get_bits", scalar, slice);
+
+    let f = black_box(sign_extend as fn(u64, u32) -> i64);
+    let want: Vec<i64> = nums.iter().map(|&v| f(v, count)).collect();
+    assert!(sign_extend_slice(&nums, count) == want, "sign_extend_slice differs");
+    let scalar = time_ns_per(n, || {
+        for (o, &v) in extended.iter_mut().zip(nums.iter()) {
+            *o = f(v, count);
+        }
+        black_box(&extended);
+    });
+    let slice = time_ns_per(n, || {
+        sign_extend_into(black_box(&nums), count, &mut extended);
+        black_box(&extended);
+    });
+    report(WIDTH, "sign_extend", scalar, slice);
+}
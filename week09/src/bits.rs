@@ -8,3 +8,39 @@ pub fn sign_extend(num: u64, start: u32) -> i64 {
     let shifted = (num << dist) as i64;
     shifted >> dist
 }
+
+// Slice versions for decoding many values at once. The shifts and mask
+// are set up once, so the loops have no branches and vectorize. out
+// must be exactly as long as nums.
+
+// out[i] = get_bits(nums[i], start, count)
+pub fn get_bits_into(nums: &[u64], start: u32, count: u32, out: &mut [u32]) {
+    assert_eq!(out.len(), nums.len(), "get_bits: out and nums differ in length");
+
+    let mask: u64 = (1u64 << count) - 1;
+    for (o, &n) in out.iter_mut().zip(nums.iter()) {
+        *o = ((n >> start) & mask) as u32;
+    }
+}
+
+pub fn get_bits_slice(nums: &[u64], start: u32, count: u32) -> Vec<u32> {
+    let mut out = vec![0; nums.len()];
+    get_bits_into(nums, start, count, &mut out);
+    out
+}
+
+// out[i] = sign_extend(nums[i], start)
+pub fn sign_extend_into(nums: &[u64], start: u32, out: &mut [i64]) {
+    assert_eq!(out.len(), nums.len(), "sign_extend: out and nums differ in length");
+
+    let dist = 64 - start;
+    for (o, &n) in out.iter_mut().zip(nums.iter()) {
+        *o = ((n << dist) as i64) >> dist;
+    }
+}
+
+pub fn sign_extend_slice(nums: &[u64], start: u32) -> Vec<i64> {
+    let mut out = vec![0; nums.len()];
+    sign_extend_into(nums, start, &mut out);
+    out
+}
@@ -0,0 +1,9 @@
+pub mod bits;
+pub mod rv_batch;
+pub mod rv_emu;
+pub mod rv_hart;
+pub mod rv_mem;
+
+// Shared with the week07 examples and project02
+#[path = "../../week07/examples/src/timing.rs"]
+pub mod timing;
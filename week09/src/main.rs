@@ -1,10 +1,20 @@
-mod bits;
-mod rv_emu;
+use std::time::Instant;
 
-use rv_emu::{rv_emulate, rv_init, RvState};
+use rvisa::{get_funct3, get_funct7, get_opcode, get_rd, get_rs1, get_rs2};
+use week09::rv_batch::{rv_default_threads, rv_run_batches, RvBatch};
+use week09::rv_emu;
+use week09::rv_emu::{
+    rv_emulate, rv_emulate_uncached, rv_emulate_with, rv_init, RvCache, RvCacheConfig, RvProfile,
+    RvReplace, RvState,
+};
+use week09::rv_hart::rv_run_harts;
 
 unsafe extern "C" {
     fn add2_s(a0: i32, a1: i32) -> i32;
+    fn sumarr_idx_s(arr: *const i32, len: i32) -> i32;
+    fn sumarr_ptr_s(arr: *const i32, len: i32) -> i32;
+    fn amo_count_s(counter: *mut i32, n: i32) -> i32;
+    fn lock_count_s(lock: *mut i32, counter: *mut i32, n: i32) -> i32;
 }
 
 fn decode() {
@@ -16,13 +26,13 @@ fn decode() {
     let iw = unsafe { *pc };
     println!("[pc = {:p}] iw = {:X}", pc, iw);
 
-    // Decode R-type fields
-    let opcode = iw & 0b1111111;
-    let funct3 = (iw >> 12) & 0b111;
-    let funct7 = (iw >> 25) & 0b1111111;
-    let rd     = (iw >> 7)  & 0b11111;
-    let rs1    = (iw >> 15) & 0b11111;
-    let rs2    = (iw >> 20) & 0b11111;
+    // Decode R-type fields, with the same getters rv_emu decodes with
+    let opcode = get_opcode(iw);
+    let funct3 = get_funct3(iw);
+    let funct7 = get_funct7(iw);
+    let rd = get_rd(iw);
+    let rs1 = get_rs1(iw);
+    let rs2 = get_rs2(iw);
 
     println!("opcode  = {}", opcode);
     println!("funct3  = {}", funct3);
@@ -53,8 +63,125 @@ fn emu_add2() {
 
     let mut state = RvState::new();
     rv_init(&mut state, add2_s as *const u32, 3, 4, 0, 0);
-    let r = rv_emulate(&mut state);
+    let r = rv_emulate_uncached(&mut state);
+    println!("Emu (uncached): add2_s(3, 4) = {}", r as i32);
+
+    // Run it a few times so the block cache is warm after the first call
+    for _ in 0..4 {
+        rv_init(&mut state, add2_s as *const u32, 3, 4, 0, 0);
+        rv_emulate(&mut state);
+    }
+    let r = state.regs[rv_emu::RV_A0];
     println!("Emu: add2_s(3, 4) = {}", r as i32);
+    let c = &state.bcache;
+    println!(
+        "block cache: {} instructions, chained = {}, hits = {}, translated = {}, hit rate = {:.1}%",
+        c.instructions(),
+        c.chained,
+        c.hits,
+        c.translated,
+        c.hit_rate() * 100.0
+    );
+}
+
+fn emu_profile() {
+    let mut state = RvState::new();
+    let mut prof = RvProfile::new(10);
+    rv_init(&mut state, add2_s as *const u32, 3, 4, 0, 0);
+    let r = rv_emulate_with(&mut state, &mut prof);
+    println!("Emu (profiled): add2_s(3, 4) = {}", r as i32);
+}
+
+fn emu_cache() {
+    let arr: Vec<i32> = (0..4096).collect();
+    let configs = [
+        RvCacheConfig { size: 4096, block: 64, ways: 1, replace: RvReplace::Lru },
+        RvCacheConfig { size: 4096, block: 64, ways: 4, replace: RvReplace::Lru },
+        RvCacheConfig { size: 4096, block: 64, ways: 64, replace: RvReplace::Fifo },
+    ];
+
+    for (name, f) in [
+        ("sumarr_idx_s", sumarr_idx_s as *const u32),
+        ("sumarr_ptr_s", sumarr_ptr_s as *const u32),
+    ] {
+        for config in configs {
+            let mut state = RvState::new();
+            let mut cache = RvCache::new(config).unwrap();
+            state.mem.map(&arr);
+            rv_init(&mut state, f, arr.as_ptr() as u64, arr.len() as u64, 0, 0);
+            let r = rv_emulate_with(&mut state, &mut cache);
+            println!("Emu: {}(arr, {}) = {}", name, arr.len(), r as i32);
+        }
+    }
+}
+
+fn emu_batch() {
+    // One batch per 1K-element chunk, each summed by both kernels
+    let arr: Vec<i32> = (0..16384).collect();
+    let batches: Vec<RvBatch> = arr
+        .chunks(1024)
+        .map(|chunk| {
+            let mut b = RvBatch::new();
+            b.map(chunk);
+            for f in [sumarr_idx_s as *const u32, sumarr_ptr_s as *const u32] {
+                b.push(f, [chunk.as_ptr() as u64, chunk.len() as u64, 0, 0]);
+            }
+            b
+        })
+        .collect();
+
+    let results = rv_run_batches(&batches, 0);
+    let total: i64 = results.iter().map(|r| r[0] as i32 as i64).sum();
+    let same = results.iter().all(|r| r[0] == r[1]);
+    let r = unsafe { sumarr_ptr_s(arr.as_ptr(), arr.len() as i32) };
+    println!(
+        "Emu: {} batches on {} threads, sum = {}, idx == ptr: {}",
+        batches.len(),
+        rv_default_threads().min(batches.len()),
+        total,
+        same
+    );
+    println!("Asm: sumarr_ptr_s(arr, {}) = {}", arr.len(), r);
+}
+
+fn emu_harts() {
+    // Every hart adds 1 to the same counter n times, so any lost update
+    // shows up in the total
+    let n: u64 = 100000;
+    let (mut lock, mut counter) = (0, 0);
+    unsafe {
+        amo_count_s(&mut counter, n as i32);
+        lock_count_s(&mut lock, &mut counter, n as i32);
+    }
+    println!("Asm: amo_count_s and lock_count_s, counter = {}", counter);
+
+    for harts in [1, 2, 4, 8] {
+        let mut shared = [0i32; 2]; // lock, counter
+        let lock = &mut shared[0] as *mut i32 as u64;
+        let counter = &mut shared[1] as *mut i32 as u64;
+        let mut amo = RvBatch::new();
+        amo.map_mut(&mut shared);
+        let mut locked = amo.clone();
+        for _ in 0..harts {
+            amo.push(amo_count_s as *const u32, [counter, n, 0, 0]);
+            locked.push(lock_count_s as *const u32, [lock, counter, n, 0]);
+        }
+
+        let t = Instant::now();
+        rv_run_harts(&amo);
+        let amo_ms = t.elapsed().as_secs_f64() * 1e3;
+        let amo_count = unsafe { (counter as *mut i32).replace(0) };
+
+        let t = Instant::now();
+        let sc_fails: u64 = rv_run_harts(&locked).iter().sum();
+        let lock_ms = t.elapsed().as_secs_f64() * 1e3;
+        let lock_count = unsafe { *(counter as *const i32) };
+
+        println!(
+            "Emu: {} harts x {}: amo_count_s = {} in {:.1} ms, lock_count_s = {} in {:.1} ms ({} sc.w failed)",
+            harts, n, amo_count, amo_ms, lock_count, lock_ms, sc_fails
+        );
+    }
 }
 
 fn main() {
@@ -70,4 +197,24 @@ fn main() {
 
     println!("== emu_add2 ==");
     emu_add2();
+
+    println!();
+
+    println!("== emu_profile ==");
+    emu_profile();
+
+    println!();
+
+    println!("== emu_cache ==");
+    emu_cache();
+
+    println!();
+
+    println!("== emu_batch ==");
+    emu_batch();
+
+    println!();
+
+    println!("== emu_harts ==");
+    emu_harts();
 }
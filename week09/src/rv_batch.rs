@@ -0,0 +1,109 @@
+// Running many guest calls
+//
+// rv_run_batch() runs a list of calls through one RvState, resetting
+// only the registers between them, so the block cache stays warm and
+// the stack is mapped once. rv_run_batches() spreads independent
+// batches over threads, each with its own RvState.
+
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::Mutex;
+use std::thread;
+
+use crate::rv_emu::{rv_emulate, rv_init, RvState};
+
+// One guest call: the function to run and a0-a3. target is a host
+// address so that jobs can be sent to other threads.
+#[derive(Clone, Copy)]
+pub struct RvJob {
+    pub target: u64,
+    pub args: [u64; 4],
+}
+
+impl RvJob {
+    pub fn new(target: *const u32, args: [u64; 4]) -> Self {
+        RvJob { target: target as u64, args }
+    }
+}
+
+// Jobs that run in order on one RvState, and the host memory (start,
+// bytes, writable) they use. The caller keeps that memory alive while
+// the batch runs, and batches run at the same time must not share
+// writable memory.
+#[derive(Clone, Default)]
+pub struct RvBatch {
+    pub jobs: Vec<RvJob>,
+    pub regions: Vec<(u64, u64, bool)>,
+}
+
+impl RvBatch {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn push(&mut self, target: *const u32, args: [u64; 4]) {
+        self.jobs.push(RvJob::new(target, args));
+    }
+
+    pub fn map<T>(&mut self, data: &[T]) {
+        self.regions.push((data.as_ptr() as u64, size_of_val(data) as u64, false));
+    }
+
+    pub fn map_mut<T>(&mut self, data: &mut [T]) {
+        self.regions.push((data.as_mut_ptr() as u64, size_of_val(data) as u64, true));
+    }
+
+    // Map the batch's regions, and only those, into state
+    pub fn map_into(&self, state: &mut RvState) {
+        state.mem.unmap_all();
+        for &(start, len, writable) in self.regions.iter() {
+            state.mem.map_raw(start, len, writable);
+        }
+    }
+}
+
+// Run every job in batch on state and return their a0 results in order
+pub fn rv_run_batch(state: &mut RvState, batch: &RvBatch) -> Vec<u64> {
+    batch.map_into(state);
+
+    let mut results = Vec::with_capacity(batch.jobs.len());
+    for job in batch.jobs.iter() {
+        let a = job.args;
+        state.reset();
+        rv_init(state, job.target as *const u32, a[0], a[1], a[2], a[3]);
+        results.push(rv_emulate(state));
+    }
+    results
+}
+
+// Number of threads rv_run_batches() uses for threads == 0
+pub fn rv_default_threads() -> usize {
+    thread::available_parallelism().map(|n| n.get()).unwrap_or(1)
+}
+
+// Run batches on up to threads threads (0 for one per core) and return
+// the results of each batch, in the order of batches. Each thread makes
+// one RvState and takes the next unclaimed batch until none are left,
+// so its block cache stays warm from one batch to the next.
+pub fn rv_run_batches(batches: &[RvBatch], threads: usize) -> Vec<Vec<u64>> {
+    let threads = if threads == 0 { rv_default_threads() } else { threads };
+    let threads = threads.min(batches.len()).max(1);
+    let next = AtomicUsize::new(0);
+    let results: Vec<Mutex<Vec<u64>>> = batches.iter().map(|_| Mutex::new(Vec::new())).collect();
+
+    thread::scope(|scope| {
+        for _ in 0..threads {
+            scope.spawn(|| {
+                let mut state = RvState::new();
+                loop {
+                    let i = next.fetch_add(1, Ordering::Relaxed);
+                    if i >= batches.len() {
+                        break;
+                    }
+                    *results[i].lock().unwrap() = rv_run_batch(&mut state, &batches[i]);
+                }
+            });
+        }
+    });
+
+    results.into_iter().map(|r| r.into_inner().unwrap()).collect()
+}
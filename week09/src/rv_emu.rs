@@ -1,4 +1,11 @@
-use crate::bits::{get_bits, sign_extend};
+use std::collections::HashMap;
+use std::sync::atomic::Ordering::{Relaxed, SeqCst};
+use std::sync::atomic::{
+    self, AtomicI16, AtomicI32, AtomicI64, AtomicI8, AtomicU16, AtomicU32, AtomicU64, AtomicU8,
+};
+
+use crate::rv_mem::{RvMemory, RV_STACK_SIZE};
+use rvisa::*;
 
 const RV_ZERO: usize = 0;
 const RV_RA: usize = 1;
@@ -9,26 +16,112 @@ pub const RV_A2: usize = 12;
 pub const RV_A3: usize = 13;
 const RV_NUM_REGS: usize = 32;
 
-const STACK_SIZE: usize = 8192;
+// Decoded instructions that write x0 write this extra register instead,
+// so x0 always reads as 0 without clearing it after every step.
+const RV_SINK: usize = RV_NUM_REGS;
+
+// Longest basic block we translate; longer runs are split
+const RV_BLOCK_MAX: usize = 64;
+const RV_NO_BLOCK: u32 = u32::MAX;
+
+// No lr reservation; misaligned, so no sc can match it
+const RV_NO_RESERVE: u64 = u64::MAX;
+
+// An instruction decoded once so it can be executed many times. This
+// is rvisa's Insn, with rd already mapped to RV_SINK for x0.
+pub type RvInsn = rvisa::Insn;
 
-const FMT_R: u32 = 0b0110011;
-const FMT_I_ARITH: u32 = 0b0010011;
-const FMT_I_JALR: u32 = 0b1100111;
+// A basic block: a straight run of decoded instructions ending in a
+// jump or branch (or after RV_BLOCK_MAX instructions). next caches the
+// blocks that execution went to from here, so most block exits go
+// straight to their successor without a lookup.
+#[derive(Clone, Copy)]
+struct RvBlock {
+    pc: u64,
+    start: u32, // first instruction in RvBlockCache::insns
+    len: u32,
+    ends_in_jump: bool,
+    next: [u32; 2],
+}
+
+// Translated blocks, found by the pc of their first instruction
+pub struct RvBlockCache {
+    blocks: Vec<RvBlock>,
+    insns: Vec<RvInsn>,
+    map: HashMap<u64, u32>,
+    pub chained: u64,    // block exits that followed a chain
+    pub hits: u64,       // block exits found in map
+    pub translated: u64, // block exits that needed a new block
+}
+
+impl RvBlockCache {
+    // Fraction of block exits that did not need translation
+    pub fn hit_rate(&self) -> f64 {
+        let exits = self.chained + self.hits + self.translated;
+        if exits == 0 {
+            0.0
+        } else {
+            (self.chained + self.hits) as f64 / exits as f64
+        }
+    }
+
+    pub fn instructions(&self) -> usize {
+        self.insns.len()
+    }
+}
 
+// One hart. Harts running at the same time (see rv_hart) each have
+// their own RvState, so nothing here is shared, not even the block
+// cache.
 pub struct RvState {
-    pub regs: [u64; RV_NUM_REGS],
+    pub regs: [u64; RV_NUM_REGS + 1],
     pub pc: *const u8,
-    pub stack: [u8; STACK_SIZE],
+    pub mem: RvMemory,
+    pub bcache: RvBlockCache,
+    handlers: &'static [RvHandler; OP_COUNT], // see set_shared()
+    reserve: u64,       // address of the last lr, or RV_NO_RESERVE
+    reserve_value: u64, // the value it loaded
 }
 
 impl RvState {
     pub fn new() -> Box<Self> {
+        Self::with_stack_size(RV_STACK_SIZE)
+    }
+
+    pub fn with_stack_size(stack_size: usize) -> Box<Self> {
         Box::new(RvState {
-            regs: [0; RV_NUM_REGS],
+            regs: [0; RV_NUM_REGS + 1],
             pc: std::ptr::null(),
-            stack: [0; STACK_SIZE],
+            mem: RvMemory::new(stack_size),
+            bcache: RvBlockCache {
+                blocks: Vec::new(),
+                insns: Vec::new(),
+                map: HashMap::new(),
+                chained: 0,
+                hits: 0,
+                translated: 0,
+            },
+            handlers: &RV_HANDLERS,
+            reserve: RV_NO_RESERVE,
+            reserve_value: 0,
         })
     }
+
+    // Say whether other harts may be using this hart's memory at the
+    // same time. If so, loads and stores become host atomics (see Loads
+    // and stores), which costs a little on every one of them.
+    pub fn set_shared(&mut self, shared: bool) {
+        self.handlers = if shared { &RV_HANDLERS_SHARED } else { &RV_HANDLERS };
+    }
+
+    // Get ready for another call: clear the registers but keep the
+    // block cache, the stack and the mapped regions. Stack contents are
+    // left as they are, as on real hardware.
+    pub fn reset(&mut self) {
+        self.regs = [0; RV_NUM_REGS + 1];
+        self.pc = std::ptr::null();
+        self.reserve = RV_NO_RESERVE;
+    }
 }
 
 fn unsupported(s: &str, n: u32) -> ! {
@@ -36,86 +129,566 @@ fn unsupported(s: &str, n: u32) -> ! {
     std::process::exit(-1);
 }
 
-fn get_rd(iw: u32) -> usize {
-    get_bits(iw as u64, 7, 5) as usize
+pub fn rv_decode(iw: u32) -> RvInsn {
+    let mut insn = rvisa::decode(iw);
+    if insn.rd as usize == RV_ZERO {
+        insn.rd = RV_SINK as u8;
+    }
+    insn
 }
 
-fn get_funct3(iw: u32) -> u32 {
-    get_bits(iw as u64, 12, 3)
+// Execution
+//
+// Handlers for straight-line instructions leave pc alone. Within a
+// block pc stays at the start of the block (AUIPC immediates are
+// adjusted for this when the block is translated), and the block runner
+// sets pc to a jump or branch at the end before running it, so it sees
+// its own pc and sets pc to its target.
+
+type RvHandler = fn(&mut RvState, &RvInsn);
+
+fn exec_unsupported(_s: &mut RvState, insn: &RvInsn) {
+    unsupported("instruction", insn.imm as u32);
 }
 
-fn get_funct7(iw: u32) -> u32 {
-    get_bits(iw as u64, 25, 7)
+// rd = e, with a = rs1 and b = rs2
+macro_rules! exec_rr {
+    ($name:ident, |$a:ident, $b:ident| $e:expr) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let $a = s.regs[insn.rs1 as usize];
+            let $b = s.regs[insn.rs2 as usize];
+            s.regs[insn.rd as usize] = $e;
+        }
+    };
 }
 
-fn get_rs1(iw: u32) -> usize {
-    get_bits(iw as u64, 15, 5) as usize
+// rd = e, with a = rs1 and i = the immediate
+macro_rules! exec_ri {
+    ($name:ident, |$a:ident, $i:ident| $e:expr) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let $a = s.regs[insn.rs1 as usize];
+            let $i = insn.imm as i64 as u64;
+            s.regs[insn.rd as usize] = $e;
+        }
+    };
 }
 
-fn get_rs2(iw: u32) -> usize {
-    get_bits(iw as u64, 20, 5) as usize
+// Loads and stores
+//
+// Each load and store has two handlers. The plain one is a host access
+// that may be misaligned. The $shared one is for harts whose memory
+// other harts use at the same time (see RvState::set_shared()): there
+// an aligned access is a Relaxed host atomic, so it is not a data race
+// with other harts' loads, stores and AMOs. A misaligned access cannot
+// be atomic and stays plain, so harts must not share data through
+// misaligned accesses, which RISC-V does not promise are atomic either.
+
+// rd = the $t at rs1 + imm, extended through $ext
+macro_rules! exec_load {
+    ($name:ident, $shared:ident, $t:ty, $atomic:ty, $ext:ty) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let addr = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64);
+            s.mem.check(addr, size_of::<$t>() as u64, false);
+            let v = unsafe { (addr as *const $t).read_unaligned() };
+            s.regs[insn.rd as usize] = v as $ext as u64;
+        }
+
+        fn $shared(s: &mut RvState, insn: &RvInsn) {
+            let addr = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64);
+            s.mem.check(addr, size_of::<$t>() as u64, false);
+            let v = if addr % size_of::<$t>() as u64 == 0 {
+                unsafe { <$atomic>::from_ptr(addr as *mut $t) }.load(Relaxed)
+            } else {
+                unsafe { (addr as *const $t).read_unaligned() }
+            };
+            s.regs[insn.rd as usize] = v as $ext as u64;
+        }
+    };
 }
 
-fn run_r_format(s: &mut RvState, iw: u32) {
-    let rd = get_rd(iw);
-    let funct3 = get_funct3(iw);
-    let funct7 = get_funct7(iw);
-    let rs1 = get_rs1(iw);
-    let rs2 = get_rs2(iw);
+// Store the low bits of rs2 as a $t at rs1 + imm
+macro_rules! exec_store {
+    ($name:ident, $shared:ident, $t:ty, $atomic:ty) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let addr = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64);
+            s.mem.check(addr, size_of::<$t>() as u64, true);
+            unsafe { (addr as *mut $t).write_unaligned(s.regs[insn.rs2 as usize] as $t) };
+        }
 
-    match (funct3, funct7) {
-        (0b000, 0b0000000) => {
-            // add
-            s.regs[rd] = s.regs[rs1].wrapping_add(s.regs[rs2]);
+        fn $shared(s: &mut RvState, insn: &RvInsn) {
+            let addr = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64);
+            let v = s.regs[insn.rs2 as usize] as $t;
+            s.mem.check(addr, size_of::<$t>() as u64, true);
+            if addr % size_of::<$t>() as u64 == 0 {
+                unsafe { <$atomic>::from_ptr(addr as *mut $t) }.store(v, Relaxed);
+            } else {
+                unsafe { (addr as *mut $t).write_unaligned(v) };
+            }
         }
-        _ => unsupported("R-type funct3", funct3),
-    }
+    };
+}
+
+// Go to pc + imm if e holds, with a = rs1 and b = rs2
+macro_rules! exec_branch {
+    ($name:ident, |$a:ident, $b:ident| $e:expr) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let $a = s.regs[insn.rs1 as usize];
+            let $b = s.regs[insn.rs2 as usize];
+            let off = if $e { insn.imm as i64 as u64 } else { 4 };
+            s.pc = (s.pc as u64).wrapping_add(off) as *const u8;
+        }
+    };
+}
+
+// Sign-extend a 32-bit result, for the *W instructions
+fn sext32(v: u64) -> u64 {
+    v as i32 as i64 as u64
+}
+
+// Other harts may be running, so a fence orders everything
+fn exec_fence(_s: &mut RvState, _insn: &RvInsn) {
+    atomic::fence(SeqCst);
+}
+
+fn exec_lui(s: &mut RvState, insn: &RvInsn) {
+    s.regs[insn.rd as usize] = insn.imm as i64 as u64;
+}
+
+fn exec_auipc(s: &mut RvState, insn: &RvInsn) {
+    s.regs[insn.rd as usize] = (s.pc as u64).wrapping_add(insn.imm as i64 as u64);
+}
+
+exec_ri!(exec_addi, |a, i| a.wrapping_add(i));
+exec_ri!(exec_slti, |a, i| ((a as i64) < (i as i64)) as u64);
+exec_ri!(exec_sltiu, |a, i| (a < i) as u64);
+exec_ri!(exec_xori, |a, i| a ^ i);
+exec_ri!(exec_ori, |a, i| a | i);
+exec_ri!(exec_andi, |a, i| a & i);
+exec_ri!(exec_slli, |a, i| a << i);
+exec_ri!(exec_srli, |a, i| a >> i);
+exec_ri!(exec_srai, |a, i| ((a as i64) >> i) as u64);
+
+exec_rr!(exec_add, |a, b| a.wrapping_add(b));
+exec_rr!(exec_sub, |a, b| a.wrapping_sub(b));
+exec_rr!(exec_sll, |a, b| a << (b & 63));
+exec_rr!(exec_slt, |a, b| ((a as i64) < (b as i64)) as u64);
+exec_rr!(exec_sltu, |a, b| (a < b) as u64);
+exec_rr!(exec_xor, |a, b| a ^ b);
+exec_rr!(exec_srl, |a, b| a >> (b & 63));
+exec_rr!(exec_sra, |a, b| ((a as i64) >> (b & 63)) as u64);
+exec_rr!(exec_or, |a, b| a | b);
+exec_rr!(exec_and, |a, b| a & b);
+
+exec_ri!(exec_addiw, |a, i| sext32(a.wrapping_add(i)));
+exec_ri!(exec_slliw, |a, i| sext32(((a as u32) << i) as u64));
+exec_ri!(exec_srliw, |a, i| sext32(((a as u32) >> i) as u64));
+exec_ri!(exec_sraiw, |a, i| ((a as i32) >> i) as i64 as u64);
+
+exec_rr!(exec_addw, |a, b| sext32(a.wrapping_add(b)));
+exec_rr!(exec_subw, |a, b| sext32(a.wrapping_sub(b)));
+exec_rr!(exec_sllw, |a, b| sext32(((a as u32) << (b & 31)) as u64));
+exec_rr!(exec_srlw, |a, b| sext32(((a as u32) >> (b & 31)) as u64));
+exec_rr!(exec_sraw, |a, b| ((a as i32) >> (b & 31)) as i64 as u64);
+
+// Division does not trap. Dividing by zero gives all ones (quotient) or
+// the dividend (remainder), and the one overflowing signed division
+// gives the dividend and 0, as the M extension specifies.
+exec_rr!(exec_mul, |a, b| a.wrapping_mul(b));
+exec_rr!(exec_mulh, |a, b| ((a as i64 as i128 * b as i64 as i128) >> 64) as u64);
+exec_rr!(exec_mulhsu, |a, b| ((a as i64 as i128 * b as i128) >> 64) as u64);
+exec_rr!(exec_mulhu, |a, b| ((a as u128 * b as u128) >> 64) as u64);
+exec_rr!(exec_div, |a, b| match b {
+    0 => u64::MAX,
+    _ => (a as i64).wrapping_div(b as i64) as u64,
+});
+exec_rr!(exec_divu, |a, b| match b {
+    0 => u64::MAX,
+    _ => a / b,
+});
+exec_rr!(exec_rem, |a, b| match b {
+    0 => a,
+    _ => (a as i64).wrapping_rem(b as i64) as u64,
+});
+exec_rr!(exec_remu, |a, b| match b {
+    0 => a,
+    _ => a % b,
+});
+
+exec_rr!(exec_mulw, |a, b| sext32(a.wrapping_mul(b)));
+exec_rr!(exec_divw, |a, b| match b as u32 {
+    0 => u64::MAX,
+    _ => (a as i32).wrapping_div(b as i32) as i64 as u64,
+});
+exec_rr!(exec_divuw, |a, b| match b as u32 {
+    0 => u64::MAX,
+    d => sext32(((a as u32) / d) as u64),
+});
+exec_rr!(exec_remw, |a, b| match b as u32 {
+    0 => sext32(a),
+    _ => (a as i32).wrapping_rem(b as i32) as i64 as u64,
+});
+exec_rr!(exec_remuw, |a, b| match b as u32 {
+    0 => sext32(a),
+    d => sext32(((a as u32) % d) as u64),
+});
+
+// Guest addresses are host addresses, checked against s.mem
+exec_load!(exec_lb, exec_lb_shared, i8, AtomicI8, i64);
+exec_load!(exec_lh, exec_lh_shared, i16, AtomicI16, i64);
+exec_load!(exec_lw, exec_lw_shared, i32, AtomicI32, i64);
+exec_load!(exec_ld, exec_ld_shared, u64, AtomicU64, u64);
+exec_load!(exec_lbu, exec_lbu_shared, u8, AtomicU8, u64);
+exec_load!(exec_lhu, exec_lhu_shared, u16, AtomicU16, u64);
+exec_load!(exec_lwu, exec_lwu_shared, u32, AtomicU32, u64);
+
+exec_store!(exec_sb, exec_sb_shared, u8, AtomicU8);
+exec_store!(exec_sh, exec_sh_shared, u16, AtomicU16);
+exec_store!(exec_sw, exec_sw_shared, u32, AtomicU32);
+exec_store!(exec_sd, exec_sd_shared, u64, AtomicU64);
+
+// Atomics
+//
+// Harts are host threads and guest memory is host memory, so an AMO is
+// the host atomic of the same width on the same address. All of them
+// are SeqCst, at least as strong as any aq and rl bits ask for. On
+// shared memory plain loads and stores are Relaxed atomics (see Loads
+// and stores), so a guest that shares data without AMOs or fences gets
+// no ordering, but no torn values either.
+//
+// lr keeps the address and the value it loaded, and sc stores only if
+// memory still holds that value, as one compare-and-swap. Unlike a real
+// reservation that misses another hart storing the same value in
+// between, which the lock and update loops lr/sc is used for never
+// depend on.
 
-    s.pc = unsafe { s.pc.add(4) };
+// The $t at rs1 as a host atomic, checked like a store if $store
+macro_rules! amo_ref {
+    ($s:ident, $insn:ident, $atomic:ty, $t:ty, $store:expr) => {{
+        let addr = $s.regs[$insn.rs1 as usize];
+        $s.mem.check_atomic(addr, size_of::<$t>() as u64, $store);
+        (addr, unsafe { <$atomic>::from_ptr(addr as *mut $t) })
+    }};
 }
 
-fn run_i_arith(s: &mut RvState, iw: u32) {
-    let rd = get_rd(iw);
-    let rs1 = get_rs1(iw);
-    let funct3 = get_funct3(iw);
-    let imm = sign_extend(get_bits(iw as u64, 20, 12) as u64, 12);
+// The old value of an AMO or lr, sign-extended as RV64 requires
+fn amo_result<T: Into<i64>>(old: T) -> u64 {
+    old.into() as u64
+}
 
-    match funct3 {
-        0b000 => {
-            // addi
-            s.regs[rd] = (s.regs[rs1] as i64).wrapping_add(imm) as u64;
+// rd = the old $t at rs1, after storing e there, with m the atomic and
+// v the low bits of rs2
+macro_rules! exec_amo {
+    ($name:ident, $atomic:ty, $t:ty, |$m:ident, $v:ident| $e:expr) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let (_, $m) = amo_ref!(s, insn, $atomic, $t, true);
+            let $v = s.regs[insn.rs2 as usize] as $t;
+            s.regs[insn.rd as usize] = amo_result($e);
         }
-        _ => unsupported("I-arith funct3", funct3),
-    }
+    };
+}
 
-    s.pc = unsafe { s.pc.add(4) };
+macro_rules! exec_lr {
+    ($name:ident, $atomic:ty, $t:ty) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let (addr, m) = amo_ref!(s, insn, $atomic, $t, false);
+            let v = m.load(SeqCst);
+            s.reserve = addr;
+            s.reserve_value = v as u64;
+            s.regs[insn.rd as usize] = amo_result(v);
+        }
+    };
 }
 
-fn run_i_jalr(s: &mut RvState, iw: u32) {
-    let rd = get_rd(iw);
-    let rs1 = get_rs1(iw);
-    let imm = sign_extend(get_bits(iw as u64, 20, 12) as u64, 12);
-    let target = (s.regs[rs1] as i64).wrapping_add(imm) as u64;
+// rd = 0 if rs2 was stored, 1 if not. Either way the reservation is gone.
+macro_rules! exec_sc {
+    ($name:ident, $atomic:ty, $t:ty) => {
+        fn $name(s: &mut RvState, insn: &RvInsn) {
+            let (addr, m) = amo_ref!(s, insn, $atomic, $t, true);
+            let v = s.regs[insn.rs2 as usize] as $t;
+            let ok = s.reserve == addr
+                && m.compare_exchange(s.reserve_value as $t, v, SeqCst, SeqCst).is_ok();
+            s.reserve = RV_NO_RESERVE;
+            s.regs[insn.rd as usize] = !ok as u64;
+        }
+    };
+}
 
-    if rd != 0 {
-        s.regs[rd] = (s.pc as u64).wrapping_add(4);
-    }
+exec_lr!(exec_lr_w, AtomicI32, i32);
+exec_sc!(exec_sc_w, AtomicI32, i32);
+exec_amo!(exec_amoswap_w, AtomicI32, i32, |m, v| m.swap(v, SeqCst));
+exec_amo!(exec_amoadd_w, AtomicI32, i32, |m, v| m.fetch_add(v, SeqCst));
+exec_amo!(exec_amoxor_w, AtomicI32, i32, |m, v| m.fetch_xor(v, SeqCst));
+exec_amo!(exec_amoand_w, AtomicI32, i32, |m, v| m.fetch_and(v, SeqCst));
+exec_amo!(exec_amoor_w, AtomicI32, i32, |m, v| m.fetch_or(v, SeqCst));
+exec_amo!(exec_amomin_w, AtomicI32, i32, |m, v| m.fetch_min(v, SeqCst));
+exec_amo!(exec_amomax_w, AtomicI32, i32, |m, v| m.fetch_max(v, SeqCst));
+exec_amo!(exec_amominu_w, AtomicU32, u32, |m, v| m.fetch_min(v, SeqCst) as i32);
+exec_amo!(exec_amomaxu_w, AtomicU32, u32, |m, v| m.fetch_max(v, SeqCst) as i32);
 
+exec_lr!(exec_lr_d, AtomicI64, i64);
+exec_sc!(exec_sc_d, AtomicI64, i64);
+exec_amo!(exec_amoswap_d, AtomicI64, i64, |m, v| m.swap(v, SeqCst));
+exec_amo!(exec_amoadd_d, AtomicI64, i64, |m, v| m.fetch_add(v, SeqCst));
+exec_amo!(exec_amoxor_d, AtomicI64, i64, |m, v| m.fetch_xor(v, SeqCst));
+exec_amo!(exec_amoand_d, AtomicI64, i64, |m, v| m.fetch_and(v, SeqCst));
+exec_amo!(exec_amoor_d, AtomicI64, i64, |m, v| m.fetch_or(v, SeqCst));
+exec_amo!(exec_amomin_d, AtomicI64, i64, |m, v| m.fetch_min(v, SeqCst));
+exec_amo!(exec_amomax_d, AtomicI64, i64, |m, v| m.fetch_max(v, SeqCst));
+exec_amo!(exec_amominu_d, AtomicU64, u64, |m, v| m.fetch_min(v, SeqCst) as i64);
+exec_amo!(exec_amomaxu_d, AtomicU64, u64, |m, v| m.fetch_max(v, SeqCst) as i64);
+
+fn exec_jal(s: &mut RvState, insn: &RvInsn) {
+    let pc = s.pc as u64;
+
+    s.regs[insn.rd as usize] = pc.wrapping_add(4);
+    s.pc = pc.wrapping_add(insn.imm as i64 as u64) as *const u8;
+}
+
+fn exec_jalr(s: &mut RvState, insn: &RvInsn) {
+    let target = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64) & !1;
+
+    // The target is computed first because rd may be rs1 ("jalr ra, 0(ra)")
+    s.regs[insn.rd as usize] = (s.pc as u64).wrapping_add(4);
     s.pc = target as *const u8;
 }
 
+exec_branch!(exec_beq, |a, b| a == b);
+exec_branch!(exec_bne, |a, b| a != b);
+exec_branch!(exec_blt, |a, b| (a as i64) < (b as i64));
+exec_branch!(exec_bge, |a, b| (a as i64) >= (b as i64));
+exec_branch!(exec_bltu, |a, b| a < b);
+exec_branch!(exec_bgeu, |a, b| a >= b);
+
+static RV_HANDLERS: [RvHandler; OP_COUNT] = {
+    let mut h: [RvHandler; OP_COUNT] = [exec_unsupported; OP_COUNT];
+
+    h[OP_LUI as usize] = exec_lui;
+    h[OP_AUIPC as usize] = exec_auipc;
+    h[OP_ADDI as usize] = exec_addi;
+    h[OP_SLTI as usize] = exec_slti;
+    h[OP_SLTIU as usize] = exec_sltiu;
+    h[OP_XORI as usize] = exec_xori;
+    h[OP_ORI as usize] = exec_ori;
+    h[OP_ANDI as usize] = exec_andi;
+    h[OP_SLLI as usize] = exec_slli;
+    h[OP_SRLI as usize] = exec_srli;
+    h[OP_SRAI as usize] = exec_srai;
+    h[OP_ADD as usize] = exec_add;
+    h[OP_SUB as usize] = exec_sub;
+    h[OP_SLL as usize] = exec_sll;
+    h[OP_SLT as usize] = exec_slt;
+    h[OP_SLTU as usize] = exec_sltu;
+    h[OP_XOR as usize] = exec_xor;
+    h[OP_SRL as usize] = exec_srl;
+    h[OP_SRA as usize] = exec_sra;
+    h[OP_OR as usize] = exec_or;
+    h[OP_AND as usize] = exec_and;
+    h[OP_ADDIW as usize] = exec_addiw;
+    h[OP_SLLIW as usize] = exec_slliw;
+    h[OP_SRLIW as usize] = exec_srliw;
+    h[OP_SRAIW as usize] = exec_sraiw;
+    h[OP_ADDW as usize] = exec_addw;
+    h[OP_SUBW as usize] = exec_subw;
+    h[OP_SLLW as usize] = exec_sllw;
+    h[OP_SRLW as usize] = exec_srlw;
+    h[OP_SRAW as usize] = exec_sraw;
+    h[OP_MUL as usize] = exec_mul;
+    h[OP_MULH as usize] = exec_mulh;
+    h[OP_MULHSU as usize] = exec_mulhsu;
+    h[OP_MULHU as usize] = exec_mulhu;
+    h[OP_DIV as usize] = exec_div;
+    h[OP_DIVU as usize] = exec_divu;
+    h[OP_REM as usize] = exec_rem;
+    h[OP_REMU as usize] = exec_remu;
+    h[OP_MULW as usize] = exec_mulw;
+    h[OP_DIVW as usize] = exec_divw;
+    h[OP_DIVUW as usize] = exec_divuw;
+    h[OP_REMW as usize] = exec_remw;
+    h[OP_REMUW as usize] = exec_remuw;
+    h[OP_FENCE as usize] = exec_fence;
+    h[OP_LB as usize] = exec_lb;
+    h[OP_LH as usize] = exec_lh;
+    h[OP_LW as usize] = exec_lw;
+    h[OP_LD as usize] = exec_ld;
+    h[OP_LBU as usize] = exec_lbu;
+    h[OP_LHU as usize] = exec_lhu;
+    h[OP_LWU as usize] = exec_lwu;
+    h[OP_SB as usize] = exec_sb;
+    h[OP_SH as usize] = exec_sh;
+    h[OP_SW as usize] = exec_sw;
+    h[OP_SD as usize] = exec_sd;
+    h[OP_LR_W as usize] = exec_lr_w;
+    h[OP_SC_W as usize] = exec_sc_w;
+    h[OP_AMOSWAP_W as usize] = exec_amoswap_w;
+    h[OP_AMOADD_W as usize] = exec_amoadd_w;
+    h[OP_AMOXOR_W as usize] = exec_amoxor_w;
+    h[OP_AMOAND_W as usize] = exec_amoand_w;
+    h[OP_AMOOR_W as usize] = exec_amoor_w;
+    h[OP_AMOMIN_W as usize] = exec_amomin_w;
+    h[OP_AMOMAX_W as usize] = exec_amomax_w;
+    h[OP_AMOMINU_W as usize] = exec_amominu_w;
+    h[OP_AMOMAXU_W as usize] = exec_amomaxu_w;
+    h[OP_LR_D as usize] = exec_lr_d;
+    h[OP_SC_D as usize] = exec_sc_d;
+    h[OP_AMOSWAP_D as usize] = exec_amoswap_d;
+    h[OP_AMOADD_D as usize] = exec_amoadd_d;
+    h[OP_AMOXOR_D as usize] = exec_amoxor_d;
+    h[OP_AMOAND_D as usize] = exec_amoand_d;
+    h[OP_AMOOR_D as usize] = exec_amoor_d;
+    h[OP_AMOMIN_D as usize] = exec_amomin_d;
+    h[OP_AMOMAX_D as usize] = exec_amomax_d;
+    h[OP_AMOMINU_D as usize] = exec_amominu_d;
+    h[OP_AMOMAXU_D as usize] = exec_amomaxu_d;
+    h[OP_JAL as usize] = exec_jal;
+    h[OP_JALR as usize] = exec_jalr;
+    h[OP_BEQ as usize] = exec_beq;
+    h[OP_BNE as usize] = exec_bne;
+    h[OP_BLT as usize] = exec_blt;
+    h[OP_BGE as usize] = exec_bge;
+    h[OP_BLTU as usize] = exec_bltu;
+    h[OP_BGEU as usize] = exec_bgeu;
+    h
+};
+
+// RV_HANDLERS with the loads and stores for shared memory
+static RV_HANDLERS_SHARED: [RvHandler; OP_COUNT] = {
+    let mut h = RV_HANDLERS;
+
+    h[OP_LB as usize] = exec_lb_shared;
+    h[OP_LH as usize] = exec_lh_shared;
+    h[OP_LW as usize] = exec_lw_shared;
+    h[OP_LD as usize] = exec_ld_shared;
+    h[OP_LBU as usize] = exec_lbu_shared;
+    h[OP_LHU as usize] = exec_lhu_shared;
+    h[OP_LWU as usize] = exec_lwu_shared;
+    h[OP_SB as usize] = exec_sb_shared;
+    h[OP_SH as usize] = exec_sh_shared;
+    h[OP_SW as usize] = exec_sw_shared;
+    h[OP_SD as usize] = exec_sd_shared;
+    h
+};
+
+fn rv_ends_block(op: u8) -> bool {
+    op == OP_UNSUPPORTED || op >= OP_JAL
+}
+
+// Uncached interpreter: decodes every instruction each time it runs.
+// Kept as the reference for checking the block translator.
 fn rv_one(state: &mut RvState) {
     let iw = unsafe { *(state.pc as *const u32) };
-    let opcode = get_bits(iw as u64, 0, 7);
+    let insn = rv_decode(iw);
 
-    match opcode {
-        FMT_R => run_r_format(state, iw),
-        FMT_I_ARITH => run_i_arith(state, iw),
-        FMT_I_JALR => run_i_jalr(state, iw),
-        _ => unsupported("format", opcode),
+    state.handlers[insn.op as usize](state, &insn);
+    if !rv_ends_block(insn.op) {
+        state.pc = unsafe { state.pc.add(4) };
     }
 }
 
+// Decode the block starting at pc and add it to the cache
+fn rv_translate(c: &mut RvBlockCache, pc: u64) -> u32 {
+    let start = c.insns.len();
+    let mut p = pc;
+
+    loop {
+        let iw = unsafe { *(p as *const u32) };
+        let mut insn = rv_decode(iw);
+        if insn.op == OP_AUIPC {
+            // pc is the start of the block when it runs
+            insn.imm = insn.imm.wrapping_add((p - pc) as i32);
+        }
+        c.insns.push(insn);
+        p += 4;
+        if rv_ends_block(insn.op) || c.insns.len() - start == RV_BLOCK_MAX {
+            break;
+        }
+    }
+
+    let b = c.blocks.len() as u32;
+    c.blocks.push(RvBlock {
+        pc,
+        start: start as u32,
+        len: (c.insns.len() - start) as u32,
+        ends_in_jump: rv_ends_block(c.insns[c.insns.len() - 1].op),
+        next: [RV_NO_BLOCK; 2],
+    });
+    c.map.insert(pc, b);
+    b
+}
+
+// Find the block at pc, coming from block prev (or RV_NO_BLOCK), and
+// chain prev to it.
+fn rv_next_block(c: &mut RvBlockCache, prev: u32, pc: u64) -> u32 {
+    if prev != RV_NO_BLOCK {
+        for &n in c.blocks[prev as usize].next.iter() {
+            if n != RV_NO_BLOCK && c.blocks[n as usize].pc == pc {
+                c.chained += 1;
+                return n;
+            }
+        }
+    }
+
+    let b = match c.map.get(&pc) {
+        Some(&b) => {
+            c.hits += 1;
+            b
+        }
+        None => {
+            c.translated += 1;
+            rv_translate(c, pc)
+        }
+    };
+
+    if prev != RV_NO_BLOCK {
+        let next = &mut c.blocks[prev as usize].next;
+        let slot = if next[0] == RV_NO_BLOCK { 0 } else { 1 };
+        next[slot] = b;
+    }
+    b
+}
+
+// Tell prof about a load or store before it runs, while rs1 still
+// holds the base address. lr is a load, and sc and the AMOs are stores.
+#[inline(always)]
+fn rv_mem_hook<P: RvProfiler>(s: &RvState, insn: &RvInsn, prof: &mut P) {
+    if (OP_LB..=OP_SD).contains(&insn.op) {
+        let addr = s.regs[insn.rs1 as usize].wrapping_add(insn.imm as i64 as u64);
+        prof.mem(addr, RV_MEM_SIZE[(insn.op - OP_LB) as usize], insn.op >= OP_SB);
+    } else if is_amo(insn.op) {
+        let size = if insn.op >= OP_LR_D { 8 } else { 4 };
+        let lr = insn.op == OP_LR_W || insn.op == OP_LR_D;
+        prof.mem(s.regs[insn.rs1 as usize], size, !lr);
+    }
+}
+
+fn rv_run_block<P: RvProfiler>(s: &mut RvState, b: u32, prof: &mut P) {
+    let handlers = s.handlers;
+    let blk = s.bcache.blocks[b as usize];
+    let start = blk.start as usize;
+    let last = start + blk.len as usize - 1;
+
+    for i in start..last {
+        let insn = s.bcache.insns[i];
+        rv_mem_hook(s, &insn, prof);
+        handlers[insn.op as usize](s, &insn);
+        let pc = blk.pc + 4 * (i - start) as u64;
+        prof.retire(i, pc, &insn, pc + 4);
+    }
+
+    // A jump at the end sees its own pc and sets the next one; otherwise
+    // pc moves past the block.
+    let insn = s.bcache.insns[last];
+    rv_mem_hook(s, &insn, prof);
+    let pc = blk.pc + 4 * (blk.len as u64 - 1);
+    if blk.ends_in_jump {
+        s.pc = pc as *const u8;
+    }
+    handlers[insn.op as usize](s, &insn);
+    if !blk.ends_in_jump {
+        s.pc = (pc + 4) as *const u8;
+    }
+    prof.retire(last, pc, &insn, s.pc as u64);
+}
+
 pub fn rv_init(
     state: &mut RvState,
     target: *const u32,
@@ -132,14 +705,423 @@ pub fn rv_init(
 
     state.regs[RV_ZERO] = 0;
     state.regs[RV_RA] = 0;
-    state.regs[RV_SP] = unsafe { state.stack.as_ptr().add(STACK_SIZE) as u64 };
+    state.regs[RV_SP] = state.mem.stack.top();
 }
 
 pub fn rv_emulate(state: &mut RvState) -> u64 {
+    rv_emulate_with(state, &mut RvNoProfile)
+}
+
+// Same as rv_emulate() but reports every instruction retired to prof
+pub fn rv_emulate_with<P: RvProfiler>(state: &mut RvState, prof: &mut P) -> u64 {
+    let mut b = RV_NO_BLOCK;
+
+    while !state.pc.is_null() {
+        b = rv_next_block(&mut state.bcache, b, state.pc as u64);
+        rv_run_block(state, b, prof);
+    }
+    prof.finish(state);
+    state.regs[RV_A0]
+}
+
+// Same as rv_emulate() but decodes every instruction as it runs, for
+// checking the block translator against.
+pub fn rv_emulate_uncached(state: &mut RvState) -> u64 {
     while !state.pc.is_null() {
         rv_one(state);
-        // Ensure x0 stays 0
-        state.regs[RV_ZERO] = 0;
     }
     state.regs[RV_A0]
 }
+
+// Profiling
+//
+// The block runner reports every instruction it retires to a profiler.
+// It is a type parameter rather than a trait object, so rv_emulate()
+// with RvNoProfile compiles to the same loop as having no profiler.
+
+pub trait RvProfiler {
+    // insn at pc was retired and execution went on to next_pc. slot is
+    // the instruction's index in the block cache, which is dense and so
+    // cheaper to count by than pc.
+    fn retire(&mut self, slot: usize, pc: u64, insn: &RvInsn, next_pc: u64);
+
+    // A load or store of size bytes at addr is about to run
+    #[inline(always)]
+    fn mem(&mut self, _addr: u64, _size: u32, _store: bool) {}
+
+    // Called when rv_emulate_with() returns
+    fn finish(&mut self, _state: &RvState) {}
+}
+
+pub struct RvNoProfile;
+
+impl RvProfiler for RvNoProfile {
+    #[inline(always)]
+    fn retire(&mut self, _slot: usize, _pc: u64, _insn: &RvInsn, _next_pc: u64) {}
+}
+
+// Run two profilers at once, e.g. an RvProfile and an RvCache
+impl<A: RvProfiler, B: RvProfiler> RvProfiler for (A, B) {
+    #[inline(always)]
+    fn retire(&mut self, slot: usize, pc: u64, insn: &RvInsn, next_pc: u64) {
+        self.0.retire(slot, pc, insn, next_pc);
+        self.1.retire(slot, pc, insn, next_pc);
+    }
+
+    #[inline(always)]
+    fn mem(&mut self, addr: u64, size: u32, store: bool) {
+        self.0.mem(addr, size, store);
+        self.1.mem(addr, size, store);
+    }
+
+    fn finish(&mut self, state: &RvState) {
+        self.0.finish(state);
+        self.1.finish(state);
+    }
+}
+
+// Access size of OP_LB..=OP_SD
+const RV_MEM_SIZE: [u32; 11] = [1, 2, 4, 8, 1, 2, 4, 1, 2, 4, 8];
+
+// Counts retired instructions and nothing else
+pub struct RvCount {
+    pub retired: u64,
+}
+
+impl RvProfiler for RvCount {
+    #[inline(always)]
+    fn retire(&mut self, _slot: usize, _pc: u64, _insn: &RvInsn, _next_pc: u64) {
+        self.retired += 1;
+    }
+}
+
+pub const RV_CLASS_NAMES: [&str; 8] =
+    ["alu", "muldiv", "load", "store", "jump", "branch", "atomic", "other"];
+
+fn rv_op_class(op: u8) -> usize {
+    match op {
+        OP_LUI..=OP_SRAW => 0,
+        OP_MUL..=OP_REMUW => 1,
+        OP_LB..=OP_LWU => 2,
+        OP_SB..=OP_SD => 3,
+        OP_JAL | OP_JALR => 4,
+        OP_BEQ..=OP_BGEU => 5,
+        OP_LR_W..=OP_AMOMAXU_D => 6,
+        _ => 7,
+    }
+}
+
+// Counts retired instructions and prints a report when the run ends.
+// Counts add up over runs that share the same RvState.
+pub struct RvProfile {
+    pub retired: u64,
+    pub classes: [u64; RV_CLASS_NAMES.len()],
+    pub taken: u64,
+    pub not_taken: u64,
+    pub slots: Vec<u64>, // retired count by block cache slot
+    pub hot_len: usize,  // pcs to list in the report
+}
+
+impl RvProfile {
+    pub fn new(hot_len: usize) -> Self {
+        RvProfile {
+            retired: 0,
+            classes: [0; RV_CLASS_NAMES.len()],
+            taken: 0,
+            not_taken: 0,
+            slots: Vec::new(),
+            hot_len,
+        }
+    }
+
+    // (pc, op, retired count) for every pc that ran, most retired first.
+    // The same pc can be in more than one block, so slots are added up
+    // by pc.
+    pub fn hot_spots(&self, state: &RvState) -> Vec<(u64, u8, u64)> {
+        let c = &state.bcache;
+        let mut by_pc: HashMap<u64, (u8, u64)> = HashMap::new();
+
+        for blk in c.blocks.iter() {
+            for k in 0..blk.len as usize {
+                let slot = blk.start as usize + k;
+                let n = self.slots.get(slot).copied().unwrap_or(0);
+                if n > 0 {
+                    let e = by_pc.entry(blk.pc + 4 * k as u64).or_insert((c.insns[slot].op, 0));
+                    e.1 += n;
+                }
+            }
+        }
+
+        let mut v: Vec<(u64, u8, u64)> = by_pc.into_iter().map(|(pc, (op, n))| (pc, op, n)).collect();
+        v.sort_by(|a, b| b.2.cmp(&a.2).then(a.0.cmp(&b.0)));
+        v
+    }
+
+    pub fn print_report(&self, state: &RvState) {
+        let pct = |n: u64| if self.retired == 0 { 0.0 } else { n as f64 * 100.0 / self.retired as f64 };
+
+        println!("profile: {} instructions retired", self.retired);
+        for (name, &n) in RV_CLASS_NAMES.iter().zip(self.classes.iter()) {
+            if n > 0 {
+                println!("  {:<8} {:>12} {:>6.1}%", name, n, pct(n));
+            }
+        }
+        println!("  branches: {} taken, {} not taken", self.taken, self.not_taken);
+        println!("  {:<18} {:<8} {:>12} {:>7}", "pc", "op", "count", "%");
+        for &(pc, op, n) in self.hot_spots(state).iter().take(self.hot_len) {
+            let name = OP_NAMES[op as usize][3..].to_lowercase();
+            println!("  {:<#18x} {:<8} {:>12} {:>6.1}%", pc, name, n, pct(n));
+        }
+    }
+}
+
+impl RvProfiler for RvProfile {
+    fn retire(&mut self, slot: usize, pc: u64, insn: &RvInsn, next_pc: u64) {
+        self.retired += 1;
+
+        let class = rv_op_class(insn.op);
+        self.classes[class] += 1;
+        if class == 5 {
+            if next_pc == pc + 4 {
+                self.not_taken += 1;
+            } else {
+                self.taken += 1;
+            }
+        }
+
+        if slot >= self.slots.len() {
+            self.slots.resize(slot + 1, 0);
+        }
+        self.slots[slot] += 1;
+    }
+
+    fn finish(&mut self, state: &RvState) {
+        self.print_report(state);
+    }
+}
+
+// Cache simulation
+//
+// RvCache models one level of data cache on the emulated loads and
+// stores. It only keeps tags, since the data itself is read from the
+// host. ways is 1 for a direct-mapped cache and size / block for a
+// fully associative one. Stores allocate like loads. Replacement is
+// O(1) for any associativity, so a fully associative cache is about as
+// cheap to simulate as a direct-mapped one.
+
+#[derive(Clone, Copy, PartialEq)]
+pub enum RvReplace {
+    Lru,
+    Fifo,
+}
+
+#[derive(Clone, Copy)]
+pub struct RvCacheConfig {
+    pub size: usize,  // bytes, a power of 2
+    pub block: usize, // bytes, a power of 2
+    pub ways: usize,  // lines per set, a power of 2
+    pub replace: RvReplace,
+}
+
+impl std::fmt::Display for RvCacheConfig {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        let ways = if self.ways == 1 {
+            "direct-mapped".to_string()
+        } else if self.ways * self.block == self.size {
+            "fully associative".to_string()
+        } else {
+            format!("{}-way", self.ways)
+        };
+        let replace = match self.replace {
+            RvReplace::Lru => "LRU",
+            RvReplace::Fifo => "FIFO",
+        };
+        write!(f, "{}B, {}B blocks, {}, {}", self.size, self.block, ways, replace)
+    }
+}
+
+const RV_CACHE_EMPTY: u64 = u64::MAX;
+
+// Sets wider than this find tags through a map instead of a scan
+const RV_CACHE_SCAN_WAYS: usize = 16;
+
+pub struct RvCache {
+    pub config: RvCacheConfig,
+    block_shift: u32,
+    set_mask: u64,
+    tags: Vec<u64>, // block number in each line, sets * ways
+    // Lines of each set in replacement order, linked through prev and
+    // next: head is the most recently used (LRU) or filled (FIFO) line
+    // and tail is the next victim.
+    prev: Vec<u32>,
+    next: Vec<u32>,
+    head: Vec<u32>,
+    tail: Vec<u32>,
+    index: HashMap<u64, u32>, // block to line, for wide sets
+    last: usize,              // line of the last hit, checked first
+    pub loads: u64,
+    pub stores: u64,
+    pub hits: u64,
+    pub misses: u64,
+}
+
+impl RvCache {
+    pub fn new(config: RvCacheConfig) -> Result<Self, String> {
+        let c = config;
+        if !c.size.is_power_of_two() || !c.block.is_power_of_two() || !c.ways.is_power_of_two() {
+            return Err(format!("cache sizes must be powers of 2: {}", c));
+        }
+        if c.block * c.ways > c.size {
+            return Err(format!("cache has less than one set: {}", c));
+        }
+        let lines = c.size / c.block;
+        let sets = lines / c.ways;
+
+        // Each set starts as a list of its lines in order, all empty
+        let line = |set: usize, way: usize| (set * c.ways + way) as u32;
+        let mut prev = vec![0; lines];
+        let mut next = vec![0; lines];
+        for set in 0..sets {
+            for way in 0..c.ways {
+                prev[line(set, way) as usize] = line(set, way.saturating_sub(1));
+                next[line(set, way) as usize] = line(set, (way + 1).min(c.ways - 1));
+            }
+        }
+
+        Ok(RvCache {
+            config,
+            block_shift: c.block.trailing_zeros(),
+            set_mask: (sets - 1) as u64,
+            tags: vec![RV_CACHE_EMPTY; lines],
+            prev,
+            next,
+            head: (0..sets).map(|set| line(set, 0)).collect(),
+            tail: (0..sets).map(|set| line(set, c.ways - 1)).collect(),
+            index: HashMap::new(),
+            last: 0,
+            loads: 0,
+            stores: 0,
+            hits: 0,
+            misses: 0,
+        })
+    }
+
+    pub fn miss_rate(&self) -> f64 {
+        let n = self.hits + self.misses;
+        if n == 0 { 0.0 } else { self.misses as f64 / n as f64 }
+    }
+
+    // Zero the counts but keep the cache contents
+    pub fn reset_stats(&mut self) {
+        self.loads = 0;
+        self.stores = 0;
+        self.hits = 0;
+        self.misses = 0;
+    }
+
+    // An access of size bytes at addr touches every block it overlaps
+    pub fn access(&mut self, addr: u64, size: u32, store: bool) {
+        let first = addr >> self.block_shift;
+        let last = addr.wrapping_add(size as u64 - 1) >> self.block_shift;
+
+        if store {
+            self.stores += 1;
+        } else {
+            self.loads += 1;
+        }
+        self.touch(first);
+        if last != first {
+            self.touch(last);
+        }
+    }
+
+    fn touch(&mut self, blk: u64) {
+        // Most accesses are to the same block as the one before
+        if self.tags[self.last] == blk {
+            self.hits += 1;
+            return;
+        }
+
+        let ways = self.config.ways;
+        let set = (blk & self.set_mask) as usize;
+        let found = if ways > RV_CACHE_SCAN_WAYS {
+            self.index.get(&blk).map(|&line| line as usize)
+        } else {
+            let base = set * ways;
+            (base..base + ways).find(|&line| self.tags[line] == blk)
+        };
+
+        let line = match found {
+            Some(line) => {
+                self.hits += 1;
+                if self.config.replace == RvReplace::Lru {
+                    self.move_to_head(set, line);
+                }
+                line
+            }
+            None => {
+                self.misses += 1;
+                let line = self.tail[set] as usize;
+                if ways > RV_CACHE_SCAN_WAYS {
+                    self.index.remove(&self.tags[line]);
+                    self.index.insert(blk, line as u32);
+                }
+                self.tags[line] = blk;
+                self.move_to_head(set, line);
+                line
+            }
+        };
+        self.last = line;
+    }
+
+    fn move_to_head(&mut self, set: usize, line: usize) {
+        let l = line as u32;
+        if self.head[set] == l {
+            return;
+        }
+
+        // Unlink; line is not the head, so it has a prev
+        let (p, n) = (self.prev[line], self.next[line]);
+        self.next[p as usize] = if n == l { p } else { n };
+        if self.tail[set] == l {
+            self.tail[set] = p;
+        } else {
+            self.prev[n as usize] = p;
+        }
+
+        // Relink at the head. The ends of a list point at themselves.
+        let h = self.head[set];
+        self.prev[h as usize] = l;
+        self.next[line] = h;
+        self.prev[line] = l;
+        self.head[set] = l;
+    }
+
+    pub fn print_stats(&self) {
+        println!(
+            "cache ({}): {} loads, {} stores, {} hits, {} misses, miss rate = {:.2}%",
+            self.config,
+            self.loads,
+            self.stores,
+            self.hits,
+            self.misses,
+            self.miss_rate() * 100.0
+        );
+    }
+}
+
+impl RvProfiler for RvCache {
+    #[inline(always)]
+    fn retire(&mut self, _slot: usize, _pc: u64, _insn: &RvInsn, _next_pc: u64) {}
+
+    #[inline(always)]
+    fn mem(&mut self, addr: u64, size: u32, store: bool) {
+        self.access(addr, size, store);
+    }
+
+    // Report each run on its own; the contents stay warm for the next
+    fn finish(&mut self, _state: &RvState) {
+        self.print_stats();
+        self.reset_stats();
+    }
+}
@@ -0,0 +1,50 @@
+// Running harts in parallel
+//
+// rv_run_harts() runs every job of a batch at the same time, each as its
+// own hart on its own host thread. A hart is an RvState, so each one has
+// its own registers, stack, lr reservation and block cache, and they
+// share everything else: the batch's regions are mapped into every
+// hart. Unlike with rv_run_batches() more than one hart may write the
+// same region, which is the point; harts agree on what is in it through
+// the atomics and fence (see Atomics in rv_emu). Every hart's loads and
+// stores are then host atomics as well, except misaligned ones, so harts
+// must not share data through misaligned accesses (see Loads and stores
+// in rv_emu).
+//
+// There is one thread per job even when there are more jobs than cores,
+// since a hart may spin until another one releases a lock. The harts
+// wait at a barrier after setting up, so they all start together.
+
+use std::sync::Barrier;
+use std::thread;
+
+use crate::rv_batch::RvBatch;
+use crate::rv_emu::{rv_emulate, rv_init, RvState};
+
+// Run the jobs of batch as harts and return their a0 results in order.
+// Jobs get nothing to tell them apart but their arguments, so pass each
+// its hart number there if it needs one.
+pub fn rv_run_harts(batch: &RvBatch) -> Vec<u64> {
+    let start = Barrier::new(batch.jobs.len());
+
+    thread::scope(|scope| {
+        let harts: Vec<_> = batch
+            .jobs
+            .iter()
+            .map(|job| {
+                let start = &start;
+                scope.spawn(move || {
+                    let mut state = RvState::new();
+                    let a = job.args;
+                    batch.map_into(&mut state);
+                    state.set_shared(true);
+                    rv_init(&mut state, job.target as *const u32, a[0], a[1], a[2], a[3]);
+                    start.wait();
+                    rv_emulate(&mut state)
+                })
+            })
+            .collect();
+
+        harts.into_iter().map(|h| h.join().unwrap()).collect()
+    })
+}
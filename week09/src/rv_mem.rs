@@ -0,0 +1,174 @@
+// Guest memory
+//
+// Guest addresses are host addresses, but a guest may only load and
+// store inside the regions mapped into its RvMemory: its stack, plus
+// whatever host data the caller hands it. Every load and store is
+// checked. The region that passed the last check is tried first, so a
+// loop over one array or the stack costs one compare per access.
+
+// Default guest stack size. The stack is mmap-ed, so pages a guest
+// never touches cost nothing.
+pub const RV_STACK_SIZE: usize = 1 << 20;
+
+// PROT_NONE pages below the stack, so a store the checks let through by
+// mistake faults instead of landing in other host memory
+const RV_GUARD_SIZE: usize = 1 << 16;
+
+#[derive(Clone, Copy)]
+struct RvRegion {
+    start: u64,
+    len: u64,
+    writable: bool,
+}
+
+impl RvRegion {
+    #[inline(always)]
+    fn contains(&self, addr: u64, size: u64, store: bool) -> bool {
+        let off = addr.wrapping_sub(self.start);
+        off < self.len && self.len - off >= size && (self.writable || !store)
+    }
+}
+
+// An mmap-ed stack with guard pages below it
+pub struct RvStack {
+    base: *mut u8, // start of the mapping, guard included
+    len: usize,
+}
+
+fn page_size() -> usize {
+    unsafe { libc::sysconf(libc::_SC_PAGESIZE) as usize }
+}
+
+impl RvStack {
+    pub fn new(size: usize) -> Self {
+        let page = page_size();
+        let size = size.max(page).div_ceil(page) * page;
+        let len = RV_GUARD_SIZE + size;
+
+        let base = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_NORESERVE,
+                -1,
+                0,
+            )
+        };
+        if base == libc::MAP_FAILED {
+            eprintln!("cannot map a {} byte guest stack", size);
+            std::process::exit(-1);
+        }
+        if unsafe { libc::mprotect(base, RV_GUARD_SIZE, libc::PROT_NONE) } != 0 {
+            unsafe { libc::munmap(base, len) };
+            eprintln!("cannot protect the guard below a {} byte guest stack", size);
+            std::process::exit(-1);
+        }
+
+        RvStack { base: base as *mut u8, len }
+    }
+
+    // Lowest usable address
+    pub fn bottom(&self) -> u64 {
+        self.base as u64 + RV_GUARD_SIZE as u64
+    }
+
+    // Initial sp: one past the highest usable address
+    pub fn top(&self) -> u64 {
+        self.base as u64 + self.len as u64
+    }
+
+    pub fn size(&self) -> usize {
+        self.len - RV_GUARD_SIZE
+    }
+}
+
+impl Drop for RvStack {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.base as *mut libc::c_void, self.len) };
+    }
+}
+
+pub struct RvMemory {
+    pub stack: RvStack,
+    regions: Vec<RvRegion>, // the stack is always regions[0]
+    last: usize,            // region of the last access
+}
+
+impl RvMemory {
+    pub fn new(stack_size: usize) -> Self {
+        let stack = RvStack::new(stack_size);
+        let region = RvRegion { start: stack.bottom(), len: stack.size() as u64, writable: true };
+
+        RvMemory { stack, regions: vec![region], last: 0 }
+    }
+
+    // Let the guest load from data
+    pub fn map<T>(&mut self, data: &[T]) {
+        self.map_raw(data.as_ptr() as u64, std::mem::size_of_val(data) as u64, false);
+    }
+
+    // Let the guest load from and store to data
+    pub fn map_mut<T>(&mut self, data: &mut [T]) {
+        self.map_raw(data.as_mut_ptr() as u64, std::mem::size_of_val(data) as u64, true);
+    }
+
+    // The caller keeps the memory alive until it is unmapped
+    pub fn map_raw(&mut self, start: u64, len: u64, writable: bool) {
+        self.regions.push(RvRegion { start, len, writable });
+    }
+
+    // Unmap everything but the stack
+    pub fn unmap_all(&mut self) {
+        self.regions.truncate(1);
+        self.last = 0;
+    }
+
+    // Check a load or store of size bytes at addr
+    #[inline(always)]
+    pub fn check(&mut self, addr: u64, size: u64, store: bool) {
+        if !self.regions[self.last].contains(addr, size, store) {
+            self.check_slow(addr, size, store);
+        }
+    }
+
+    // Check an atomic of size bytes at addr, which must also be aligned
+    #[inline(always)]
+    pub fn check_atomic(&mut self, addr: u64, size: u64, store: bool) {
+        if addr & (size - 1) != 0 {
+            self.misaligned(addr, size);
+        }
+        self.check(addr, size, store);
+    }
+
+    #[cold]
+    fn check_slow(&mut self, addr: u64, size: u64, store: bool) {
+        match self.regions.iter().position(|r| r.contains(addr, size, store)) {
+            Some(i) => self.last = i,
+            None => self.fault(addr, size, store),
+        }
+    }
+
+    #[cold]
+    fn misaligned(&self, addr: u64, size: u64) -> ! {
+        eprintln!("guest misaligned atomic: {} bytes at 0x{:x}", size, addr);
+        std::process::exit(-1);
+    }
+
+    fn fault(&self, addr: u64, size: u64, store: bool) -> ! {
+        let access = if store { "store" } else { "load" };
+        let below = self.stack.bottom().wrapping_sub(addr);
+        if below > 0 && below <= RV_GUARD_SIZE as u64 {
+            eprintln!(
+                "guest stack overflow: {} of {} bytes at 0x{:x} ({} byte stack)",
+                access,
+                size,
+                addr,
+                self.stack.size()
+            );
+        } else {
+            eprintln!("guest memory fault: {} of {} bytes at 0x{:x}", access, size, addr);
+        }
+        std::process::exit(-1);
+    }
+}